@@ -8,6 +8,15 @@ endif()
 
 set(LOGGER_BINARY_DIR "s2u-logger")
 
+set(PLUGIFY_LOG_SEVERITY_MAX "Verbose" CACHE STRING "Most verbose log severity compiled in (Fatal, Error, Warning, Info, Debug, Verbose)")
+set_property(CACHE PLUGIFY_LOG_SEVERITY_MAX PROPERTY STRINGS Fatal Error Warning Info Debug Verbose)
+
+set(LOGGER_COMPILE_DEFINITIONS
+	${LOGGER_COMPILE_DEFINITIONS}
+
+	PLUGIFY_LOG_SEVERITY_MAX=${PLUGIFY_LOG_SEVERITY_MAX}
+)
+
 set(LOGGER_INCLUDE_DIRS
 	${LOGGER_INCLUDE_DIRS}
 
@@ -0,0 +1,292 @@
+#include "mm_binary_log.h"
+
+#include <chrono>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace plugifyMM;
+
+static uint64_t NowNanoseconds()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+MMBinaryLogSink::~MMBinaryLogSink()
+{
+	Close();
+}
+
+std::string &MMBinaryLogSink::ArgBuffer()
+{
+	static thread_local std::string s_buffer;
+	return s_buffer;
+}
+
+bool MMBinaryLogSink::Open(const std::filesystem::path &directory, plugify::Severity severity, size_t segmentSize, size_t maxFiles)
+{
+	Close();
+
+	std::lock_guard lock(m_mutex);
+
+	std::error_code ec;
+	std::filesystem::create_directories(directory, ec);
+	if (ec)
+		return false;
+
+	auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+	char prefix[32];
+	std::strftime(prefix, sizeof(prefix), "plugify_%Y%m%d_%H%M%S", std::localtime(&now));
+
+	m_directory = directory;
+	m_prefix = prefix;
+	m_segmentSize = std::max<size_t>(segmentSize, 64 * 1024);
+	m_maxFiles = std::max<size_t>(maxFiles, 1);
+	m_sequence = 0;
+	m_records = 0;
+	m_bytes = 0;
+	m_rotations = 0;
+
+	if (!MapSegment())
+		return false;
+
+	m_severity.store(severity, std::memory_order_relaxed);
+	return true;
+}
+
+void MMBinaryLogSink::Close()
+{
+	m_severity.store(plugify::Severity::None, std::memory_order_relaxed);
+
+	std::lock_guard lock(m_mutex);
+	UnmapSegment();
+	m_files.clear();
+	m_sources.clear();
+	m_formats.clear();
+	m_sourceTexts.clear();
+	m_formatTexts.clear();
+	m_sourceDefined.clear();
+	m_formatDefined.clear();
+}
+
+BinaryLogStats MMBinaryLogSink::GetStats() const
+{
+	std::lock_guard lock(m_mutex);
+	return { m_records, m_bytes, m_rotations, m_path };
+}
+
+void MMBinaryLogSink::Commit(plugify::Severity severity, std::string_view source, std::string_view format, uint8_t argc, const std::string &args)
+{
+	std::lock_guard lock(m_mutex);
+	if (!m_data)
+		return;
+
+	uint32_t sourceId = InternSource(source);
+	uint32_t formatId = InternFormat(format);
+
+	auto size = static_cast<uint32_t>(blog::kRecordPrefix + sizeof(uint64_t) + sizeof(uint8_t) + sizeof(uint32_t) * 2 + sizeof(uint8_t) + args.size());
+	// Reserve for both definitions even when they were written already: a rotation resets
+	// them, and they are then written into the new segment ahead of the record.
+	size_t definitions = blog::kRecordPrefix + sizeof(uint32_t) + sizeof(uint16_t) + m_sourceTexts[sourceId].size();
+	definitions += blog::kRecordPrefix + sizeof(uint32_t) + sizeof(uint16_t) + m_formatTexts[formatId].size();
+
+	if (!Reserve(size + definitions))
+		return;
+
+	if (!m_sourceDefined[sourceId])
+	{
+		AppendDefinition(blog::RecordType::Source, sourceId, m_sourceTexts[sourceId]);
+		m_sourceDefined[sourceId] = true;
+	}
+	if (!m_formatDefined[formatId])
+	{
+		AppendDefinition(blog::RecordType::Format, formatId, m_formatTexts[formatId]);
+		m_formatDefined[formatId] = true;
+	}
+
+	auto type = blog::RecordType::Entry;
+	uint64_t timestamp = NowNanoseconds();
+	auto level = static_cast<uint8_t>(severity);
+	Append(&size, sizeof(size));
+	Append(&type, sizeof(type));
+	Append(&timestamp, sizeof(timestamp));
+	Append(&level, sizeof(level));
+	Append(&sourceId, sizeof(sourceId));
+	Append(&formatId, sizeof(formatId));
+	Append(&argc, sizeof(argc));
+	Append(args.data(), args.size());
+
+	++m_records;
+}
+
+uint32_t MMBinaryLogSink::InternSource(std::string_view source)
+{
+	auto it = m_sources.find(source);
+	if (it != m_sources.end())
+		return it->second;
+
+	auto id = static_cast<uint32_t>(m_sourceTexts.size());
+	it = m_sources.emplace(std::string(source), id).first;
+	m_sourceTexts.emplace_back(it->first);
+	m_sourceDefined.push_back(false);
+	return id;
+}
+
+uint32_t MMBinaryLogSink::InternFormat(std::string_view format)
+{
+	// Format strings come from std::format_string literals, so the pointer is a stable key.
+	auto it = m_formats.find(format.data());
+	if (it != m_formats.end())
+		return it->second;
+
+	auto id = static_cast<uint32_t>(m_formatTexts.size());
+	m_formats.emplace(format.data(), id);
+	m_formatTexts.push_back(format.substr(0, UINT16_MAX));
+	m_formatDefined.push_back(false);
+	return id;
+}
+
+bool MMBinaryLogSink::Reserve(size_t size)
+{
+	// Keep room for the terminating zero size.
+	if (m_offset + size + sizeof(uint32_t) <= m_segmentSize)
+		return true;
+
+	if (size + sizeof(blog::FileHeader) + sizeof(uint32_t) > m_segmentSize)
+		return false;
+
+	UnmapSegment();
+	++m_rotations;
+	std::fill(m_sourceDefined.begin(), m_sourceDefined.end(), false);
+	std::fill(m_formatDefined.begin(), m_formatDefined.end(), false);
+	return MapSegment();
+}
+
+bool MMBinaryLogSink::MapSegment()
+{
+	m_path = m_directory / std::format("{}_{:04d}.blog", m_prefix, m_sequence);
+
+#if defined(_WIN32)
+	HANDLE file = CreateFileW(m_path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	size.QuadPart = static_cast<LONGLONG>(m_segmentSize);
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READWRITE, size.HighPart, size.LowPart, nullptr);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	void *data = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, m_segmentSize);
+	if (!data)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	m_handle = file;
+	m_mapping = mapping;
+#else
+	int fd = open(m_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return false;
+
+	if (ftruncate(fd, static_cast<off_t>(m_segmentSize)) != 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	void *data = mmap(nullptr, m_segmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED)
+	{
+		close(fd);
+		return false;
+	}
+
+	m_handle = reinterpret_cast<void *>(static_cast<intptr_t>(fd));
+#endif
+
+	m_data = static_cast<uint8_t *>(data);
+	m_offset = 0;
+
+	blog::FileHeader header {};
+	std::memcpy(header.magic, blog::kMagic, sizeof(header.magic));
+	header.version = blog::kVersion;
+	header.sequence = m_sequence;
+	header.created = NowNanoseconds();
+	Append(&header, sizeof(header));
+
+	m_files.push_back(m_path);
+	while (m_files.size() > m_maxFiles)
+	{
+		std::error_code ec;
+		std::filesystem::remove(m_files.front(), ec);
+		m_files.pop_front();
+	}
+
+	++m_sequence;
+	return true;
+}
+
+void MMBinaryLogSink::UnmapSegment()
+{
+	if (!m_data)
+		return;
+
+	// Trim the preallocated tail so closed files only hold written records.
+	size_t used = m_offset;
+
+#if defined(_WIN32)
+	UnmapViewOfFile(m_data);
+	CloseHandle(static_cast<HANDLE>(m_mapping));
+	HANDLE file = static_cast<HANDLE>(m_handle);
+	LARGE_INTEGER size;
+	size.QuadPart = static_cast<LONGLONG>(used);
+	if (SetFilePointerEx(file, size, nullptr, FILE_BEGIN))
+	{
+		SetEndOfFile(file);
+	}
+	CloseHandle(file);
+#else
+	munmap(m_data, m_segmentSize);
+	int fd = static_cast<int>(reinterpret_cast<intptr_t>(m_handle));
+	if (ftruncate(fd, static_cast<off_t>(used)) != 0)
+	{
+		// The decoder stops at the first zero-sized record, so an untrimmed file is still readable.
+	}
+	close(fd);
+#endif
+
+	m_data = nullptr;
+	m_mapping = nullptr;
+	m_handle = nullptr;
+	m_offset = 0;
+}
+
+void MMBinaryLogSink::Append(const void *data, size_t size)
+{
+	std::memcpy(m_data + m_offset, data, size);
+	m_offset += size;
+	m_bytes += size;
+}
+
+void MMBinaryLogSink::AppendDefinition(blog::RecordType type, uint32_t id, std::string_view text)
+{
+	auto length = static_cast<uint16_t>(text.size());
+	auto size = static_cast<uint32_t>(blog::kRecordPrefix + sizeof(id) + sizeof(length) + length);
+	Append(&size, sizeof(size));
+	Append(&type, sizeof(type));
+	Append(&id, sizeof(id));
+	Append(&length, sizeof(length));
+	Append(text.data(), length);
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include <plugify/log.h>
+#include <plugify/compat_format.h>
+
+#include "mm_binary_log_format.h"
+#include "mm_utils.h"
+
+namespace plugifyMM
+{
+	struct BinaryLogStats
+	{
+		uint64_t records;
+		uint64_t bytes;
+		uint64_t rotations;
+		std::filesystem::path path;
+	};
+
+	// Writes log records as compact binary into memory-mapped, rotating files.
+	// Arguments are stored raw; formatting happens offline in tools/logdecode.
+	// Format strings must have static storage duration, their address is the key.
+	class MMBinaryLogSink
+	{
+	public:
+		MMBinaryLogSink() = default;
+		~MMBinaryLogSink();
+
+		MMBinaryLogSink(const MMBinaryLogSink &) = delete;
+		MMBinaryLogSink &operator=(const MMBinaryLogSink &) = delete;
+
+		bool Open(const std::filesystem::path &directory, plugify::Severity severity, size_t segmentSize, size_t maxFiles);
+		void Close();
+		bool IsOpen() const { return m_severity.load(std::memory_order_relaxed) != plugify::Severity::None; }
+		bool IsEnabled(plugify::Severity severity) const { return severity <= m_severity.load(std::memory_order_relaxed); }
+		BinaryLogStats GetStats() const;
+
+		template <typename... Args>
+		void Write(plugify::Severity severity, std::string_view source, std::string_view format, const Args &...args)
+		{
+			std::string &buffer = ArgBuffer();
+			buffer.clear();
+			(EncodeArg(buffer, args), ...);
+			Commit(severity, source, format, static_cast<uint8_t>(sizeof...(Args)), buffer);
+		}
+
+	private:
+		template <typename T>
+		static void Put(std::string &out, const T &value)
+		{
+			out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+		}
+
+		static void PutString(std::string &out, std::string_view str)
+		{
+			auto length = static_cast<uint16_t>(std::min<size_t>(str.size(), UINT16_MAX));
+			Put(out, blog::ArgType::String);
+			Put(out, length);
+			out.append(str.data(), length);
+		}
+
+		template <typename T>
+		static void EncodeArg(std::string &out, const T &value)
+		{
+			using U = std::remove_cvref_t<T>;
+			if constexpr (std::is_same_v<U, bool>)
+			{
+				Put(out, blog::ArgType::Bool);
+				Put(out, static_cast<uint8_t>(value));
+			}
+			else if constexpr (std::is_same_v<U, char>)
+			{
+				PutString(out, std::string_view(&value, 1));
+			}
+			else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>)
+			{
+				Put(out, blog::ArgType::Int);
+				Put(out, static_cast<int64_t>(value));
+			}
+			else if constexpr (std::is_integral_v<U>)
+			{
+				Put(out, blog::ArgType::UInt);
+				Put(out, static_cast<uint64_t>(value));
+			}
+			else if constexpr (std::is_floating_point_v<U>)
+			{
+				Put(out, blog::ArgType::Double);
+				Put(out, static_cast<double>(value));
+			}
+			else if constexpr (std::is_enum_v<U>)
+			{
+				Put(out, blog::ArgType::Int);
+				Put(out, static_cast<int64_t>(value));
+			}
+			else if constexpr (std::is_convertible_v<const U &, std::string_view>)
+			{
+				PutString(out, std::string_view(value));
+			}
+			else
+			{
+				PutString(out, std::format("{}", value));
+			}
+		}
+
+		static std::string &ArgBuffer();
+
+		void Commit(plugify::Severity severity, std::string_view source, std::string_view format, uint8_t argc, const std::string &args);
+		uint32_t InternSource(std::string_view source);
+		uint32_t InternFormat(std::string_view format);
+		bool Reserve(size_t size);
+		bool MapSegment();
+		void UnmapSegment();
+		void Append(const void *data, size_t size);
+		void AppendDefinition(blog::RecordType type, uint32_t id, std::string_view text);
+
+	private:
+		std::atomic<plugify::Severity> m_severity { plugify::Severity::None };
+
+		mutable std::mutex m_mutex;
+		std::filesystem::path m_directory;
+		std::filesystem::path m_path;
+		std::string m_prefix;
+		size_t m_segmentSize { 0 };
+		size_t m_maxFiles { 0 };
+		uint32_t m_sequence { 0 };
+		std::deque<std::filesystem::path> m_files;
+
+		void *m_handle { nullptr };
+		void *m_mapping { nullptr };
+		uint8_t *m_data { nullptr };
+		size_t m_offset { 0 };
+
+		std::unordered_map<std::string, uint32_t, StringHash, std::equal_to<>> m_sources;
+		std::unordered_map<const char *, uint32_t> m_formats;
+		std::vector<std::string_view> m_formatTexts;
+		std::vector<std::string_view> m_sourceTexts;
+		std::vector<bool> m_sourceDefined;
+		std::vector<bool> m_formatDefined;
+
+		uint64_t m_records { 0 };
+		uint64_t m_bytes { 0 };
+		uint64_t m_rotations { 0 };
+	};
+} // namespace plugifyMM
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+
+// On-disk layout of the binary log files written by MMBinaryLogSink.
+// Shared with tools/logdecode, so keep it free of plugify and SDK headers.
+// All integers are little-endian. Records are packed back to back after the
+// file header; a record size of zero marks the end of the written data.
+
+namespace plugifyMM::blog
+{
+	inline constexpr char kMagic[8] = { 'P', 'L', 'G', 'Y', 'B', 'L', 'O', 'G' };
+	inline constexpr uint16_t kVersion = 1;
+
+	struct FileHeader
+	{
+		char magic[8];
+		uint16_t version;
+		uint16_t reserved;
+		uint32_t sequence;
+		uint64_t created; // ns since unix epoch
+	};
+	static_assert(sizeof(FileHeader) == 24);
+
+	enum class RecordType : uint8_t
+	{
+		End = 0,
+		Format = 1, // u32 id, u16 length, bytes
+		Source = 2, // u32 id, u16 length, bytes
+		Entry = 3,  // u64 timestamp, u8 severity, u32 source id, u32 format id, u8 argc, args
+	};
+
+	enum class ArgType : uint8_t
+	{
+		Int = 1,    // i64
+		UInt = 2,   // u64
+		Double = 3, // f64
+		Bool = 4,   // u8
+		String = 5, // u16 length, bytes
+	};
+
+	// Every record starts with u32 total size (including this prefix) and u8 type.
+	inline constexpr uint32_t kRecordPrefix = sizeof(uint32_t) + sizeof(uint8_t);
+
+	inline constexpr const char *kSeverityNames[] = {
+		"none",
+		"fatal",
+		"error",
+		"warning",
+		"info",
+		"debug",
+		"verbose",
+	};
+} // namespace plugifyMM::blog
@@ -0,0 +1,301 @@
+#include "mm_dependency_graph.h"
+#include "mm_json.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <unordered_set>
+
+#include <plugify/compat_format.h>
+#include <plugify/package.h>
+#include <plugify/package_manager.h>
+
+using namespace plugifyMM;
+
+static constexpr std::string_view kLanguagePrefix = "language:";
+
+std::string MMDependencyGraph::DescribeKey(std::string_view key)
+{
+	if (key.starts_with(kLanguagePrefix))
+		return std::format("language module '{}'", key.substr(kLanguagePrefix.size()));
+	return std::format("'{}'", key);
+}
+
+MMDependencyGraph::Node MMDependencyGraph::ReadNode(std::string name, std::string type, int32_t version, std::filesystem::path manifest)
+{
+	Node node;
+	node.name = std::move(name);
+	node.type = std::move(type);
+	node.version = version;
+	node.manifest = std::move(manifest);
+
+	std::error_code ec;
+	node.mtime = std::filesystem::last_write_time(node.manifest, ec);
+
+	std::ifstream stream(node.manifest, std::ios::binary);
+	std::stringstream buffer;
+	buffer << stream.rdbuf();
+	if (!stream)
+	{
+		node.error = "cannot read manifest";
+		return node;
+	}
+
+	auto document = JsonValue::Parse(buffer.str(), node.error);
+	if (!document)
+		return node;
+
+	if (auto language = (*document)["language"].GetString())
+	{
+		node.language = *language;
+	}
+	if (auto language = (*document)["languageModule"]["name"].GetString())
+	{
+		node.requirements.push_back({ std::format("{}{}", kLanguagePrefix, *language), std::nullopt, false });
+	}
+	for (const auto &dependency : (*document)["dependencies"].GetArray())
+	{
+		auto dependencyName = dependency["name"].GetString();
+		if (!dependencyName)
+			continue;
+
+		Requirement requirement;
+		requirement.key = *dependencyName;
+		if (auto requested = dependency["requestedVersion"].GetInt())
+			requirement.version = static_cast<int32_t>(*requested);
+		requirement.optional = dependency["optional"].GetBool().value_or(false);
+		node.requirements.push_back(std::move(requirement));
+	}
+	return node;
+}
+
+size_t MMDependencyGraph::Sync(const plugify::IPackageManager &packageManager, bool rescan)
+{
+	return Sync(packageManager.GetLocalPackages(), rescan);
+}
+
+size_t MMDependencyGraph::Sync(const std::vector<plugify::LocalPackage> &packages, bool rescan)
+{
+	size_t changed = 0;
+	std::unordered_set<std::string_view> seen;
+	for (const auto &package : packages)
+	{
+		seen.insert(package.name);
+
+		auto it = m_nodes.find(package.name);
+		if (it != m_nodes.end())
+		{
+			const Node &node = it->second;
+			if (node.version == package.version && node.manifest == package.path)
+			{
+				std::error_code ec;
+				if (!rescan || std::filesystem::last_write_time(package.path, ec) == node.mtime)
+					continue;
+			}
+			Remove(package.name);
+		}
+		Add(ReadNode(package.name, package.type, package.version, package.path));
+		++changed;
+	}
+
+	std::vector<std::string> removed;
+	for (const auto &[name, node] : m_nodes)
+	{
+		if (!seen.contains(name))
+			removed.push_back(name);
+	}
+	for (const auto &name : removed)
+	{
+		Remove(name);
+		++changed;
+	}
+
+	for (const auto &key : m_dirty)
+	{
+		Resolve(key);
+	}
+	m_dirty.clear();
+	m_stale = false;
+	return changed;
+}
+
+void MMDependencyGraph::Add(Node node)
+{
+	m_dirty.insert(node.name);
+	if (!node.language.empty())
+	{
+		m_languages[node.language].insert(node.name);
+		m_dirty.insert(std::format("{}{}", kLanguagePrefix, node.language));
+	}
+	for (const auto &requirement : node.requirements)
+	{
+		m_requesters[requirement.key].insert(node.name);
+		m_dirty.insert(requirement.key);
+	}
+	auto name = node.name;
+	m_nodes.insert_or_assign(std::move(name), std::move(node));
+}
+
+void MMDependencyGraph::Remove(const std::string &name)
+{
+	auto it = m_nodes.find(name);
+	if (it == m_nodes.end())
+		return;
+
+	const Node &node = it->second;
+	m_dirty.insert(node.name);
+	if (!node.language.empty())
+	{
+		auto language = m_languages.find(node.language);
+		language->second.erase(node.name);
+		if (language->second.empty())
+			m_languages.erase(language);
+		m_dirty.insert(std::format("{}{}", kLanguagePrefix, node.language));
+	}
+	for (const auto &requirement : node.requirements)
+	{
+		auto requesters = m_requesters.find(requirement.key);
+		if (requesters == m_requesters.end())
+			continue; // listed twice in the manifest
+		requesters->second.erase(node.name);
+		if (requesters->second.empty())
+			m_requesters.erase(requesters);
+		m_dirty.insert(requirement.key);
+	}
+	m_nodes.erase(it);
+}
+
+const MMDependencyGraph::Node *MMDependencyGraph::FindProvider(std::string_view key) const
+{
+	if (key.starts_with(kLanguagePrefix))
+	{
+		auto it = m_languages.find(key.substr(kLanguagePrefix.size()));
+		if (it == m_languages.end())
+			return nullptr;
+		return &m_nodes.find(*it->second.begin())->second;
+	}
+	auto it = m_nodes.find(key);
+	return it != m_nodes.end() ? &it->second : nullptr;
+}
+
+void MMDependencyGraph::Resolve(const std::string &key)
+{
+	m_missing.erase(key);
+	m_conflicts.erase(key);
+
+	std::vector<std::string> missing;
+	std::vector<std::string> conflicts;
+	const Node *provider = FindProvider(key);
+
+	if (key.starts_with(kLanguagePrefix))
+	{
+		auto it = m_languages.find(std::string_view(key).substr(kLanguagePrefix.size()));
+		if (it != m_languages.end() && it->second.size() > 1)
+		{
+			std::string modules;
+			for (const auto &module : it->second)
+				std::format_to(std::back_inserter(modules), "{}'{}'", modules.empty() ? "" : ", ", module);
+			conflicts.push_back(std::format("{} is provided by {}", DescribeKey(key), modules));
+		}
+	}
+
+	auto requesters = m_requesters.find(key);
+	if (requesters != m_requesters.end())
+	{
+		std::set<int32_t> requested;
+		for (const auto &name : requesters->second)
+		{
+			const Node &node = m_nodes.find(name)->second;
+			auto requirement = std::find_if(node.requirements.begin(), node.requirements.end(), [&](const Requirement &r) { return r.key == key; });
+			if (requirement->version)
+				requested.insert(*requirement->version);
+
+			auto version = requirement->version ? std::format(" v{}", *requirement->version) : std::string();
+			if (!provider)
+			{
+				if (!requirement->optional)
+					missing.push_back(std::format("'{}' requires {}{}, which is not installed", name, DescribeKey(key), version));
+			}
+			else if (requirement->version && *requirement->version != provider->version)
+			{
+				conflicts.push_back(std::format("'{}' requires {}{}, but v{} is installed", name, DescribeKey(key), version, provider->version));
+			}
+		}
+
+		// Nothing installed can satisfy requesters that disagree on the version.
+		if (!provider && requested.size() > 1)
+		{
+			std::string versions;
+			for (int32_t version : requested)
+				std::format_to(std::back_inserter(versions), "{}v{}", versions.empty() ? "" : ", ", version);
+			conflicts.push_back(std::format("{} is requested at different versions: {}", DescribeKey(key), versions));
+		}
+	}
+
+	if (!missing.empty())
+		m_missing.emplace(key, std::move(missing));
+	if (!conflicts.empty())
+		m_conflicts.emplace(key, std::move(conflicts));
+}
+
+std::string MMDependencyGraph::Explain(std::string_view name) const
+{
+	auto it = m_nodes.find(name);
+	if (it == m_nodes.end())
+		return {};
+
+	const Node &node = it->second;
+	std::string sMessage = std::format("{} v{} ({})\n", node.name, node.version, node.type);
+	if (!node.error.empty())
+	{
+		std::format_to(std::back_inserter(sMessage), "  Manifest: {} - {}\n", node.manifest.string(), node.error);
+	}
+
+	if (!node.requirements.empty())
+	{
+		sMessage += "  Requires:\n";
+		for (const auto &requirement : node.requirements)
+		{
+			const Node *provider = FindProvider(requirement.key);
+			std::string status;
+			if (!provider)
+				status = requirement.optional ? "not installed (optional)" : "MISSING";
+			else if (requirement.version && *requirement.version != provider->version)
+				status = std::format("CONFLICT, '{}' v{} installed", provider->name, provider->version);
+			else
+				status = std::format("'{}' v{}", provider->name, provider->version);
+
+			auto version = requirement.version ? std::format(" v{}", *requirement.version) : std::string();
+			std::format_to(std::back_inserter(sMessage), "    {}{} - {}\n", DescribeKey(requirement.key), version, status);
+		}
+	}
+
+	auto addDependents = [&](const std::string &key)
+	{
+		auto requesters = m_requesters.find(key);
+		if (requesters == m_requesters.end())
+			return;
+		for (const auto &requester : requesters->second)
+			std::format_to(std::back_inserter(sMessage), "    {}\n", requester);
+	};
+	if (m_requesters.contains(node.name) || (!node.language.empty() && m_requesters.contains(std::format("{}{}", kLanguagePrefix, node.language))))
+	{
+		sMessage += "  Required by:\n";
+		addDependents(node.name);
+		if (!node.language.empty())
+			addDependents(std::format("{}{}", kLanguagePrefix, node.language));
+	}
+
+	for (const auto *issues : { &m_missing, &m_conflicts })
+	{
+		for (const auto &[key, reasons] : *issues)
+		{
+			for (const auto &reason : reasons)
+			{
+				if (key == node.name || reason.starts_with(std::format("'{}' ", node.name)))
+					std::format_to(std::back_inserter(sMessage), "  Issue: {}\n", reason);
+			}
+		}
+	}
+	return sMessage;
+}
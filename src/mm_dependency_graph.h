@@ -0,0 +1,90 @@
+#pragma once
+
+#include "mm_utils.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace plugify
+{
+	class IPackageManager;
+	struct LocalPackage;
+}
+
+namespace plugifyMM
+{
+	// Requirements between local packages, read from their manifests. Sync() only reparses
+	// manifests that changed and re-resolves the requirements those packages touch, so
+	// missing/conflict queries between package changes are answered from cached state.
+	// The core's HasMissedPackages()/HasConflictedPackages() stay authoritative; the graph
+	// explains their verdict. Not thread-safe: used from the main thread only.
+	class MMDependencyGraph
+	{
+	public:
+		// Requirement key -> human readable reasons.
+		using Issues = std::map<std::string, std::vector<std::string>, std::less<>>;
+
+		// Returns the number of packages that were added, changed or removed. Packages are
+		// compared by version and manifest path, which the core already holds; 'rescan' also
+		// stats every manifest to catch edits that kept the version.
+		size_t Sync(const plugify::IPackageManager &packageManager, bool rescan = false);
+		size_t Sync(const std::vector<plugify::LocalPackage> &packages, bool rescan = false);
+
+		// Marks the graph out of date, e.g. after a package job ran.
+		void Invalidate() { m_stale = true; }
+		bool IsStale() const { return m_stale; }
+
+		bool HasMissing() const { return !m_missing.empty(); }
+		bool HasConflicts() const { return !m_conflicts.empty(); }
+		const Issues &GetMissing() const { return m_missing; }
+		const Issues &GetConflicts() const { return m_conflicts; }
+		size_t GetPackageCount() const { return m_nodes.size(); }
+
+		// Requirements, dependents and issues of one package; empty if it is not installed.
+		std::string Explain(std::string_view name) const;
+
+		static std::string DescribeKey(std::string_view key);
+
+	private:
+		struct Requirement
+		{
+			std::string key; // package name, or "language:<name>" for a plugin's language module
+			std::optional<int32_t> version;
+			bool optional { false };
+		};
+
+		struct Node
+		{
+			std::string name;
+			std::string type;
+			int32_t version { 0 };
+			std::filesystem::path manifest;
+			std::filesystem::file_time_type mtime;
+			std::string language; // language provided by a module
+			std::vector<Requirement> requirements;
+			std::string error;
+		};
+
+		static Node ReadNode(std::string name, std::string type, int32_t version, std::filesystem::path manifest);
+		const Node *FindProvider(std::string_view key) const;
+		void Add(Node node);
+		void Remove(const std::string &name);
+		void Resolve(const std::string &key);
+
+	private:
+		std::unordered_map<std::string, Node, StringHash, std::equal_to<>> m_nodes;
+		std::unordered_map<std::string, std::set<std::string>, StringHash, std::equal_to<>> m_requesters; // key -> requiring packages
+		std::unordered_map<std::string, std::set<std::string>, StringHash, std::equal_to<>> m_languages; // language -> modules
+		std::set<std::string> m_dirty;
+		Issues m_missing;
+		Issues m_conflicts;
+		bool m_stale { true };
+	};
+} // namespace plugifyMM
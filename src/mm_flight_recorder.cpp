@@ -0,0 +1,382 @@
+#include "mm_flight_recorder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace plugifyMM;
+
+static constexpr const char *kEventNames[] = {
+	"log",
+	"lifecycle",
+	"command",
+	"package",
+};
+
+static constexpr const char *kSeverityNames[] = {
+	"none",
+	"fatal",
+	"error",
+	"warning",
+	"info",
+	"debug",
+	"verbose",
+};
+
+static uint64_t SteadyNanoseconds()
+{
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+namespace
+{
+	// Minimal append-only writer; no allocation or locale, usable from a signal handler.
+	struct SafeWriter
+	{
+		char *out;
+		size_t size;
+		size_t length { 0 };
+
+		void Put(char c)
+		{
+			if (length < size)
+				out[length++] = c;
+		}
+
+		void Put(const char *str, size_t count)
+		{
+			for (size_t i = 0; i < count; ++i)
+				Put(str[i]);
+		}
+
+		void Put(const char *str) { Put(str, std::strlen(str)); }
+
+		void PutUInt(uint64_t value, int width = 0)
+		{
+			char digits[24];
+			int count = 0;
+			do
+			{
+				digits[count++] = static_cast<char>('0' + value % 10);
+				value /= 10;
+			} while (value);
+			for (int i = count; i < width; ++i)
+				Put('0');
+			while (count)
+				Put(digits[--count]);
+		}
+	};
+} // namespace
+
+namespace plugifyMM
+{
+	struct FlightRecorderCrash
+	{
+		static inline std::atomic<MMFlightRecorder *> s_pRecorder { nullptr };
+
+		static void Write()
+		{
+			MMFlightRecorder *recorder = s_pRecorder.load(std::memory_order_acquire);
+			if (!recorder || !recorder->m_crashFile[0])
+				return;
+
+#if defined(_WIN32)
+			int fd = _open(recorder->m_crashFile, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+			int fd = open(recorder->m_crashFile, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+#endif
+			if (fd < 0)
+				return;
+
+			recorder->WriteTo(fd);
+
+#if defined(_WIN32)
+			_close(fd);
+#else
+			close(fd);
+#endif
+		}
+
+#if defined(_WIN32)
+		static inline LPTOP_LEVEL_EXCEPTION_FILTER s_previousFilter = nullptr;
+		static inline void (*s_previousAbort)(int) = nullptr;
+
+		static LONG WINAPI OnException(EXCEPTION_POINTERS *info)
+		{
+			Write();
+			return s_previousFilter ? s_previousFilter(info) : EXCEPTION_CONTINUE_SEARCH;
+		}
+
+		static void OnAbort(int sig)
+		{
+			Write();
+			std::signal(sig, s_previousAbort ? s_previousAbort : SIG_DFL);
+			std::raise(sig);
+		}
+#else
+		static constexpr int kSignals[] = { SIGSEGV, SIGABRT, SIGBUS, SIGILL, SIGFPE };
+		static inline struct sigaction s_previous[std::size(kSignals)] {};
+
+		// Lets the handler run on a stack overflow of the thread that installed it.
+		static constexpr size_t kAltStackSize = 64 * 1024;
+		static inline char s_altStack[kAltStackSize];
+		static inline stack_t s_previousAltStack {};
+		static inline bool s_altStackInstalled = false;
+
+		static void OnSignal(int sig, siginfo_t *info, void *context)
+		{
+			Write();
+
+			// Hand the signal to whoever was installed before us (engine crash reporter or default).
+			for (size_t i = 0; i < std::size(kSignals); ++i)
+			{
+				if (kSignals[i] != sig)
+					continue;
+
+				const struct sigaction &previous = s_previous[i];
+				if (previous.sa_flags & SA_SIGINFO)
+				{
+					if (previous.sa_sigaction)
+					{
+						previous.sa_sigaction(sig, info, context);
+						return;
+					}
+				}
+				else if (previous.sa_handler != SIG_DFL && previous.sa_handler != SIG_IGN)
+				{
+					previous.sa_handler(sig);
+					return;
+				}
+				sigaction(sig, &previous, nullptr);
+				break;
+			}
+			raise(sig);
+		}
+#endif
+	};
+} // namespace plugifyMM
+
+MMFlightRecorder::MMFlightRecorder() : m_start(SteadyNanoseconds())
+{
+	auto now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+	std::strftime(m_startTime, sizeof(m_startTime), "%Y-%m-%d %H:%M:%S", std::localtime(&now));
+}
+
+void MMFlightRecorder::Record(FlightEvent event, plugify::Severity severity, std::string_view source, std::string_view text)
+{
+	uint64_t index = m_next.fetch_add(1, std::memory_order_relaxed);
+	Entry &entry = m_entries[index % kCapacity];
+
+	entry.sequence.store(index * 2 + 1, std::memory_order_release);
+
+	size_t sourceLength = std::min<size_t>(source.size(), 32);
+	size_t textLength = std::min(text.size(), kTextSize - sourceLength);
+	while (textLength && (text[textLength - 1] == '\n' || text[textLength - 1] == '\r'))
+		--textLength;
+
+	entry.timestamp = SteadyNanoseconds();
+	entry.event = event;
+	entry.severity = severity;
+	entry.sourceLength = static_cast<uint8_t>(sourceLength);
+	entry.textLength = static_cast<uint8_t>(textLength);
+	std::memcpy(entry.text, source.data(), sourceLength);
+	std::memcpy(entry.text + sourceLength, text.data(), textLength);
+
+	entry.sequence.store(index * 2 + 2, std::memory_order_release);
+}
+
+void MMFlightRecorder::InstallCrashHandler(const std::filesystem::path &crashFile)
+{
+	std::error_code ec;
+	std::filesystem::create_directories(crashFile.parent_path(), ec);
+
+	std::string path = crashFile.string();
+	size_t length = std::min(path.size(), sizeof(m_crashFile) - 1);
+	std::memcpy(m_crashFile, path.data(), length);
+	m_crashFile[length] = '\0';
+
+	if (FlightRecorderCrash::s_pRecorder.exchange(this, std::memory_order_acq_rel))
+		return;
+
+#if defined(_WIN32)
+	FlightRecorderCrash::s_previousFilter = SetUnhandledExceptionFilter(&FlightRecorderCrash::OnException);
+	FlightRecorderCrash::s_previousAbort = std::signal(SIGABRT, &FlightRecorderCrash::OnAbort);
+#else
+	// Keep an alternate stack someone else set up; otherwise provide one for this thread.
+	stack_t stack {};
+	stack.ss_sp = FlightRecorderCrash::s_altStack;
+	stack.ss_size = FlightRecorderCrash::kAltStackSize;
+	if (sigaltstack(nullptr, &FlightRecorderCrash::s_previousAltStack) == 0 && (FlightRecorderCrash::s_previousAltStack.ss_flags & SS_DISABLE))
+	{
+		FlightRecorderCrash::s_altStackInstalled = sigaltstack(&stack, nullptr) == 0;
+	}
+
+	struct sigaction action {};
+	action.sa_sigaction = &FlightRecorderCrash::OnSignal;
+	action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+	sigemptyset(&action.sa_mask);
+	for (size_t i = 0; i < std::size(FlightRecorderCrash::kSignals); ++i)
+	{
+		sigaction(FlightRecorderCrash::kSignals[i], &action, &FlightRecorderCrash::s_previous[i]);
+	}
+#endif
+}
+
+void MMFlightRecorder::RemoveCrashHandler()
+{
+	if (FlightRecorderCrash::s_pRecorder.load(std::memory_order_acquire) != this)
+		return;
+
+#if defined(_WIN32)
+	SetUnhandledExceptionFilter(FlightRecorderCrash::s_previousFilter);
+	std::signal(SIGABRT, FlightRecorderCrash::s_previousAbort ? FlightRecorderCrash::s_previousAbort : SIG_DFL);
+#else
+	for (size_t i = 0; i < std::size(FlightRecorderCrash::kSignals); ++i)
+	{
+		sigaction(FlightRecorderCrash::kSignals[i], &FlightRecorderCrash::s_previous[i], nullptr);
+	}
+	if (FlightRecorderCrash::s_altStackInstalled)
+	{
+		sigaltstack(&FlightRecorderCrash::s_previousAltStack, nullptr);
+		FlightRecorderCrash::s_altStackInstalled = false;
+	}
+#endif
+
+	FlightRecorderCrash::s_pRecorder.store(nullptr, std::memory_order_release);
+}
+
+size_t MMFlightRecorder::Format(const Entry &entry, uint64_t sequence, char *out, size_t size) const
+{
+	SafeWriter writer { out, size };
+
+	uint64_t elapsed = entry.timestamp > m_start ? entry.timestamp - m_start : 0;
+	writer.Put('+');
+	writer.PutUInt(elapsed / 1000000000);
+	writer.Put('.');
+	writer.PutUInt((elapsed % 1000000000) / 1000, 6);
+	writer.Put(" #");
+	writer.PutUInt(sequence);
+	writer.Put(" [");
+	auto event = static_cast<size_t>(entry.event);
+	writer.Put(event < std::size(kEventNames) ? kEventNames[event] : "unknown");
+	if (entry.event == FlightEvent::Log)
+	{
+		writer.Put(':');
+		auto severity = static_cast<size_t>(entry.severity);
+		writer.Put(severity < std::size(kSeverityNames) ? kSeverityNames[severity] : "unknown");
+	}
+	writer.Put("] ");
+	if (entry.sourceLength)
+	{
+		writer.Put('[');
+		writer.Put(entry.text, entry.sourceLength);
+		writer.Put("] ");
+	}
+	writer.Put(entry.text + entry.sourceLength, entry.textLength);
+	writer.Put('\n');
+
+	return writer.length;
+}
+
+void MMFlightRecorder::WriteTo(int fd) const
+{
+	auto write = [fd](const char *data, size_t size)
+	{
+#if defined(_WIN32)
+		_write(fd, data, static_cast<unsigned int>(size));
+#else
+		while (size)
+		{
+			ssize_t written = ::write(fd, data, size);
+			if (written <= 0)
+				break;
+			data += written;
+			size -= static_cast<size_t>(written);
+		}
+#endif
+	};
+
+	char line[kTextSize + 128];
+	SafeWriter header { line, sizeof(line) };
+	header.Put("plugify flight recorder, started ");
+	header.Put(m_startTime);
+	header.Put(", ");
+	header.PutUInt(m_next.load(std::memory_order_relaxed));
+	header.Put(" records\n");
+	write(line, header.length);
+
+	uint64_t end = m_next.load(std::memory_order_acquire);
+	uint64_t begin = end > kCapacity ? end - kCapacity : 0;
+	for (uint64_t index = begin; index < end; ++index)
+	{
+		const Entry &entry = m_entries[index % kCapacity];
+		if (entry.sequence.load(std::memory_order_acquire) != index * 2 + 2)
+			continue;
+
+		size_t length = Format(entry, index, line, sizeof(line));
+
+		// Skip records overwritten while we were formatting them.
+		if (entry.sequence.load(std::memory_order_acquire) != index * 2 + 2)
+			continue;
+
+		write(line, length);
+	}
+}
+
+bool MMFlightRecorder::Dump(const std::filesystem::path &file) const
+{
+	std::error_code ec;
+	std::filesystem::create_directories(file.parent_path(), ec);
+
+#if defined(_WIN32)
+	int fd = _wopen(file.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+	int fd = open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+#endif
+	if (fd < 0)
+		return false;
+
+	WriteTo(fd);
+
+#if defined(_WIN32)
+	_close(fd);
+#else
+	close(fd);
+#endif
+	return true;
+}
+
+std::string MMFlightRecorder::Tail(size_t count) const
+{
+	std::string out;
+	char line[kTextSize + 128];
+
+	uint64_t end = m_next.load(std::memory_order_acquire);
+	uint64_t begin = end > std::min(count, kCapacity) ? end - std::min(count, kCapacity) : 0;
+	for (uint64_t index = begin; index < end; ++index)
+	{
+		const Entry &entry = m_entries[index % kCapacity];
+		if (entry.sequence.load(std::memory_order_acquire) != index * 2 + 2)
+			continue;
+
+		size_t length = Format(entry, index, line, sizeof(line));
+		if (entry.sequence.load(std::memory_order_acquire) != index * 2 + 2)
+			continue;
+
+		out.append(line, length);
+	}
+	return out;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+#include <plugify/log.h>
+
+namespace plugifyMM
+{
+	enum class FlightEvent : uint8_t
+	{
+		Log,
+		Lifecycle,
+		Command,
+		Package,
+	};
+
+	// Fixed-size ring of recent log lines and lifecycle events. Recording is a
+	// single atomic increment plus a memcpy; the crash handler only uses
+	// async-signal-safe calls to write the ring to a file prepared in advance.
+	class MMFlightRecorder
+	{
+	public:
+		static constexpr size_t kCapacity = 4096;
+		static constexpr size_t kTextSize = 232;
+
+		MMFlightRecorder();
+
+		void Record(FlightEvent event, plugify::Severity severity, std::string_view source, std::string_view text);
+		void Record(FlightEvent event, std::string_view text) { Record(event, plugify::Severity::Info, {}, text); }
+
+		bool IsEnabled(plugify::Severity severity) const { return severity <= m_severity.load(std::memory_order_relaxed); }
+		void SetSeverity(plugify::Severity severity) { m_severity.store(severity, std::memory_order_relaxed); }
+
+		void InstallCrashHandler(const std::filesystem::path &crashFile);
+		void RemoveCrashHandler();
+
+		bool Dump(const std::filesystem::path &file) const;
+		std::string Tail(size_t count) const;
+
+	private:
+		struct Entry
+		{
+			std::atomic<uint64_t> sequence;
+			uint64_t timestamp;
+			FlightEvent event;
+			plugify::Severity severity;
+			uint8_t sourceLength;
+			uint8_t textLength;
+			char text[kTextSize];
+		};
+		static_assert(sizeof(Entry) == 256);
+
+		friend struct FlightRecorderCrash;
+
+		size_t Format(const Entry &entry, uint64_t sequence, char *out, size_t size) const;
+		void WriteTo(int fd) const;
+
+	private:
+		std::atomic<plugify::Severity> m_severity { plugify::Severity::Info };
+		std::atomic<uint64_t> m_next { 0 };
+		uint64_t m_start { 0 };
+		char m_startTime[32] {};
+		char m_crashFile[1024] {};
+		std::array<Entry, kCapacity> m_entries {};
+	};
+} // namespace plugifyMM
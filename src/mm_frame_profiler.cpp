@@ -0,0 +1,193 @@
+#include "mm_frame_profiler.h"
+#include "mm_metrics.h"
+
+#include <algorithm>
+#include <bit>
+#include <vector>
+
+#include <plugify/compat_format.h>
+
+using namespace plugifyMM;
+
+size_t MMFrameHistogram::ToBucket(uint64_t value)
+{
+	if (value < kLinear)
+		return static_cast<size_t>(value);
+
+	size_t log = static_cast<size_t>(std::bit_width(value) - 1); // >= 6
+	size_t sub = static_cast<size_t>((value >> (log - 3)) & 7);
+	return std::min(kLinear + (log - 6) * 8 + sub, kBuckets - 1);
+}
+
+uint64_t MMFrameHistogram::FromBucket(size_t bucket)
+{
+	if (bucket < kLinear)
+		return bucket;
+
+	size_t log = (bucket - kLinear) / 8 + 6;
+	uint64_t sub = (bucket - kLinear) % 8;
+	return (uint64_t{ 8 } + sub) << (log - 3);
+}
+
+void MMFrameHistogram::Record(uint64_t value)
+{
+	++m_buckets[ToBucket(value)];
+	++m_count;
+	m_sum += value;
+	m_max = std::max(m_max, value);
+}
+
+void MMFrameHistogram::Reset()
+{
+	m_buckets.fill(0);
+	m_count = 0;
+	m_sum = 0;
+	m_max = 0;
+}
+
+uint64_t MMFrameHistogram::GetPercentile(double percentile) const
+{
+	if (m_count == 0)
+		return 0;
+
+	auto rank = static_cast<uint64_t>(percentile * static_cast<double>(m_count - 1) / 100.0) + 1;
+	uint64_t seen = 0;
+	for (size_t i = 0; i < kBuckets; ++i)
+	{
+		seen += m_buckets[i];
+		if (seen >= rank)
+			return std::min((FromBucket(i) + FromBucket(i + 1)) / 2, m_max); // bucket midpoint
+	}
+	return m_max;
+}
+
+size_t MMFrameProfiler::Register(std::string_view name, bool reported)
+{
+	std::scoped_lock lock(m_mutex);
+	size_t count = m_count.load(std::memory_order_relaxed);
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (m_slots[i].name == name)
+			return i;
+	}
+	if (count == kMaxSlots)
+		return kInvalidSlot;
+
+	m_slots[count].name = name;
+	m_slots[count].reported = reported;
+	m_count.store(count + 1, std::memory_order_release);
+	return count;
+}
+
+void MMFrameProfiler::Add(size_t slot, uint64_t nanoseconds)
+{
+	if (slot < m_count.load(std::memory_order_acquire))
+		m_slots[slot].pending.fetch_add(nanoseconds, std::memory_order_relaxed);
+}
+
+void MMFrameProfiler::BeginTick()
+{
+	m_tickStart = Clock::now();
+	m_inTick = true;
+}
+
+void MMFrameProfiler::EndTick()
+{
+	if (!m_inTick)
+		return;
+	m_inTick = false;
+
+	auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - m_tickStart);
+	m_ticks.Record(static_cast<uint64_t>(elapsed.count()));
+
+	size_t count = m_count.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
+	{
+		auto &slot = m_slots[i];
+		slot.histogram.Record(slot.pending.exchange(0, std::memory_order_relaxed) / 1000);
+	}
+}
+
+void MMFrameProfiler::Reset()
+{
+	m_ticks.Reset();
+	size_t count = m_count.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
+	{
+		m_slots[i].pending.store(0, std::memory_order_relaxed);
+		m_slots[i].histogram.Reset();
+	}
+	m_since = Clock::now();
+}
+
+std::string MMFrameProfiler::Format() const
+{
+	auto seconds = std::chrono::duration_cast<std::chrono::seconds>(Clock::now() - m_since).count();
+	std::string out = std::format("Frame time over {} ticks in {}s (microseconds per tick):\n", m_ticks.GetCount(), seconds);
+	std::format_to(std::back_inserter(out), "  {:<32} {:>8} {:>8} {:>8} {:>7}\n", "", "p50", "p99", "max", "share");
+
+	auto row = [&](std::string_view name, const MMFrameHistogram &histogram)
+	{
+		double share = m_ticks.GetSum() ? 100.0 * static_cast<double>(histogram.GetSum()) / static_cast<double>(m_ticks.GetSum()) : 0.0;
+		std::format_to(std::back_inserter(out), "  {:<32} {:>8} {:>8} {:>8} {:>6.1f}%\n", name, histogram.GetPercentile(50), histogram.GetPercentile(99), histogram.GetMax(), share);
+	};
+	row("GameFrame (pre to post hook)", m_ticks);
+
+	std::vector<const Slot *> slots;
+	size_t count = m_count.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
+	{
+		slots.push_back(&m_slots[i]);
+	}
+	std::sort(slots.begin(), slots.end(), [](const Slot *a, const Slot *b) { return a->histogram.GetSum() > b->histogram.GetSum(); });
+	for (const Slot *slot : slots)
+	{
+		if (!slot->reported)
+			row(slot->name, slot->histogram);
+	}
+
+	out += "Reported by language SDKs through Plugify_PerfAdd():\n";
+	bool reported = false;
+	for (const Slot *slot : slots)
+	{
+		if (slot->reported)
+		{
+			row(slot->name, slot->histogram);
+			reported = true;
+		}
+	}
+	if (!reported)
+	{
+		out += "  Nothing yet; no time is attributed to single plugins or modules until their SDK reports it.\n";
+	}
+	return out;
+}
+
+void MMFrameProfiler::FormatMetrics(std::string &out) const
+{
+	auto summary = [&](std::string_view metric, std::string_view labels, const MMFrameHistogram &histogram)
+	{
+		for (double quantile : { 0.5, 0.99 })
+		{
+			std::format_to(std::back_inserter(out), "{}{{{}{}quantile=\"{}\"}} {}\n", metric, labels, labels.empty() ? "" : ",", quantile, static_cast<double>(histogram.GetPercentile(quantile * 100.0)) / 1e6);
+		}
+		auto braced = labels.empty() ? std::string() : std::format("{{{}}}", labels);
+		std::format_to(std::back_inserter(out), "{}_sum{} {}\n", metric, braced, static_cast<double>(histogram.GetSum()) / 1e6);
+		std::format_to(std::back_inserter(out), "{}_count{} {}\n", metric, braced, histogram.GetCount());
+	};
+
+	out += "# HELP plugify_gameframe_seconds Time between plugify's GameFrame pre- and post-hook.\n# TYPE plugify_gameframe_seconds summary\n";
+	summary("plugify_gameframe_seconds", "", m_ticks);
+	std::format_to(std::back_inserter(out), "# TYPE plugify_gameframe_max_seconds gauge\nplugify_gameframe_max_seconds {}\n", static_cast<double>(m_ticks.GetMax()) / 1e6);
+
+	out += "# HELP plugify_callback_seconds Time per tick measured by plugify (reported=\"false\") or reported by a language SDK through Plugify_PerfAdd().\n# TYPE plugify_callback_seconds summary\n";
+	std::string labels;
+	size_t count = m_count.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
+	{
+		labels = "name=\"";
+		AppendMetricLabel(labels, m_slots[i].name);
+		labels += m_slots[i].reported ? "\",reported=\"true\"" : "\",reported=\"false\"";
+		summary("plugify_callback_seconds", labels, m_slots[i].histogram);
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+namespace plugifyMM
+{
+	// Log-linear histogram of microseconds: exact below 64, then 8 buckets per power of two.
+	class MMFrameHistogram
+	{
+	public:
+		void Record(uint64_t value);
+		void Reset();
+
+		uint64_t GetPercentile(double percentile) const;
+		uint64_t GetMax() const { return m_max; }
+		uint64_t GetCount() const { return m_count; }
+		uint64_t GetSum() const { return m_sum; }
+
+	private:
+		static constexpr size_t kLinear = 64;
+		static constexpr size_t kBuckets = kLinear + 64 * 8;
+
+		static size_t ToBucket(uint64_t value);
+		static uint64_t FromBucket(size_t bucket);
+
+	private:
+		std::array<uint32_t, kBuckets> m_buckets {};
+		uint64_t m_count { 0 };
+		uint64_t m_sum { 0 };
+		uint64_t m_max { 0 };
+	};
+
+	// Per-tick time of the GameFrame span between plugify's pre- and post-hook, which covers the
+	// game and whatever hooks run in between rather than any single plugin. Per-plugin and
+	// per-module rows only exist once a language SDK times its own callback dispatch and reports
+	// it through Plugify_PerfAdd(); until then only work plugify itself dispatches is shown.
+	// Slots are summed per tick and folded into histograms from the post-hook; reporting is one
+	// relaxed atomic add.
+	class MMFrameProfiler
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		static constexpr size_t kMaxSlots = 256;
+		static constexpr size_t kInvalidSlot = static_cast<size_t>(-1);
+
+		// Returns the slot of 'name', creating it on first use; kInvalidSlot when full.
+		// 'reported' is false for work plugify measures around its own dispatch.
+		size_t Register(std::string_view name, bool reported = true);
+		void Add(size_t slot, uint64_t nanoseconds);
+
+		void BeginTick();
+		void EndTick();
+		void Reset();
+
+		std::string Format() const;
+		// Prometheus summaries of tick and per-slot time since the last reset.
+		void FormatMetrics(std::string &out) const;
+
+	private:
+		struct Slot
+		{
+			std::string name;
+			bool reported { true };
+			std::atomic<uint64_t> pending { 0 }; // nanoseconds in the current tick
+			MMFrameHistogram histogram;
+		};
+
+	private:
+		std::mutex m_mutex; // guards registration
+		std::array<Slot, kMaxSlots> m_slots;
+		std::atomic<size_t> m_count { 0 };
+		MMFrameHistogram m_ticks;
+		Clock::time_point m_tickStart;
+		Clock::time_point m_since { Clock::now() };
+		bool m_inTick { false };
+	};
+} // namespace plugifyMM
@@ -0,0 +1,326 @@
+#include "mm_http.h"
+
+#include <algorithm>
+#include <cctype>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include <plugify/compat_format.h>
+
+#if !defined(_WIN32)
+#include <curl/curl.h>
+#endif
+
+using namespace plugifyMM;
+
+#if defined(_WIN32)
+
+MMHttpClient::MMHttpClient() = default;
+MMHttpClient::~MMHttpClient() = default;
+
+bool MMHttpClient::IsSupported()
+{
+	return false;
+}
+
+void MMHttpClient::SetOptions(const HttpOptions &options)
+{
+	std::lock_guard lock(m_optionsMutex);
+	m_options = options;
+}
+
+HttpOptions MMHttpClient::GetOptions() const
+{
+	std::lock_guard lock(m_optionsMutex);
+	return m_options;
+}
+
+std::vector<HttpResponse> MMHttpClient::Perform(std::vector<HttpRequest> &requests, const std::atomic<bool> *)
+{
+	std::vector<HttpResponse> responses(requests.size());
+	for (auto &response : responses)
+	{
+		response.error = "Parallel downloads are not supported on this platform";
+	}
+	return responses;
+}
+
+void *MMHttpClient::AcquireHandle()
+{
+	return nullptr;
+}
+
+#else
+
+namespace
+{
+	struct Transfer
+	{
+		HttpRequest *request;
+		HttpResponse *response;
+		curl_slist *headers { nullptr };
+		CURL *handle { nullptr };
+		std::chrono::steady_clock::time_point notBefore;
+	};
+
+	size_t OnWrite(char *data, size_t size, size_t count, void *user)
+	{
+		auto *transfer = static_cast<Transfer *>(user);
+		size_t length = size * count;
+		if (transfer->request->onData)
+			return transfer->request->onData(data, length) ? length : 0;
+
+		transfer->response->body.append(data, length);
+		return length;
+	}
+
+	size_t OnHeader(char *data, size_t size, size_t count, void *user)
+	{
+		auto *transfer = static_cast<Transfer *>(user);
+		size_t length = size * count;
+
+		std::string_view line(data, length);
+		size_t colon = line.find(':');
+		if (colon == std::string_view::npos)
+		{
+			// Status line of a new response (redirect or retry): forget earlier headers.
+			if (line.starts_with("HTTP/"))
+				transfer->response->headers.clear();
+			return length;
+		}
+
+		std::string name(line.substr(0, colon));
+		std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+		std::string_view value = line.substr(colon + 1);
+		while (!value.empty() && std::isspace(static_cast<unsigned char>(value.front())))
+			value.remove_prefix(1);
+		while (!value.empty() && std::isspace(static_cast<unsigned char>(value.back())))
+			value.remove_suffix(1);
+
+		transfer->response->headers[std::move(name)] = value;
+		return length;
+	}
+
+	bool IsTransient(CURLcode code, long status)
+	{
+		switch (code)
+		{
+			case CURLE_OK:
+				return status == 429 || status >= 500;
+			case CURLE_COULDNT_RESOLVE_HOST:
+			case CURLE_COULDNT_CONNECT:
+			case CURLE_PARTIAL_FILE:
+			case CURLE_OPERATION_TIMEDOUT:
+			case CURLE_GOT_NOTHING:
+			case CURLE_SEND_ERROR:
+			case CURLE_RECV_ERROR:
+			case CURLE_HTTP2:
+			case CURLE_HTTP2_STREAM:
+				return true;
+			default:
+				return false;
+		}
+	}
+} // namespace
+
+MMHttpClient::MMHttpClient()
+{
+	static std::once_flag s_init;
+	std::call_once(s_init, [] { curl_global_init(CURL_GLOBAL_DEFAULT); });
+}
+
+MMHttpClient::~MMHttpClient()
+{
+	for (void *handle : m_handles)
+	{
+		curl_easy_cleanup(handle);
+	}
+	if (m_multi)
+	{
+		curl_multi_cleanup(m_multi);
+	}
+}
+
+bool MMHttpClient::IsSupported()
+{
+	return true;
+}
+
+// Takes effect from the next batch; a running batch keeps the options it started with.
+void MMHttpClient::SetOptions(const HttpOptions &options)
+{
+	std::lock_guard lock(m_optionsMutex);
+	m_options = options;
+	m_options.parallelism = std::max<size_t>(m_options.parallelism, 1);
+	m_options.hostConnections = std::max<size_t>(m_options.hostConnections, 1);
+}
+
+HttpOptions MMHttpClient::GetOptions() const
+{
+	std::lock_guard lock(m_optionsMutex);
+	return m_options;
+}
+
+void *MMHttpClient::AcquireHandle()
+{
+	if (!m_handles.empty())
+	{
+		CURL *handle = m_handles.back();
+		m_handles.pop_back();
+		curl_easy_reset(handle);
+		return handle;
+	}
+	return curl_easy_init();
+}
+
+std::vector<HttpResponse> MMHttpClient::Perform(std::vector<HttpRequest> &requests, const std::atomic<bool> *cancel)
+{
+	HttpOptions options = GetOptions();
+
+	// One batch at a time; the multi handle and its connection cache are shared between batches.
+	std::lock_guard lock(m_batchMutex);
+
+	if (!m_multi)
+	{
+		m_multi = curl_multi_init();
+		curl_multi_setopt(m_multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+	}
+	curl_multi_setopt(m_multi, CURLMOPT_MAX_HOST_CONNECTIONS, static_cast<long>(options.hostConnections));
+	curl_multi_setopt(m_multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, static_cast<long>(options.parallelism));
+
+	std::vector<HttpResponse> responses(requests.size());
+	std::vector<Transfer> transfers(requests.size());
+	std::deque<size_t> pending;
+	for (size_t i = 0; i < requests.size(); ++i)
+	{
+		transfers[i].request = &requests[i];
+		transfers[i].response = &responses[i];
+		for (const auto &header : requests[i].headers)
+		{
+			transfers[i].headers = curl_slist_append(transfers[i].headers, header.c_str());
+		}
+		pending.push_back(i);
+	}
+
+	auto start = [&](size_t index)
+	{
+		Transfer &transfer = transfers[index];
+		CURL *handle = AcquireHandle();
+		curl_easy_setopt(handle, CURLOPT_URL, transfer.request->url.c_str());
+		curl_easy_setopt(handle, CURLOPT_FOLLOWLOCATION, 1L);
+		curl_easy_setopt(handle, CURLOPT_MAXREDIRS, 8L);
+		curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+		curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+		curl_easy_setopt(handle, CURLOPT_CONNECTTIMEOUT, 30L);
+		curl_easy_setopt(handle, CURLOPT_TIMEOUT, static_cast<long>(options.timeout.count()));
+		curl_easy_setopt(handle, CURLOPT_USERAGENT, "plugify");
+		curl_easy_setopt(handle, CURLOPT_HTTPHEADER, transfer.headers);
+		curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, &OnWrite);
+		curl_easy_setopt(handle, CURLOPT_WRITEDATA, &transfer);
+		curl_easy_setopt(handle, CURLOPT_HEADERFUNCTION, &OnHeader);
+		curl_easy_setopt(handle, CURLOPT_HEADERDATA, &transfer);
+		curl_easy_setopt(handle, CURLOPT_PRIVATE, &transfer);
+		++transfer.response->attempts;
+		transfer.handle = handle;
+		curl_multi_add_handle(m_multi, handle);
+	};
+
+	size_t active = 0;
+	while (active || !pending.empty())
+	{
+		if (cancel && cancel->load(std::memory_order_relaxed))
+		{
+			for (size_t index : pending)
+			{
+				responses[index].error = "Cancelled";
+			}
+			pending.clear();
+
+			for (auto &transfer : transfers)
+			{
+				if (!transfer.handle)
+					continue;
+				curl_multi_remove_handle(m_multi, transfer.handle);
+				m_handles.push_back(transfer.handle);
+				transfer.handle = nullptr;
+				transfer.response->error = "Cancelled";
+			}
+			active = 0;
+			break;
+		}
+
+		auto now = std::chrono::steady_clock::now();
+		for (auto it = pending.begin(); it != pending.end() && active < options.parallelism;)
+		{
+			if (transfers[*it].notBefore > now)
+			{
+				++it;
+				continue;
+			}
+			start(*it);
+			it = pending.erase(it);
+			++active;
+		}
+
+		int running = 0;
+		curl_multi_perform(m_multi, &running);
+
+		int queued = 0;
+		while (CURLMsg *message = curl_multi_info_read(m_multi, &queued))
+		{
+			if (message->msg != CURLMSG_DONE)
+				continue;
+
+			CURL *handle = message->easy_handle;
+			CURLcode code = message->data.result;
+			Transfer *transfer = nullptr;
+			long status = 0;
+			curl_easy_getinfo(handle, CURLINFO_PRIVATE, reinterpret_cast<char **>(&transfer));
+			curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &status);
+			curl_multi_remove_handle(m_multi, handle);
+			m_handles.push_back(handle);
+			transfer->handle = nullptr;
+			--active;
+
+			HttpResponse &response = *transfer->response;
+			response.status = status;
+
+			if (IsTransient(code, status) && response.attempts <= options.retries)
+			{
+				auto delay = options.backoff * (1 << std::min(response.attempts - 1, 10));
+				transfer->notBefore = std::chrono::steady_clock::now() + delay;
+				response.body.clear();
+				response.headers.clear();
+				if (transfer->request->onRetry)
+					transfer->request->onRetry();
+				pending.push_back(static_cast<size_t>(transfer - transfers.data()));
+				continue;
+			}
+
+			if (code != CURLE_OK)
+				response.error = curl_easy_strerror(code);
+			else if (status >= 400)
+				response.error = std::format("HTTP {}", status);
+		}
+
+		if (active)
+		{
+			curl_multi_poll(m_multi, nullptr, 0, 100, nullptr);
+		}
+		else if (!pending.empty())
+		{
+			// Everything left is waiting out a backoff.
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		}
+	}
+
+	for (auto &transfer : transfers)
+	{
+		curl_slist_free_all(transfer.headers);
+	}
+	return responses;
+}
+
+#endif
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace plugifyMM
+{
+	struct HttpOptions
+	{
+		size_t parallelism { 4 };
+		size_t hostConnections { 4 };
+		int retries { 3 };
+		std::chrono::milliseconds backoff { 500 };
+		std::chrono::seconds timeout { 300 };
+	};
+
+	struct HttpRequest
+	{
+		std::string url;
+		std::vector<std::string> headers;
+		// Streaming sink; returning false aborts the transfer. When unset the body is buffered.
+		std::function<bool(const char *data, size_t size)> onData;
+		// Called before a retry so the sink can discard a partial body.
+		std::function<void()> onRetry;
+	};
+
+	struct HttpResponse
+	{
+		long status { 0 };
+		int attempts { 0 };
+		std::string body;
+		std::string error;
+		std::unordered_map<std::string, std::string> headers; // lower-case names
+
+		bool Ok() const { return error.empty() && status >= 200 && status < 300; }
+	};
+
+	// Concurrent HTTP client. Transfers share one connection cache, so repeated requests
+	// to a repository host reuse kept-alive (or multiplexed HTTP/2) connections across calls.
+	class MMHttpClient
+	{
+	public:
+		MMHttpClient();
+		~MMHttpClient();
+
+		static bool IsSupported();
+
+		void SetOptions(const HttpOptions &options);
+		HttpOptions GetOptions() const;
+
+		// Runs all requests with at most 'parallelism' in flight and blocks until they finish.
+		// Connection failures, 429 and 5xx responses are retried with exponential backoff.
+		std::vector<HttpResponse> Perform(std::vector<HttpRequest> &requests, const std::atomic<bool> *cancel = nullptr);
+
+	private:
+		void *AcquireHandle();
+
+	private:
+		mutable std::mutex m_optionsMutex; // never held across a transfer
+		HttpOptions m_options;
+		std::mutex m_batchMutex; // one batch at a time owns the multi handle
+		void *m_multi { nullptr };
+		std::vector<void *> m_handles;
+	};
+} // namespace plugifyMM
@@ -0,0 +1,247 @@
+#include "mm_jobs.h"
+
+#include <exception>
+
+using namespace plugifyMM;
+
+static thread_local const std::atomic<bool> *s_pCancelToken = nullptr;
+
+std::string_view plugifyMM::JobStateToString(JobState state)
+{
+	switch (state)
+	{
+		case JobState::Queued:
+			return "queued";
+		case JobState::Running:
+			return "running";
+		case JobState::Completed:
+			return "completed";
+		case JobState::Failed:
+			return "failed";
+		case JobState::Cancelled:
+			return "cancelled";
+	}
+	return "unknown";
+}
+
+MMJobQueue::~MMJobQueue()
+{
+	Stop();
+}
+
+void MMJobQueue::Start()
+{
+	std::lock_guard lock(m_mutex);
+	if (m_running)
+		return;
+
+	m_running = true;
+	m_thread = std::thread(&MMJobQueue::WorkerLoop, this);
+}
+
+void MMJobQueue::Stop()
+{
+	{
+		std::lock_guard lock(m_mutex);
+		if (!m_running)
+			return;
+
+		m_running = false;
+		for (auto &job : m_queue)
+		{
+			job->info.state = JobState::Cancelled;
+		}
+		m_queue.clear();
+		if (m_current)
+		{
+			m_current->cancelled.store(true, std::memory_order_relaxed);
+		}
+	}
+
+	// Downloads poll the cancel token and stop within a poll interval; a step running
+	// inside the core cannot be interrupted and is waited for.
+	m_condition.notify_all();
+	m_thread.join();
+
+	std::lock_guard lock(m_mutex);
+	m_completions.clear();
+}
+
+uint64_t MMJobQueue::Submit(std::string name, std::vector<Step> steps, Completion onComplete)
+{
+	auto job = std::make_shared<Job>();
+	job->steps = std::move(steps);
+	job->onComplete = std::move(onComplete);
+
+	uint64_t id;
+	{
+		std::lock_guard lock(m_mutex);
+		id = m_nextId++;
+		job->info = { id, std::move(name), JobState::Queued, 0, job->steps.size(), {}, {} };
+		m_queue.push_back(std::move(job));
+	}
+
+	m_condition.notify_one();
+	return id;
+}
+
+CancelResult MMJobQueue::Cancel(uint64_t id)
+{
+	std::shared_ptr<Job> cancelled;
+	{
+		std::lock_guard lock(m_mutex);
+		if (m_current && m_current->info.id == id)
+		{
+			// With no step left after the current one, only a step that checks the token can stop.
+			bool lastStep = m_current->info.done + 1 >= m_current->info.total;
+			if (lastStep && !m_current->interruptible.load(std::memory_order_relaxed))
+				return CancelResult::Uncancellable;
+
+			m_current->cancelled.store(true, std::memory_order_relaxed);
+			return CancelResult::Requested;
+		}
+
+		for (auto it = m_queue.begin(); it != m_queue.end(); ++it)
+		{
+			if ((*it)->info.id == id)
+			{
+				cancelled = std::move(*it);
+				m_queue.erase(it);
+				break;
+			}
+		}
+	}
+
+	if (!cancelled)
+		return CancelResult::NotFound;
+
+	Finish(cancelled, JobState::Cancelled);
+	return CancelResult::Cancelled;
+}
+
+bool MMJobQueue::IsBusy() const
+{
+	std::lock_guard lock(m_mutex);
+	return m_current || !m_queue.empty();
+}
+
+std::vector<JobInfo> MMJobQueue::GetJobs() const
+{
+	std::lock_guard lock(m_mutex);
+
+	std::vector<JobInfo> jobs(m_history.begin(), m_history.end());
+	if (m_current)
+	{
+		JobInfo info = m_current->info;
+		info.elapsed = std::chrono::steady_clock::now() - m_current->started;
+		jobs.push_back(std::move(info));
+	}
+	for (const auto &job : m_queue)
+	{
+		jobs.push_back(job->info);
+	}
+	return jobs;
+}
+
+const std::atomic<bool> *MMJobQueue::CancelToken()
+{
+	return s_pCancelToken;
+}
+
+void MMJobQueue::Poll()
+{
+	std::vector<std::function<void()>> completions;
+	{
+		std::lock_guard lock(m_mutex);
+		if (m_completions.empty())
+			return;
+		completions.swap(m_completions);
+	}
+
+	for (auto &completion : completions)
+	{
+		completion();
+	}
+}
+
+void MMJobQueue::Post(std::function<void()> callback)
+{
+	std::lock_guard lock(m_mutex);
+	m_completions.push_back(std::move(callback));
+}
+
+void MMJobQueue::WorkerLoop()
+{
+	for (;;)
+	{
+		std::shared_ptr<Job> job;
+		{
+			std::unique_lock lock(m_mutex);
+			m_condition.wait(lock, [this] { return !m_running || !m_queue.empty(); });
+			if (!m_running)
+				break;
+
+			job = std::move(m_queue.front());
+			m_queue.pop_front();
+			job->info.state = JobState::Running;
+			job->started = std::chrono::steady_clock::now();
+			m_current = job;
+		}
+
+		s_pCancelToken = &job->cancelled;
+
+		JobState state = JobState::Completed;
+		for (auto &step : job->steps)
+		{
+			if (job->cancelled.load(std::memory_order_relaxed))
+			{
+				state = JobState::Cancelled;
+				break;
+			}
+
+			job->interruptible.store(step.interruptible, std::memory_order_relaxed);
+			try
+			{
+				step.run();
+			}
+			catch (const std::exception &e)
+			{
+				std::lock_guard lock(m_mutex);
+				job->info.error = e.what();
+				state = JobState::Failed;
+				break;
+			}
+
+			std::lock_guard lock(m_mutex);
+			++job->info.done;
+		}
+
+		s_pCancelToken = nullptr;
+		Finish(job, state);
+	}
+}
+
+void MMJobQueue::Finish(const std::shared_ptr<Job> &job, JobState state)
+{
+	std::lock_guard lock(m_mutex);
+
+	job->info.state = state;
+	if (job->started != std::chrono::steady_clock::time_point{})
+	{
+		job->info.elapsed = std::chrono::steady_clock::now() - job->started;
+	}
+	if (m_current == job)
+	{
+		m_current.reset();
+	}
+	m_history.push_back(job->info);
+	while (m_history.size() > kHistorySize)
+	{
+		m_history.pop_front();
+	}
+
+	if (job->onComplete)
+	{
+		m_completions.emplace_back([job] { job->onComplete(job->info); });
+	}
+}
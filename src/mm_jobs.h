@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace plugifyMM
+{
+	enum class JobState
+	{
+		Queued,
+		Running,
+		Completed,
+		Failed,
+		Cancelled,
+	};
+
+	std::string_view JobStateToString(JobState state);
+
+	struct JobInfo
+	{
+		uint64_t id;
+		std::string name;
+		JobState state;
+		size_t done;
+		size_t total;
+		std::chrono::duration<double> elapsed;
+		std::string error;
+	};
+
+	enum class CancelResult
+	{
+		Cancelled,     // was queued, removed
+		Requested,     // running, stops at the next step or cancellation check
+		Uncancellable, // running its last step, which cannot stop midway
+		NotFound,
+	};
+
+	// Runs package operations one at a time on a background thread.
+	// A job is a list of steps; cancellation takes effect between steps, or within
+	// steps marked interruptible. Completion callbacks and posted messages are
+	// queued and run by Poll() on the main thread.
+	class MMJobQueue
+	{
+	public:
+		struct Step
+		{
+			template <typename F> requires std::is_invocable_v<F &>
+			Step(F &&run, bool interruptible = false) : run(std::forward<F>(run)), interruptible(interruptible) {}
+
+			std::function<void()> run;
+			bool interruptible; // polls CancelToken() and can stop midway
+		};
+		using Completion = std::function<void(const JobInfo &)>;
+
+		~MMJobQueue();
+
+		void Start();
+		void Stop();
+
+		uint64_t Submit(std::string name, std::vector<Step> steps, Completion onComplete);
+		CancelResult Cancel(uint64_t id);
+		bool IsBusy() const;
+		std::vector<JobInfo> GetJobs() const;
+
+		void Poll();
+		// Runs 'callback' on the main thread at the next Poll(), e.g. console output of a step.
+		void Post(std::function<void()> callback);
+
+		// Cancellation flag of the job running on the calling thread, for steps that can stop early.
+		static const std::atomic<bool> *CancelToken();
+
+	private:
+		struct Job
+		{
+			JobInfo info;
+			std::vector<Step> steps;
+			Completion onComplete;
+			std::atomic<bool> cancelled { false };
+			std::atomic<bool> interruptible { false }; // the running step polls the cancel token
+			std::chrono::steady_clock::time_point started;
+		};
+
+		void WorkerLoop();
+		void Finish(const std::shared_ptr<Job> &job, JobState state);
+
+	private:
+		static constexpr size_t kHistorySize = 16;
+
+		mutable std::mutex m_mutex;
+		std::condition_variable m_condition;
+		std::deque<std::shared_ptr<Job>> m_queue;
+		std::shared_ptr<Job> m_current;
+		std::deque<JobInfo> m_history;
+		std::vector<std::function<void()>> m_completions;
+		std::thread m_thread;
+		uint64_t m_nextId { 1 };
+		bool m_running { false };
+	};
+} // namespace plugifyMM
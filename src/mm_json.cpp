@@ -0,0 +1,477 @@
+#include "mm_json.h"
+
+#include <cctype>
+#include <charconv>
+#include <cmath>
+
+#include <plugify/compat_format.h>
+
+using namespace plugifyMM;
+
+namespace
+{
+	class JsonParser
+	{
+	public:
+		explicit JsonParser(std::string_view text) : m_text(text) {}
+
+		std::optional<JsonValue> ParseDocument(std::string &error)
+		{
+			auto value = ParseValue(0);
+			SkipSpace();
+			if (value && m_pos != m_text.size())
+				Fail("trailing characters");
+			if (!m_error.empty())
+			{
+				error = std::format("offset {}: {}", m_pos, m_error);
+				return std::nullopt;
+			}
+			return value;
+		}
+
+	private:
+		static constexpr int kMaxDepth = 64;
+
+		std::optional<JsonValue> Fail(std::string_view message)
+		{
+			if (m_error.empty())
+				m_error = message;
+			return std::nullopt;
+		}
+
+		void SkipSpace()
+		{
+			while (m_pos < m_text.size() && (m_text[m_pos] == ' ' || m_text[m_pos] == '\t' || m_text[m_pos] == '\n' || m_text[m_pos] == '\r'))
+				++m_pos;
+		}
+
+		bool Consume(char c)
+		{
+			SkipSpace();
+			if (m_pos < m_text.size() && m_text[m_pos] == c)
+			{
+				++m_pos;
+				return true;
+			}
+			return false;
+		}
+
+		bool ConsumeWord(std::string_view word)
+		{
+			if (m_text.substr(m_pos, word.size()) != word)
+				return false;
+			m_pos += word.size();
+			return true;
+		}
+
+		std::optional<JsonValue> ParseValue(int depth)
+		{
+			if (depth > kMaxDepth)
+				return Fail("nesting too deep");
+
+			SkipSpace();
+			if (m_pos >= m_text.size())
+				return Fail("unexpected end of input");
+
+			char c = m_text[m_pos];
+			if (c == '{')
+				return ParseObject(depth);
+			if (c == '[')
+				return ParseArray(depth);
+			if (c == '"')
+			{
+				auto str = ParseString();
+				if (!str)
+					return std::nullopt;
+				return JsonValue(std::move(*str));
+			}
+			if (ConsumeWord("true"))
+				return JsonValue(true);
+			if (ConsumeWord("false"))
+				return JsonValue(false);
+			if (ConsumeWord("null"))
+				return JsonValue();
+			return ParseNumber();
+		}
+
+		std::optional<JsonValue> ParseObject(int depth)
+		{
+			++m_pos;
+			JsonValue::Object object;
+			if (Consume('}'))
+				return JsonValue(std::move(object));
+
+			do
+			{
+				SkipSpace();
+				if (m_pos >= m_text.size() || m_text[m_pos] != '"')
+					return Fail("expected member name");
+				auto key = ParseString();
+				if (!key)
+					return std::nullopt;
+				if (!Consume(':'))
+					return Fail("expected ':'");
+				auto value = ParseValue(depth + 1);
+				if (!value)
+					return std::nullopt;
+				object.emplace_back(std::move(*key), std::move(*value));
+			}
+			while (Consume(','));
+
+			if (!Consume('}'))
+				return Fail("expected '}'");
+			return JsonValue(std::move(object));
+		}
+
+		std::optional<JsonValue> ParseArray(int depth)
+		{
+			++m_pos;
+			JsonValue::Array array;
+			if (Consume(']'))
+				return JsonValue(std::move(array));
+
+			do
+			{
+				auto value = ParseValue(depth + 1);
+				if (!value)
+					return std::nullopt;
+				array.push_back(std::move(*value));
+			}
+			while (Consume(','));
+
+			if (!Consume(']'))
+				return Fail("expected ']'");
+			return JsonValue(std::move(array));
+		}
+
+		std::optional<JsonValue> ParseNumber()
+		{
+			size_t start = m_pos;
+			while (m_pos < m_text.size() && (std::isdigit(static_cast<unsigned char>(m_text[m_pos])) || m_text[m_pos] == '-' || m_text[m_pos] == '+' || m_text[m_pos] == '.' || m_text[m_pos] == 'e' || m_text[m_pos] == 'E'))
+				++m_pos;
+			if (start == m_pos)
+				return Fail("unexpected character");
+
+			// Unlike strtod, from_chars ignores the C locale, which may use ',' as the decimal separator.
+			double value;
+			auto [end, ec] = std::from_chars(m_text.data() + start, m_text.data() + m_pos, value);
+			if (ec != std::errc() || end != m_text.data() + m_pos)
+				return Fail("malformed number");
+			return JsonValue(value);
+		}
+
+		static void AppendUtf8(std::string &out, uint32_t code)
+		{
+			if (code < 0x80)
+			{
+				out += static_cast<char>(code);
+			}
+			else if (code < 0x800)
+			{
+				out += static_cast<char>(0xC0 | (code >> 6));
+				out += static_cast<char>(0x80 | (code & 0x3F));
+			}
+			else if (code < 0x10000)
+			{
+				out += static_cast<char>(0xE0 | (code >> 12));
+				out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+				out += static_cast<char>(0x80 | (code & 0x3F));
+			}
+			else
+			{
+				out += static_cast<char>(0xF0 | (code >> 18));
+				out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+				out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+				out += static_cast<char>(0x80 | (code & 0x3F));
+			}
+		}
+
+		std::optional<uint32_t> ParseHex()
+		{
+			if (m_pos + 4 > m_text.size())
+				return std::nullopt;
+			uint32_t code = 0;
+			for (size_t i = 0; i < 4; ++i)
+			{
+				char c = m_text[m_pos++];
+				code <<= 4;
+				if (c >= '0' && c <= '9')
+					code |= static_cast<uint32_t>(c - '0');
+				else if (c >= 'a' && c <= 'f')
+					code |= static_cast<uint32_t>(c - 'a' + 10);
+				else if (c >= 'A' && c <= 'F')
+					code |= static_cast<uint32_t>(c - 'A' + 10);
+				else
+					return std::nullopt;
+			}
+			return code;
+		}
+
+		std::optional<std::string> ParseString()
+		{
+			++m_pos;
+			std::string out;
+			while (m_pos < m_text.size())
+			{
+				char c = m_text[m_pos++];
+				if (c == '"')
+					return out;
+				if (c != '\\')
+				{
+					out += c;
+					continue;
+				}
+				if (m_pos >= m_text.size())
+					break;
+
+				switch (char escape = m_text[m_pos++])
+				{
+					case '"':
+					case '\\':
+					case '/':
+						out += escape;
+						break;
+					case 'b':
+						out += '\b';
+						break;
+					case 'f':
+						out += '\f';
+						break;
+					case 'n':
+						out += '\n';
+						break;
+					case 'r':
+						out += '\r';
+						break;
+					case 't':
+						out += '\t';
+						break;
+					case 'u':
+					{
+						auto code = ParseHex();
+						if (!code)
+						{
+							Fail("malformed \\u escape");
+							return std::nullopt;
+						}
+						if (*code >= 0xD800 && *code < 0xDC00 && ConsumeWord("\\u"))
+						{
+							auto low = ParseHex();
+							if (!low || *low < 0xDC00 || *low >= 0xE000)
+							{
+								Fail("malformed surrogate pair");
+								return std::nullopt;
+							}
+							*code = 0x10000 + ((*code - 0xD800) << 10) + (*low - 0xDC00);
+						}
+						AppendUtf8(out, *code);
+						break;
+					}
+					default:
+						Fail("unknown escape");
+						return std::nullopt;
+				}
+			}
+			Fail("unterminated string");
+			return std::nullopt;
+		}
+
+	private:
+		std::string_view m_text;
+		size_t m_pos { 0 };
+		std::string m_error;
+	};
+} // namespace
+
+void plugifyMM::AppendJsonString(std::string &out, std::string_view text)
+{
+	static constexpr char kHex[] = "0123456789abcdef";
+	out += '"';
+	for (char c : text)
+	{
+		switch (c)
+		{
+			case '"':
+				out += "\\\"";
+				break;
+			case '\\':
+				out += "\\\\";
+				break;
+			case '\n':
+				out += "\\n";
+				break;
+			case '\r':
+				out += "\\r";
+				break;
+			case '\t':
+				out += "\\t";
+				break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20)
+				{
+					out += "\\u00";
+					out += kHex[(c >> 4) & 0xF];
+					out += kHex[c & 0xF];
+				}
+				else
+				{
+					out += c;
+				}
+				break;
+		}
+	}
+	out += '"';
+}
+
+void MMJsonWriter::Separate()
+{
+	if (m_afterKey)
+	{
+		m_afterKey = false;
+		return;
+	}
+	if (!m_first.empty())
+	{
+		if (!m_first.back())
+			m_out += ',';
+		m_first.back() = false;
+	}
+}
+
+MMJsonWriter &MMJsonWriter::BeginObject()
+{
+	Separate();
+	m_out += '{';
+	m_first.push_back(true);
+	return *this;
+}
+
+MMJsonWriter &MMJsonWriter::EndObject()
+{
+	m_first.pop_back();
+	m_out += '}';
+	return *this;
+}
+
+MMJsonWriter &MMJsonWriter::BeginArray()
+{
+	Separate();
+	m_out += '[';
+	m_first.push_back(true);
+	return *this;
+}
+
+MMJsonWriter &MMJsonWriter::EndArray()
+{
+	m_first.pop_back();
+	m_out += ']';
+	return *this;
+}
+
+MMJsonWriter &MMJsonWriter::Key(std::string_view key)
+{
+	Separate();
+	AppendJsonString(m_out, key);
+	m_out += ':';
+	m_afterKey = true;
+	return *this;
+}
+
+MMJsonWriter &MMJsonWriter::String(std::string_view value)
+{
+	Separate();
+	AppendJsonString(m_out, value);
+	return *this;
+}
+
+MMJsonWriter &MMJsonWriter::Int(int64_t value)
+{
+	Separate();
+	std::format_to(std::back_inserter(m_out), "{}", value);
+	return *this;
+}
+
+MMJsonWriter &MMJsonWriter::Uint(uint64_t value)
+{
+	Separate();
+	std::format_to(std::back_inserter(m_out), "{}", value);
+	return *this;
+}
+
+MMJsonWriter &MMJsonWriter::Double(double value)
+{
+	if (!std::isfinite(value))
+		return Null();
+	Separate();
+	std::format_to(std::back_inserter(m_out), "{}", value);
+	return *this;
+}
+
+MMJsonWriter &MMJsonWriter::Bool(bool value)
+{
+	Separate();
+	m_out += value ? "true" : "false";
+	return *this;
+}
+
+MMJsonWriter &MMJsonWriter::Null()
+{
+	Separate();
+	m_out += "null";
+	return *this;
+}
+
+std::string MMJsonWriter::Release()
+{
+	m_out += '\n';
+	return std::move(m_out);
+}
+
+const JsonValue &JsonValue::operator[](std::string_view key) const
+{
+	static const JsonValue null;
+	if (const auto *object = std::get_if<Object>(&m_value))
+	{
+		for (const auto &[name, value] : *object)
+		{
+			if (name == key)
+				return value;
+		}
+	}
+	return null;
+}
+
+std::optional<bool> JsonValue::GetBool() const
+{
+	if (const auto *value = std::get_if<bool>(&m_value))
+		return *value;
+	return std::nullopt;
+}
+
+std::optional<int64_t> JsonValue::GetInt() const
+{
+	const auto *value = std::get_if<double>(&m_value);
+	if (!value || std::trunc(*value) != *value)
+		return std::nullopt;
+	return static_cast<int64_t>(*value);
+}
+
+std::optional<std::string_view> JsonValue::GetString() const
+{
+	if (const auto *value = std::get_if<std::string>(&m_value))
+		return *value;
+	return std::nullopt;
+}
+
+const JsonValue::Array &JsonValue::GetArray() const
+{
+	static const Array empty;
+	if (const auto *value = std::get_if<Array>(&m_value))
+		return *value;
+	return empty;
+}
+
+std::optional<JsonValue> JsonValue::Parse(std::string_view text, std::string &error)
+{
+	return JsonParser(text).ParseDocument(error);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace plugifyMM
+{
+	// Appends 'text' as a quoted JSON string.
+	void AppendJsonString(std::string &out, std::string_view text);
+
+	// Streams a JSON document into one buffer, inserting separators as values are written.
+	class MMJsonWriter
+	{
+	public:
+		explicit MMJsonWriter(size_t reserve = 4096) { m_out.reserve(reserve); }
+
+		MMJsonWriter &BeginObject();
+		MMJsonWriter &EndObject();
+		MMJsonWriter &BeginArray();
+		MMJsonWriter &EndArray();
+		MMJsonWriter &Key(std::string_view key);
+
+		MMJsonWriter &String(std::string_view value);
+		MMJsonWriter &Int(int64_t value);
+		MMJsonWriter &Uint(uint64_t value);
+		MMJsonWriter &Double(double value);
+		MMJsonWriter &Bool(bool value);
+		MMJsonWriter &Null();
+
+		// Ends the document with a newline and hands the buffer over.
+		std::string Release();
+
+	private:
+		void Separate();
+
+	private:
+		std::string m_out;
+		std::vector<bool> m_first; // per open container, whether nothing was written to it yet
+		bool m_afterKey { false };
+	};
+
+	// Minimal JSON document, enough to read package manifests without going through the core.
+	class JsonValue
+	{
+	public:
+		using Array = std::vector<JsonValue>;
+		using Object = std::vector<std::pair<std::string, JsonValue>>;
+
+		JsonValue() = default;
+		JsonValue(bool value) : m_value(value) {}
+		JsonValue(double value) : m_value(value) {}
+		JsonValue(std::string value) : m_value(std::move(value)) {}
+		JsonValue(Array value) : m_value(std::move(value)) {}
+		JsonValue(Object value) : m_value(std::move(value)) {}
+
+		bool IsNull() const { return std::holds_alternative<std::monostate>(m_value); }
+		bool IsObject() const { return std::holds_alternative<Object>(m_value); }
+		bool IsArray() const { return std::holds_alternative<Array>(m_value); }
+
+		// Member lookup; null when this is not an object or the key is absent.
+		const JsonValue &operator[](std::string_view key) const;
+
+		std::optional<bool> GetBool() const;
+		std::optional<int64_t> GetInt() const;
+		std::optional<std::string_view> GetString() const;
+		const Array &GetArray() const;
+
+		static std::optional<JsonValue> Parse(std::string_view text, std::string &error);
+
+	private:
+		std::variant<std::monostate, bool, double, std::string, Array, Object> m_value;
+	};
+} // namespace plugifyMM
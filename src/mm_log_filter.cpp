@@ -0,0 +1,238 @@
+#include "mm_log_filter.h"
+
+#include <algorithm>
+#include <array>
+
+using namespace plugifyMM;
+
+static constexpr std::chrono::seconds kRepeatWindow { 5 };
+
+static constexpr std::array<std::string_view, 7> kSeverityNames = {
+	"none",
+	"fatal",
+	"error",
+	"warning",
+	"info",
+	"debug",
+	"verbose",
+};
+
+std::optional<plugify::Severity> plugifyMM::ParseSeverity(std::string_view name)
+{
+	for (size_t i = 0; i < kSeverityNames.size(); ++i)
+	{
+		if (kSeverityNames[i] == name)
+		{
+			return static_cast<plugify::Severity>(i);
+		}
+	}
+	return std::nullopt;
+}
+
+std::string_view plugifyMM::SeverityToString(plugify::Severity severity)
+{
+	auto index = static_cast<size_t>(severity);
+	return index < kSeverityNames.size() ? kSeverityNames[index] : "unknown";
+}
+
+MMLogFilter::MMLogFilter()
+{
+	static std::atomic<uint64_t> s_nextId { 1 };
+	m_id = s_nextId.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool MMLogFilter::IsEnabled(std::string_view source, plugify::Severity severity, plugify::Severity global) const
+{
+	if (m_overrides.load(std::memory_order_relaxed) != 0)
+	{
+		const Source *src = Find(source);
+		if (src && src->overridden.load(std::memory_order_relaxed))
+		{
+			return severity <= src->severity.load(std::memory_order_relaxed);
+		}
+	}
+	return severity <= global;
+}
+
+MMLogFilter::Verdict MMLogFilter::Accept(std::string_view source, plugify::Severity severity, std::string_view line)
+{
+	Source &src = Acquire(source);
+	Verdict verdict { true, 0, 0 };
+
+	int64_t now = Clock::now().time_since_epoch().count();
+	src.lastSeen.store(now, std::memory_order_relaxed);
+	src.lastSeverity.store(severity, std::memory_order_relaxed);
+
+	if (m_collapse.load(std::memory_order_relaxed))
+	{
+		size_t hash = std::hash<std::string_view>{}(line);
+		if (src.lastHash.exchange(hash, std::memory_order_relaxed) == hash)
+		{
+			if (src.repeated.fetch_add(1, std::memory_order_relaxed) == 0)
+			{
+				src.repeatStart.store(now, std::memory_order_relaxed);
+			}
+			src.totalCollapsed.fetch_add(1, std::memory_order_relaxed);
+
+			verdict.pass = false;
+			if (Clock::duration(now - src.repeatStart.load(std::memory_order_relaxed)) >= kRepeatWindow)
+			{
+				verdict.repeated = src.repeated.exchange(0, std::memory_order_relaxed);
+			}
+			return verdict;
+		}
+
+		verdict.repeated = src.repeated.exchange(0, std::memory_order_relaxed);
+	}
+
+	double rate = m_rate.load(std::memory_order_relaxed);
+	if (rate > 0.0)
+	{
+		double burst = std::max(m_burst.load(std::memory_order_relaxed), 1.0);
+		auto interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate)).count();
+		auto tolerance = static_cast<int64_t>(static_cast<double>(interval) * (burst - 1.0));
+
+		int64_t allowedAt = src.allowedAt.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			int64_t start = std::max(allowedAt, now);
+			if (start - now > tolerance)
+			{
+				src.limited.fetch_add(1, std::memory_order_relaxed);
+				src.totalLimited.fetch_add(1, std::memory_order_relaxed);
+				// A limited line must not count as the "previous" one for collapsing.
+				src.lastHash.store(0, std::memory_order_relaxed);
+				verdict.pass = false;
+				return verdict;
+			}
+			if (src.allowedAt.compare_exchange_weak(allowedAt, start + interval, std::memory_order_relaxed))
+				break;
+		}
+
+		verdict.limited = src.limited.exchange(0, std::memory_order_relaxed);
+	}
+
+	src.totalPassed.fetch_add(1, std::memory_order_relaxed);
+	return verdict;
+}
+
+std::vector<LogSummary> MMLogFilter::Flush(Clock::duration idle)
+{
+	std::vector<LogSummary> summaries;
+	int64_t now = Clock::now().time_since_epoch().count();
+
+	std::shared_lock lock(m_mutex);
+	for (const auto &[name, src] : m_sources)
+	{
+		if (Clock::duration(now - src->lastSeen.load(std::memory_order_relaxed)) < idle)
+			continue;
+		if (src->repeated.load(std::memory_order_relaxed) == 0 && src->limited.load(std::memory_order_relaxed) == 0)
+			continue;
+
+		uint64_t repeated = src->repeated.exchange(0, std::memory_order_relaxed);
+		uint64_t limited = src->limited.exchange(0, std::memory_order_relaxed);
+		if (repeated || limited)
+		{
+			summaries.push_back({ name, src->lastSeverity.load(std::memory_order_relaxed), repeated, limited });
+		}
+	}
+	return summaries;
+}
+void MMLogFilter::SetSourceSeverity(std::string_view source, std::optional<plugify::Severity> severity)
+{
+	Source &src = Acquire(source);
+	bool wasOverridden = src.overridden.exchange(severity.has_value(), std::memory_order_relaxed);
+	if (severity)
+	{
+		src.severity.store(*severity, std::memory_order_relaxed);
+	}
+	if (wasOverridden != severity.has_value())
+	{
+		m_overrides.fetch_add(severity ? 1 : -1, std::memory_order_relaxed);
+	}
+}
+
+void MMLogFilter::SetRateLimit(double linesPerSecond, double burst)
+{
+	m_burst.store(burst, std::memory_order_relaxed);
+	m_rate.store(linesPerSecond, std::memory_order_relaxed);
+}
+
+void MMLogFilter::SetCollapse(bool collapse)
+{
+	m_collapse.store(collapse, std::memory_order_relaxed);
+}
+
+std::vector<LogSourceInfo> MMLogFilter::GetSources() const
+{
+	std::shared_lock lock(m_mutex);
+
+	std::vector<LogSourceInfo> sources;
+	sources.reserve(m_sources.size());
+	for (const auto &[name, src] : m_sources)
+	{
+		std::optional<plugify::Severity> severity;
+		if (src->overridden.load(std::memory_order_relaxed))
+		{
+			severity = src->severity.load(std::memory_order_relaxed);
+		}
+		sources.push_back({
+			name,
+			severity,
+			src->totalPassed.load(std::memory_order_relaxed),
+			src->totalLimited.load(std::memory_order_relaxed),
+			src->totalCollapsed.load(std::memory_order_relaxed)
+		});
+	}
+	std::sort(sources.begin(), sources.end(), [](const auto &lhs, const auto &rhs) { return lhs.name < rhs.name; });
+	return sources;
+}
+
+// Sources are never removed, so a thread can keep the last one it used. Nearly every
+// line comes from the same source as the previous one on that thread.
+struct SourceCache
+{
+	uint64_t owner { 0 };
+	std::string name;
+	void *source { nullptr };
+};
+static thread_local SourceCache s_sourceCache;
+
+const MMLogFilter::Source *MMLogFilter::Find(std::string_view source) const
+{
+	if (s_sourceCache.owner == m_id && s_sourceCache.name == source)
+		return static_cast<const Source *>(s_sourceCache.source);
+
+	std::shared_lock lock(m_mutex);
+	auto it = m_sources.find(source);
+	return it != m_sources.end() ? it->second.get() : nullptr;
+}
+
+MMLogFilter::Source &MMLogFilter::Acquire(std::string_view source)
+{
+	if (s_sourceCache.owner == m_id && s_sourceCache.name == source)
+		return *static_cast<Source *>(s_sourceCache.source);
+
+	Source *found = nullptr;
+	{
+		std::shared_lock lock(m_mutex);
+		auto it = m_sources.find(source);
+		if (it != m_sources.end())
+			found = it->second.get();
+	}
+	if (!found)
+	{
+		std::unique_lock lock(m_mutex);
+		auto it = m_sources.find(source);
+		if (it == m_sources.end())
+		{
+			it = m_sources.emplace(std::string(source), std::make_unique<Source>()).first;
+		}
+		found = it->second.get();
+	}
+
+	s_sourceCache.owner = m_id;
+	s_sourceCache.name.assign(source);
+	s_sourceCache.source = found;
+	return *found;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <plugify/log.h>
+
+#include "mm_utils.h"
+
+namespace plugifyMM
+{
+	std::optional<plugify::Severity> ParseSeverity(std::string_view name);
+	std::string_view SeverityToString(plugify::Severity severity);
+
+	struct LogSourceInfo
+	{
+		std::string name;
+		std::optional<plugify::Severity> severity;
+		uint64_t passed;
+		uint64_t limited;
+		uint64_t collapsed;
+	};
+
+	// Pending summary of lines a source lost to collapsing or the rate limit.
+	struct LogSummary
+	{
+		std::string source;
+		plugify::Severity severity;
+		uint64_t repeated;
+		uint64_t limited;
+	};
+
+	// Lock-free per line: sources are looked up through a per-thread cache, collapsing
+	// swaps a hash and the rate limit is a single-CAS cell-rate algorithm.
+	class MMLogFilter
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		struct Verdict
+		{
+			bool pass;
+			uint64_t repeated; // identical lines collapsed before this one
+			uint64_t limited;  // lines dropped by the rate limit before this one
+		};
+
+		MMLogFilter();
+
+		bool IsEnabled(std::string_view source, plugify::Severity severity, plugify::Severity global) const;
+		Verdict Accept(std::string_view source, plugify::Severity severity, std::string_view line);
+		// Takes the counts of bursts that ended at least 'idle' ago, so the last burst is reported too.
+		std::vector<LogSummary> Flush(Clock::duration idle);
+
+		void SetSourceSeverity(std::string_view source, std::optional<plugify::Severity> severity);
+		void SetRateLimit(double linesPerSecond, double burst);
+		void SetCollapse(bool collapse);
+
+		double GetRate() const { return m_rate.load(std::memory_order_relaxed); }
+		double GetBurst() const { return m_burst.load(std::memory_order_relaxed); }
+		bool GetCollapse() const { return m_collapse.load(std::memory_order_relaxed); }
+
+		std::vector<LogSourceInfo> GetSources() const;
+
+	private:
+		struct Source
+		{
+			std::atomic<bool> overridden { false };
+			std::atomic<plugify::Severity> severity { plugify::Severity::None };
+
+			std::atomic<plugify::Severity> lastSeverity { plugify::Severity::None };
+			std::atomic<size_t> lastHash { 0 };
+			std::atomic<int64_t> repeatStart { 0 };
+			std::atomic<int64_t> lastSeen { 0 };
+			std::atomic<uint64_t> repeated { 0 };
+			std::atomic<int64_t> allowedAt { 0 }; // earliest time the next line conforms to the rate
+			std::atomic<uint64_t> limited { 0 };
+
+			std::atomic<uint64_t> totalPassed { 0 };
+			std::atomic<uint64_t> totalLimited { 0 };
+			std::atomic<uint64_t> totalCollapsed { 0 };
+		};
+
+		const Source *Find(std::string_view source) const;
+		Source &Acquire(std::string_view source);
+
+	private:
+		uint64_t m_id;
+		mutable std::shared_mutex m_mutex;
+		std::unordered_map<std::string, std::unique_ptr<Source>, StringHash, std::equal_to<>> m_sources;
+		std::atomic<int> m_overrides { 0 };
+		std::atomic<double> m_rate { 0.0 };
+		std::atomic<double> m_burst { 0.0 };
+		std::atomic<bool> m_collapse { true };
+	};
+} // namespace plugifyMM
@@ -2,67 +2,275 @@
 
 using namespace plugifyMM;
 
+static thread_local bool s_bDrainThread = false;
+
+static constexpr char kPassthroughFormat[] = "{}";
+
+MMLogger::~MMLogger()
+{
+	DisableAsync();
+	m_binary.Close();
+}
+
 void MMLogger::SetSeverity(plugify::Severity severity)
 {
-	m_severity = severity;
+	m_severity.store(severity, std::memory_order_relaxed);
+}
+
+std::string &MMLogger::FormatBuffer()
+{
+	static thread_local std::string s_buffer = []
+	{
+		std::string buffer;
+		buffer.reserve(1024);
+		return buffer;
+	}();
+	return s_buffer;
+}
+
+void MMLogger::EnableAsync(size_t capacity, LogOverflowPolicy policy)
+{
+	DisableAsync();
+
+	m_policy = policy;
+	m_queue = std::make_unique<MMRingBuffer<Entry>>(capacity);
+	m_running.store(true, std::memory_order_release);
+	m_thread = std::thread(&MMLogger::DrainLoop, this);
+	m_async.store(true, std::memory_order_release);
+}
+
+void MMLogger::DisableAsync()
+{
+	if (!m_thread.joinable())
+		return;
+
+	m_async.store(false);
+	while (m_producers.load() != 0)
+	{
+		std::this_thread::yield();
+	}
+
+	m_running.store(false, std::memory_order_release);
+	m_signal.fetch_add(1, std::memory_order_release);
+	m_signal.notify_one();
+	m_thread.join();
+	m_queue.reset();
+}
+
+LogStats MMLogger::GetStats() const
+{
+	return {
+		m_written.load(std::memory_order_relaxed),
+		m_dropped.load(std::memory_order_relaxed),
+		m_queue ? m_queue->SizeApprox() : 0,
+		m_queue ? m_queue->Capacity() : 0
+	};
 }
 
 void MMLogger::Log(std::string_view message, plugify::Severity severity)
 {
-	if (severity <= m_severity)
+	if (m_profiler)
 	{
-		std::string sMessage = std::format("{}\n", message);
+		m_profiler->Mark(message);
+	}
+	Log(kLogCoreSource, message, severity);
+}
 
-		const char *pszMessage = sMessage.c_str();
+void MMLogger::Log(std::string_view source, std::string_view message, plugify::Severity severity)
+{
+	if (m_binary.IsEnabled(severity))
+	{
+		m_binary.Write(severity, source, kPassthroughFormat, message);
+	}
+	MMFlightRecorder *recorder = m_recorder.load(std::memory_order_acquire);
+	if (recorder && recorder->IsEnabled(severity))
+	{
+		recorder->Record(FlightEvent::Log, severity, source, message);
+	}
+	if (IsEnabled(source, severity))
+	{
+		std::string &buffer = FormatBuffer();
+		buffer.assign(message);
+		buffer += '\n';
+		Submit(source, severity, buffer);
+	}
+}
 
-		switch (severity)
+void MMLogger::Submit(std::string_view source, plugify::Severity severity, const std::string &line)
+{
+	auto verdict = m_filter.Accept(source, severity, line);
+	if (verdict.limited)
+	{
+		Dispatch(severity, std::format("[{}] {} lines suppressed by rate limit\n", source, verdict.limited));
+	}
+	if (verdict.repeated)
+	{
+		Dispatch(severity, std::format("[{}] last message repeated {} times\n", source, verdict.repeated));
+	}
+	if (verdict.pass)
+	{
+		Dispatch(severity, line);
+	}
+}
+
+void MMLogger::FlushSummaries()
+{
+	// A burst is over once its source has been quiet for a second.
+	for (const auto &summary : m_filter.Flush(std::chrono::seconds(1)))
+	{
+		if (summary.limited)
 		{
-			case plugify::Severity::Fatal:
-			{
-				Error({255, 0, 255, 255}, pszMessage);
+			Dispatch(summary.severity, std::format("[{}] {} lines suppressed by rate limit\n", summary.source, summary.limited));
+		}
+		if (summary.repeated)
+		{
+			Dispatch(summary.severity, std::format("[{}] last message repeated {} times\n", summary.source, summary.repeated));
+		}
+	}
+}
 
-				break;
-			}
+void MMLogger::Dispatch(plugify::Severity severity, const std::string &line)
+{
+	if (IsAsync() && !s_bDrainThread)
+	{
+		m_producers.fetch_add(1);
+		if (m_async.load())
+		{
+			Enqueue(severity, line);
+			m_producers.fetch_sub(1, std::memory_order_release);
+			return;
+		}
+		m_producers.fetch_sub(1, std::memory_order_release);
+	}
 
-			case plugify::Severity::Error:
-			{
-				Warning({255, 0, 0, 255}, pszMessage);
+	Write(severity, line.c_str());
+}
 
-				break;
-			}
+void MMLogger::Enqueue(plugify::Severity severity, const std::string &line)
+{
+	auto write = [&](Entry &entry)
+	{
+		entry.severity = severity;
+		entry.message.assign(line);
+	};
 
-			case plugify::Severity::Warning:
+	while (!m_queue->TryPush(write))
+	{
+		switch (m_policy)
+		{
+			case LogOverflowPolicy::DropNewest:
 			{
-				Warning({255, 127, 0, 255}, pszMessage);
-
-				break;
+				m_dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
 			}
 
-			case plugify::Severity::Info:
+			case LogOverflowPolicy::DropOldest:
 			{
-				Message({255, 255, 0, 255}, pszMessage);
+				if (m_queue->TryPop([](Entry &) {}))
+				{
+					m_dropped.fetch_add(1, std::memory_order_relaxed);
+				}
 
 				break;
 			}
 
-			case plugify::Severity::Debug:
+			case LogOverflowPolicy::Block:
 			{
-				Detailed({0, 255, 255, 255}, pszMessage);
+				if (!m_running.load(std::memory_order_acquire))
+				{
+					m_dropped.fetch_add(1, std::memory_order_relaxed);
+					return;
+				}
+
+				std::this_thread::yield();
 
 				break;
 			}
+		}
+	}
 
-			case plugify::Severity::Verbose:
-			{
-				Detailed({255, 255, 255, 255}, pszMessage);
+	m_signal.fetch_add(1, std::memory_order_release);
+	m_signal.notify_one();
+}
 
-				break;
-			}
+void MMLogger::DrainLoop()
+{
+	s_bDrainThread = true;
 
-			case plugify::Severity::None:
-			{
-				break;
-			}
+	auto read = [this](Entry &entry)
+	{
+		Write(entry.severity, entry.message.c_str());
+	};
+
+	for (;;)
+	{
+		uint32_t signal = m_signal.load(std::memory_order_acquire);
+
+		if (m_queue->TryPop(read))
+			continue;
+
+		if (!m_running.load(std::memory_order_acquire))
+			break;
+
+		m_signal.wait(signal, std::memory_order_acquire);
+	}
+
+	while (m_queue->TryPop(read))
+	{
+	}
+}
+
+void MMLogger::Write(plugify::Severity severity, const char *pszMessage)
+{
+	m_written.fetch_add(1, std::memory_order_relaxed);
+
+	switch (severity)
+	{
+		case plugify::Severity::Fatal:
+		{
+			Error({255, 0, 255, 255}, pszMessage);
+
+			break;
+		}
+
+		case plugify::Severity::Error:
+		{
+			Warning({255, 0, 0, 255}, pszMessage);
+
+			break;
+		}
+
+		case plugify::Severity::Warning:
+		{
+			Warning({255, 127, 0, 255}, pszMessage);
+
+			break;
+		}
+
+		case plugify::Severity::Info:
+		{
+			Message({255, 255, 0, 255}, pszMessage);
+
+			break;
+		}
+
+		case plugify::Severity::Debug:
+		{
+			Detailed({0, 255, 255, 255}, pszMessage);
+
+			break;
+		}
+
+		case plugify::Severity::Verbose:
+		{
+			Detailed({255, 255, 255, 255}, pszMessage);
+
+			break;
+		}
+
+		case plugify::Severity::None:
+		{
+			break;
 		}
 	}
 }
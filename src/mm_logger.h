@@ -1,7 +1,10 @@
 #pragma once
 
+#include <atomic>
 #include <functional>
+#include <memory>
 #include <string>
+#include <thread>
 
 #include <tier0/dbg.h>
 #include <tier0/logging.h>
@@ -11,24 +14,160 @@
 
 #include <logger.hpp>
 
+#include "mm_binary_log.h"
+#include "mm_flight_recorder.h"
+#include "mm_log_filter.h"
+#include "mm_ring_buffer.h"
+#include "mm_startup_profiler.h"
+
+#ifndef PLUGIFY_LOG_SEVERITY_MAX
+#define PLUGIFY_LOG_SEVERITY_MAX Verbose
+#endif
+
+// Logs through 'logger' (a pointer) without evaluating the arguments unless a sink takes the line.
+#define MM_LOG(logger, severity, ...) \
+	do \
+	{ \
+		if ((logger)->ShouldLog<plugify::Severity::severity>()) \
+			(logger)->Log<plugify::Severity::severity>(__VA_ARGS__); \
+	} while (false)
+
 namespace plugifyMM
 {
+	// Lines more verbose than this are removed at compile time.
+	inline constexpr plugify::Severity kLogSeverityMax = plugify::Severity::PLUGIFY_LOG_SEVERITY_MAX;
+
+	// Source name used for lines coming through plugify::ILogger.
+	inline constexpr std::string_view kLogCoreSource = "plugify";
+
 	using MMLoggerBase = Logger;
 
+	enum class LogOverflowPolicy
+	{
+		DropOldest,
+		DropNewest,
+		Block,
+	};
+
+	struct LogStats
+	{
+		uint64_t written;
+		uint64_t dropped;
+		size_t pending;
+		size_t capacity;
+	};
+
 	class MMLogger final : public MMLoggerBase, public plugify::ILogger
 	{
 	public:
 		using Base = MMLoggerBase;
 		using Base::Base;
 
-		~MMLogger() override = default;
+		~MMLogger() override;
 
 		void SetSeverity(plugify::Severity severity);
+		bool IsEnabled(plugify::Severity severity) const { return severity <= m_severity.load(std::memory_order_relaxed); }
+		bool IsEnabled(std::string_view source, plugify::Severity severity) const { return m_filter.IsEnabled(source, severity, m_severity.load(std::memory_order_relaxed)); }
+		MMLogFilter &GetFilter() { return m_filter; }
+		MMBinaryLogSink &GetBinarySink() { return m_binary; }
+		void SetFlightRecorder(MMFlightRecorder *recorder) { m_recorder.store(recorder, std::memory_order_release); }
+		void SetStartupProfiler(MMStartupProfiler *profiler) { m_profiler = profiler; }
+
+		void EnableAsync(size_t capacity, LogOverflowPolicy policy);
+		void DisableAsync();
+		bool IsAsync() const { return m_async.load(std::memory_order_acquire); }
+		LogOverflowPolicy GetOverflowPolicy() const { return m_policy; }
+		LogStats GetStats() const;
+		// Reports collapsed and rate-limited bursts that ended without a following line.
+		void FlushSummaries();
 
 	public: // plugify::ILogger
 		void Log(std::string_view message, plugify::Severity severity);
 
+	public:
+		void Log(std::string_view source, std::string_view message, plugify::Severity severity);
+
+		// False at compile time above kLogSeverityMax, so guarded arguments are never evaluated.
+		template <plugify::Severity S>
+		bool ShouldLog(std::string_view source = kLogCoreSource) const
+		{
+			if constexpr (S == plugify::Severity::None || S > kLogSeverityMax)
+			{
+				return false;
+			}
+			else
+			{
+				MMFlightRecorder *recorder = m_recorder.load(std::memory_order_acquire);
+				return m_binary.IsEnabled(S) || (recorder && recorder->IsEnabled(S)) || IsEnabled(source, S);
+			}
+		}
+
+		template <plugify::Severity S, typename... Args>
+		void Log(std::format_string<Args...> fmt, Args &&...args)
+		{
+			LogFrom<S>(kLogCoreSource, fmt, std::forward<Args>(args)...);
+		}
+
+		template <plugify::Severity S, typename... Args>
+		void LogFrom(std::string_view source, std::format_string<Args...> fmt, Args &&...args)
+		{
+			if constexpr (S != plugify::Severity::None && S <= kLogSeverityMax)
+			{
+				if (m_binary.IsEnabled(S))
+				{
+					m_binary.Write(S, source, fmt.get(), args...);
+				}
+				MMFlightRecorder *recorder = m_recorder.load(std::memory_order_acquire);
+				bool record = recorder && recorder->IsEnabled(S);
+				bool enabled = IsEnabled(source, S);
+				if (record || enabled)
+				{
+					std::string &buffer = FormatBuffer();
+					buffer.clear();
+					std::format_to(std::back_inserter(buffer), fmt, std::forward<Args>(args)...);
+					buffer += '\n';
+					if (record)
+					{
+						recorder->Record(FlightEvent::Log, S, source, buffer);
+					}
+					if (enabled)
+					{
+						Submit(source, S, buffer);
+					}
+				}
+			}
+		}
+
 	private:
-		plugify::Severity m_severity { plugify::Severity::None };
+		struct Entry
+		{
+			plugify::Severity severity;
+			std::string message;
+		};
+
+		static std::string &FormatBuffer();
+
+		void Submit(std::string_view source, plugify::Severity severity, const std::string &line);
+		void Dispatch(plugify::Severity severity, const std::string &line);
+		void Write(plugify::Severity severity, const char *pszMessage);
+		void Enqueue(plugify::Severity severity, const std::string &line);
+		void DrainLoop();
+
+	private:
+		std::atomic<plugify::Severity> m_severity { plugify::Severity::None };
+		MMLogFilter m_filter;
+		MMBinaryLogSink m_binary;
+		std::atomic<MMFlightRecorder *> m_recorder { nullptr };
+		MMStartupProfiler *m_profiler { nullptr };
+
+		std::atomic<bool> m_async { false };
+		std::atomic<bool> m_running { false };
+		LogOverflowPolicy m_policy { LogOverflowPolicy::DropNewest };
+		std::unique_ptr<MMRingBuffer<Entry>> m_queue;
+		std::thread m_thread;
+		std::atomic<uint32_t> m_signal { 0 };
+		std::atomic<uint32_t> m_producers { 0 };
+		std::atomic<uint64_t> m_written { 0 };
+		std::atomic<uint64_t> m_dropped { 0 };
 	};
 } // namespace plugifyMM
@@ -0,0 +1,380 @@
+#include "mm_manifest_cache.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+
+#include "mm_json.h"
+
+#include <plugify/compat_format.h>
+
+using namespace plugifyMM;
+
+std::string_view plugifyMM::ManifestSourceToString(ManifestSource source)
+{
+	switch (source)
+	{
+		case ManifestSource::Cached:
+			return "cached";
+		case ManifestSource::NotModified:
+			return "not modified";
+		case ManifestSource::Downloaded:
+			return "downloaded";
+		case ManifestSource::Stale:
+			return "stale";
+		case ManifestSource::Missing:
+			return "missing";
+	}
+	return "unknown";
+}
+
+static int64_t UnixNow()
+{
+	return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static std::string_view Trim(std::string_view str)
+{
+	while (!str.empty() && std::isspace(static_cast<unsigned char>(str.front())))
+		str.remove_prefix(1);
+	while (!str.empty() && std::isspace(static_cast<unsigned char>(str.back())))
+		str.remove_suffix(1);
+	return str;
+}
+
+MMManifestCache::MMManifestCache(MMHttpClient &http, std::filesystem::path directory) : m_http(http), m_directory(std::move(directory))
+{
+}
+
+static bool ReadRepositoryList(const std::filesystem::path &file, std::vector<std::string> &repositories)
+{
+	std::ifstream stream(file);
+	if (!stream)
+		return false;
+
+	std::string line;
+	while (std::getline(stream, line))
+	{
+		std::string_view url = Trim(std::string_view(line).substr(0, line.find('#')));
+		if (!url.empty() && std::find(repositories.begin(), repositories.end(), url) == repositories.end())
+		{
+			repositories.emplace_back(url);
+		}
+	}
+	return true;
+}
+
+bool MMManifestCache::LoadRepositories(const std::filesystem::path &file)
+{
+	std::lock_guard lock(m_mutex);
+	m_listFile = file;
+	m_repositories.clear();
+	return ReadRepositoryList(file, m_repositories);
+}
+
+bool MMManifestCache::AddRepository(std::string_view url)
+{
+	std::lock_guard lock(m_mutex);
+	url = Trim(url);
+	if (url.empty() || std::find(m_repositories.begin(), m_repositories.end(), url) != m_repositories.end())
+		return false;
+
+	m_repositories.emplace_back(url);
+	if (!m_listFile.empty())
+	{
+		std::ofstream stream(m_listFile, std::ios::app);
+		stream << url << '\n';
+	}
+	return true;
+}
+
+std::vector<std::string> MMManifestCache::GetRepositories() const
+{
+	std::lock_guard lock(m_mutex);
+	return m_repositories;
+}
+
+std::vector<ManifestStatus> MMManifestCache::GetStatus() const
+{
+	std::lock_guard lock(m_mutex);
+	return m_status;
+}
+
+std::filesystem::path MMManifestCache::GetFile(std::string_view url) const
+{
+	// FNV-1a of the URL keeps names unique; the last path segment keeps them readable.
+	uint64_t hash = 14695981039346656037ull;
+	for (char c : url)
+	{
+		hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+	}
+
+	std::string_view name = url.substr(url.find_last_of('/') + 1);
+	name = name.substr(0, name.find_first_of("?#"));
+	std::string sName;
+	for (char c : name.substr(0, 48))
+	{
+		sName += std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_' || c == '.' ? c : '_';
+	}
+	return m_directory / std::format("{:016x}-{}", hash, sName.empty() ? "manifest.json" : sName);
+}
+
+bool MMManifestCache::ReadMeta(const std::filesystem::path &file, Meta &meta)
+{
+	std::ifstream stream(std::filesystem::path(file).concat(".meta"));
+	if (!stream)
+		return false;
+
+	std::string line;
+	while (std::getline(stream, line))
+	{
+		std::string_view view(line);
+		size_t space = view.find(' ');
+		if (space == std::string_view::npos)
+			continue;
+
+		std::string_view key = view.substr(0, space);
+		std::string_view value = Trim(view.substr(space + 1));
+		if (key == "etag")
+			meta.etag = value;
+		else if (key == "last-modified")
+			meta.lastModified = value;
+		else if (key == "fetched")
+			meta.fetched = std::strtoll(std::string(value).c_str(), nullptr, 10);
+	}
+	return std::filesystem::exists(file);
+}
+
+void MMManifestCache::WriteMeta(const std::filesystem::path &file, const Meta &meta)
+{
+	auto path = std::filesystem::path(file).concat(".meta");
+	std::ofstream stream(path, std::ios::trunc);
+	if (!meta.etag.empty())
+		stream << "etag " << meta.etag << '\n';
+	if (!meta.lastModified.empty())
+		stream << "last-modified " << meta.lastModified << '\n';
+	stream << "fetched " << meta.fetched << '\n';
+}
+
+std::vector<ManifestStatus> MMManifestCache::Refresh(std::chrono::seconds ttl, bool offline, bool force, const std::atomic<bool> *cancel)
+{
+	auto repositories = GetRepositories();
+
+	std::error_code ec;
+	std::filesystem::create_directories(m_directory, ec);
+
+	int64_t now = UnixNow();
+	std::vector<ManifestStatus> status(repositories.size());
+	std::vector<Meta> metas(repositories.size());
+	std::vector<HttpRequest> requests;
+	std::vector<size_t> requested;
+
+	for (size_t i = 0; i < repositories.size(); ++i)
+	{
+		auto &entry = status[i];
+		auto &meta = metas[i];
+		entry.url = repositories[i];
+		entry.file = GetFile(repositories[i]);
+
+		bool cached = ReadMeta(entry.file, meta);
+		entry.age = std::chrono::seconds(cached ? std::max<int64_t>(now - meta.fetched, 0) : 0);
+
+		if (cached && (offline || (!force && entry.age < ttl)))
+		{
+			entry.source = ManifestSource::Cached;
+			continue;
+		}
+		if (offline)
+		{
+			entry.source = ManifestSource::Missing;
+			entry.error = "offline and not cached";
+			continue;
+		}
+
+		HttpRequest request;
+		request.url = entry.url;
+		if (cached && !meta.etag.empty())
+			request.headers.push_back(std::format("If-None-Match: {}", meta.etag));
+		if (cached && !meta.lastModified.empty())
+			request.headers.push_back(std::format("If-Modified-Since: {}", meta.lastModified));
+		requests.push_back(std::move(request));
+		requested.push_back(i);
+	}
+
+	auto responses = m_http.Perform(requests, cancel);
+	for (size_t r = 0; r < responses.size(); ++r)
+	{
+		auto &response = responses[r];
+		auto &entry = status[requested[r]];
+		auto &meta = metas[requested[r]];
+		bool cached = std::filesystem::exists(entry.file);
+
+		if (response.status == 304 && cached)
+		{
+			meta.fetched = now;
+			WriteMeta(entry.file, meta);
+			entry.source = ManifestSource::NotModified;
+			entry.age = std::chrono::seconds(0);
+			continue;
+		}
+
+		if (response.Ok())
+		{
+			// Write next to the old copy and rename so readers never see a partial manifest.
+			auto temp = std::filesystem::path(entry.file).concat(".tmp");
+			{
+				std::ofstream stream(temp, std::ios::binary | std::ios::trunc);
+				stream.write(response.body.data(), static_cast<std::streamsize>(response.body.size()));
+			}
+			std::filesystem::rename(temp, entry.file, ec);
+			if (!ec)
+			{
+				meta.etag = response.headers["etag"];
+				meta.lastModified = response.headers["last-modified"];
+				meta.fetched = now;
+				WriteMeta(entry.file, meta);
+				entry.source = ManifestSource::Downloaded;
+				entry.age = std::chrono::seconds(0);
+				continue;
+			}
+			response.error = ec.message();
+		}
+
+		entry.error = response.error.empty() ? std::format("HTTP {}", response.status) : response.error;
+		entry.source = cached ? ManifestSource::Stale : ManifestSource::Missing;
+	}
+
+	std::lock_guard lock(m_mutex);
+	m_status = status;
+	return status;
+}
+
+std::string MMManifestCache::ToFileUrl(const std::filesystem::path &file)
+{
+	std::string path = std::filesystem::absolute(file).generic_string();
+	return path.starts_with('/') ? "file://" + path : "file:///" + path;
+}
+
+// Returns the [begin, end) span of the array value of top-level member 'key', or npos.
+static std::pair<size_t, size_t> FindMemberArray(std::string_view text, std::string_view key)
+{
+	int depth = 0;
+	size_t keyEnd = std::string_view::npos;
+	for (size_t i = 0; i < text.size(); ++i)
+	{
+		char c = text[i];
+		if (c == '"')
+		{
+			size_t start = ++i;
+			while (i < text.size() && text[i] != '"')
+			{
+				i += text[i] == '\\' ? 2 : 1;
+			}
+			if (depth == 1 && text.substr(start, i - start) == key)
+				keyEnd = i + 1;
+			continue;
+		}
+		if (c == '[' && depth == 1 && keyEnd != std::string_view::npos && Trim(text.substr(keyEnd, i - keyEnd)) == ":")
+		{
+			size_t begin = i;
+			for (int nested = 0; i < text.size(); ++i)
+			{
+				if (text[i] == '"')
+				{
+					for (++i; i < text.size() && text[i] != '"'; i += text[i] == '\\' ? 2 : 1)
+					{
+					}
+				}
+				else if (text[i] == '[')
+					++nested;
+				else if (text[i] == ']' && --nested == 0)
+					return { begin, i + 1 };
+			}
+			break;
+		}
+		if (c == '{' || c == '[')
+			++depth;
+		else if (c == '}' || c == ']')
+			--depth;
+		else if (c == ',')
+			keyEnd = std::string_view::npos;
+	}
+	return { std::string_view::npos, std::string_view::npos };
+}
+
+std::vector<std::string> MMManifestCache::MigrateRepositories(const std::filesystem::path &configFile, const std::filesystem::path &listFile, std::string &error)
+{
+	std::string text;
+	{
+		std::ifstream stream(configFile, std::ios::binary);
+		if (!stream)
+			return {};
+		text.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+	}
+
+	auto document = JsonValue::Parse(text, error);
+	if (!document)
+		return {};
+
+	std::vector<std::string> migrated;
+	for (const auto &value : (*document)["repositories"].GetArray())
+	{
+		if (auto url = value.GetString(); url && !Trim(*url).empty())
+			migrated.emplace_back(Trim(*url));
+	}
+	if (migrated.empty())
+		return {};
+
+	auto [begin, end] = FindMemberArray(text, "repositories");
+	if (begin == std::string_view::npos)
+	{
+		error = "cannot locate the repositories array";
+		return {};
+	}
+
+	std::vector<std::string> known;
+	ReadRepositoryList(listFile, known);
+	std::vector<std::string_view> added;
+	for (const auto &url : migrated)
+	{
+		if (std::find(known.begin(), known.end(), url) == known.end() && std::find(added.begin(), added.end(), url) == added.end())
+			added.emplace_back(url);
+	}
+	if (!added.empty())
+	{
+		std::ofstream stream(listFile, std::ios::app);
+		stream << "# Moved from " << configFile.filename().string() << '\n';
+		for (const auto &url : added)
+		{
+			stream << url << '\n';
+		}
+		if (!stream.flush())
+		{
+			error = std::format("cannot write {}", listFile.string());
+			return {};
+		}
+	}
+
+	// Same write-and-rename as the manifests so an interrupted migration leaves the old config.
+	text.replace(begin, end - begin, "[]");
+	auto temp = std::filesystem::path(configFile).concat(".tmp");
+	{
+		std::ofstream stream(temp, std::ios::binary | std::ios::trunc);
+		if (!stream.write(text.data(), static_cast<std::streamsize>(text.size())).flush())
+		{
+			stream.close();
+			std::error_code ec;
+			std::filesystem::remove(temp, ec);
+			error = std::format("cannot write {}", temp.string());
+			return migrated;
+		}
+	}
+	std::error_code ec;
+	std::filesystem::rename(temp, configFile, ec);
+	if (ec)
+	{
+		error = ec.message();
+	}
+	return migrated;
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "mm_http.h"
+
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace plugifyMM
+{
+	enum class ManifestSource
+	{
+		Cached,      // within TTL (or offline), no request made
+		NotModified, // server answered 304
+		Downloaded,  // fresh body written to the cache
+		Stale,       // request failed, older cached copy used
+		Missing,     // request failed or offline, nothing cached
+	};
+
+	std::string_view ManifestSourceToString(ManifestSource source);
+
+	struct ManifestStatus
+	{
+		std::string url;
+		std::filesystem::path file;
+		ManifestSource source;
+		std::chrono::seconds age;
+		std::string error;
+	};
+
+	// On-disk cache of repository manifests. Each manifest is stored with its ETag and
+	// Last-Modified so a refresh past the TTL costs a conditional request, and the cached
+	// files are handed to the package manager as file:// repositories.
+	class MMManifestCache
+	{
+	public:
+		MMManifestCache(MMHttpClient &http, std::filesystem::path directory);
+
+		// Repository list, one URL per line; '#' starts a comment.
+		bool LoadRepositories(const std::filesystem::path &file);
+		bool AddRepository(std::string_view url);
+		std::vector<std::string> GetRepositories() const;
+
+		std::vector<ManifestStatus> Refresh(std::chrono::seconds ttl, bool offline, bool force, const std::atomic<bool> *cancel = nullptr);
+		std::vector<ManifestStatus> GetStatus() const;
+
+		// The core fetches every repository through curl, which reads file:// URLs straight
+		// from disk; that is what lets it consume the cached copies without a network request.
+		static std::string ToFileUrl(const std::filesystem::path &file);
+
+		// Moves URLs left in the pconfig "repositories" array into the repository list, so
+		// configs written before the list existed also go through the cache. Only the array is
+		// rewritten; call before the core reads the config. Returns the URLs moved.
+		static std::vector<std::string> MigrateRepositories(const std::filesystem::path &configFile, const std::filesystem::path &listFile, std::string &error);
+
+	private:
+		struct Meta
+		{
+			std::string etag;
+			std::string lastModified;
+			int64_t fetched { 0 };
+		};
+
+		std::filesystem::path GetFile(std::string_view url) const;
+		static bool ReadMeta(const std::filesystem::path &file, Meta &meta);
+		static void WriteMeta(const std::filesystem::path &file, const Meta &meta);
+
+	private:
+		mutable std::mutex m_mutex;
+		MMHttpClient &m_http;
+		std::filesystem::path m_directory;
+		std::filesystem::path m_listFile;
+		std::vector<std::string> m_repositories;
+		std::vector<ManifestStatus> m_status;
+	};
+} // namespace plugifyMM
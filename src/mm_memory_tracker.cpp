@@ -0,0 +1,158 @@
+#include "mm_memory_tracker.h"
+#include "mm_metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include <plugify/compat_format.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace plugifyMM;
+
+size_t MMMemoryTracker::Register(std::string_view name)
+{
+	std::scoped_lock lock(m_mutex);
+	size_t count = m_count.load(std::memory_order_relaxed);
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (m_slots[i].name == name)
+			return i;
+	}
+	if (count == kMaxSlots)
+		return kInvalidSlot;
+
+	m_slots[count].name = name;
+	m_count.store(count + 1, std::memory_order_release);
+	return count;
+}
+
+void MMMemoryTracker::Add(size_t slot, int64_t bytes)
+{
+	if (slot >= m_count.load(std::memory_order_acquire))
+		return;
+
+	auto &entry = m_slots[slot];
+	entry.native.fetch_add(bytes, std::memory_order_relaxed);
+	if (bytes > 0)
+		entry.allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MMMemoryTracker::SetRuntimeHeap(size_t slot, uint64_t bytes)
+{
+	if (slot < m_count.load(std::memory_order_acquire))
+		m_slots[slot].runtime.store(bytes, std::memory_order_relaxed);
+}
+
+std::optional<MemoryUsage> MMMemoryTracker::Find(std::string_view name) const
+{
+	size_t count = m_count.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const auto &slot = m_slots[i];
+		if (slot.name == name)
+			return MemoryUsage{ slot.native.load(std::memory_order_relaxed), slot.allocations.load(std::memory_order_relaxed), slot.runtime.load(std::memory_order_relaxed) };
+	}
+	return std::nullopt;
+}
+
+void MMMemoryTracker::Reset()
+{
+	// Live bytes and heap sizes are state, not statistics; only the allocation counts restart.
+	size_t count = m_count.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
+	{
+		m_slots[i].allocations.store(0, std::memory_order_relaxed);
+	}
+}
+
+uint64_t MMMemoryTracker::GetResidentBytes()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters {};
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.WorkingSetSize;
+	return 0;
+#else
+	FILE *file = std::fopen("/proc/self/statm", "r");
+	if (!file)
+		return 0;
+	unsigned long long size = 0, resident = 0;
+	int read = std::fscanf(file, "%llu %llu", &size, &resident);
+	std::fclose(file);
+	return read == 2 ? resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE)) : 0;
+#endif
+}
+
+std::string MMMemoryTracker::FormatBytes(int64_t bytes)
+{
+	double value = static_cast<double>(bytes);
+	double magnitude = std::abs(value);
+	if (magnitude >= 1024.0 * 1024.0 * 1024.0)
+		return std::format("{:.2f} GB", value / (1024.0 * 1024.0 * 1024.0));
+	if (magnitude >= 1024.0 * 1024.0)
+		return std::format("{:.1f} MB", value / (1024.0 * 1024.0));
+	if (magnitude >= 1024.0)
+		return std::format("{:.1f} KB", value / 1024.0);
+	return std::format("{} B", bytes);
+}
+
+std::string MMMemoryTracker::Format() const
+{
+	struct Row
+	{
+		std::string_view name;
+		MemoryUsage usage;
+	};
+
+	std::vector<Row> rows;
+	int64_t attributed = 0;
+	size_t count = m_count.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const auto &slot = m_slots[i];
+		auto &row = rows.emplace_back(Row{ slot.name, { slot.native.load(std::memory_order_relaxed), slot.allocations.load(std::memory_order_relaxed), slot.runtime.load(std::memory_order_relaxed) } });
+		attributed += row.usage.native + static_cast<int64_t>(row.usage.runtime);
+	}
+	std::sort(rows.begin(), rows.end(), [](const Row &a, const Row &b) { return a.usage.native + static_cast<int64_t>(a.usage.runtime) > b.usage.native + static_cast<int64_t>(b.usage.runtime); });
+
+	auto resident = static_cast<int64_t>(GetResidentBytes());
+	if (rows.empty())
+	{
+		return std::format("Process resident: {}\n  No language SDK reports memory through the Plugify_Mem* exports, so none is attributed to plugins or modules.\n", FormatBytes(resident));
+	}
+
+	uint64_t sampleInterval = GetSampleInterval();
+	std::string out = std::format("Process resident: {}, reported by language SDKs: {}", FormatBytes(resident), FormatBytes(attributed));
+	out += sampleInterval ? std::format(" (sampled every {})\n", FormatBytes(static_cast<int64_t>(sampleInterval))) : std::string(" (exact)\n");
+	std::format_to(std::back_inserter(out), "  {:<32} {:>10} {:>10} {:>12}\n", "", "native", "runtime", "allocations");
+	for (const auto &row : rows)
+	{
+		std::format_to(std::back_inserter(out), "  {:<32} {:>10} {:>10} {:>12}\n", row.name, FormatBytes(row.usage.native), FormatBytes(static_cast<int64_t>(row.usage.runtime)), row.usage.allocations);
+	}
+	return out;
+}
+
+void MMMemoryTracker::FormatMetrics(std::string &out) const
+{
+	std::format_to(std::back_inserter(out), "# HELP plugify_process_resident_bytes Resident set size of the server.\n# TYPE plugify_process_resident_bytes gauge\nplugify_process_resident_bytes {}\n", GetResidentBytes());
+	out += "# HELP plugify_memory_bytes Memory that language SDKs report for each plugin and module; empty until an SDK reports.\n# TYPE plugify_memory_bytes gauge\n";
+	size_t count = m_count.load(std::memory_order_acquire);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const auto &slot = m_slots[i];
+		for (auto [kind, bytes] : { std::pair<std::string_view, int64_t>{ "native", slot.native.load(std::memory_order_relaxed) }, { "runtime", static_cast<int64_t>(slot.runtime.load(std::memory_order_relaxed)) } })
+		{
+			out += "plugify_memory_bytes{name=\"";
+			AppendMetricLabel(out, slot.name);
+			std::format_to(std::back_inserter(out), "\",kind=\"{}\"}} {}\n", kind, bytes);
+		}
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace plugifyMM
+{
+	struct MemoryUsage
+	{
+		int64_t native { 0 };      // live bytes reported by allocator shims
+		uint64_t allocations { 0 }; // reported allocations, sampled ones when sampling
+		uint64_t runtime { 0 };    // managed heap size reported by the language runtime
+	};
+
+	// Memory held by plugins and language modules. The core allocates through the plugins'
+	// own runtimes, so accounting can only come from the language SDKs: allocator shims report
+	// live byte deltas and runtimes report their heap sizes through the Plugify_Mem* exports.
+	// Until an SDK does, only the process resident size is known. With a sampling interval,
+	// shims only report an allocation once per interval bytes, weighted by the interval.
+	class MMMemoryTracker
+	{
+	public:
+		static constexpr size_t kMaxSlots = 256;
+		static constexpr size_t kInvalidSlot = static_cast<size_t>(-1);
+
+		size_t Register(std::string_view name);
+		void Add(size_t slot, int64_t bytes);
+		void SetRuntimeHeap(size_t slot, uint64_t bytes);
+
+		std::optional<MemoryUsage> Find(std::string_view name) const;
+		void Reset();
+
+		// Copy of the mem_sample_bytes setting, which shims may query on every allocation.
+		void SetSampleInterval(uint64_t bytes) { m_sampleInterval.store(bytes, std::memory_order_relaxed); }
+		uint64_t GetSampleInterval() const { return m_sampleInterval.load(std::memory_order_relaxed); }
+
+		std::string Format() const;
+		void FormatMetrics(std::string &out) const;
+
+		static std::string FormatBytes(int64_t bytes);
+
+	private:
+		struct Slot
+		{
+			std::string name;
+			std::atomic<int64_t> native { 0 };
+			std::atomic<uint64_t> allocations { 0 };
+			std::atomic<uint64_t> runtime { 0 };
+		};
+
+		static uint64_t GetResidentBytes();
+
+	private:
+		mutable std::mutex m_mutex; // guards registration
+		std::array<Slot, kMaxSlots> m_slots;
+		std::atomic<size_t> m_count { 0 };
+		std::atomic<uint64_t> m_sampleInterval { 0 };
+	};
+} // namespace plugifyMM
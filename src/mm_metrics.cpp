@@ -0,0 +1,266 @@
+#include "mm_metrics.h"
+
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+
+#include <plugify/compat_format.h>
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+using Socket = SOCKET;
+static constexpr Socket kInvalidSocket = INVALID_SOCKET;
+static void CloseSocket(Socket socket) { closesocket(socket); }
+static int PollSocket(pollfd *fds, unsigned long count, int timeout) { return WSAPoll(fds, count, timeout); }
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+using Socket = int;
+static constexpr Socket kInvalidSocket = -1;
+static void CloseSocket(Socket socket) { close(socket); }
+static int PollSocket(pollfd *fds, nfds_t count, int timeout) { return poll(fds, count, timeout); }
+#endif
+
+#if defined(MSG_NOSIGNAL)
+static constexpr int kSendFlags = MSG_NOSIGNAL; // a scraper hanging up must not raise SIGPIPE
+#else
+static constexpr int kSendFlags = 0;
+#endif
+
+using namespace plugifyMM;
+
+void plugifyMM::AppendMetricLabel(std::string &out, std::string_view value)
+{
+	for (char c : value)
+	{
+		switch (c)
+		{
+			case '\\': out += "\\\\"; break;
+			case '"': out += "\\\""; break;
+			case '\n': out += "\\n"; break;
+			default: out += c; break;
+		}
+	}
+}
+
+MMMetricsServer::~MMMetricsServer()
+{
+	Stop();
+}
+
+bool MMMetricsServer::Start(std::string_view address, std::string &error)
+{
+	Stop();
+
+#if defined(_WIN32)
+	WSADATA data;
+	if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+	{
+		error = "cannot initialize Winsock";
+		return false;
+	}
+	if (!Listen(address, error))
+	{
+		WSACleanup();
+		return false;
+	}
+#else
+	if (!Listen(address, error))
+		return false;
+#endif
+
+	m_address = address;
+	m_stop.store(false, std::memory_order_relaxed);
+	m_thread = std::thread(&MMMetricsServer::Run, this);
+	return true;
+}
+
+bool MMMetricsServer::Listen(std::string_view address, std::string &error)
+{
+	Socket socket = kInvalidSocket;
+	if (address.starts_with("unix:"))
+	{
+#if defined(_WIN32)
+		error = "Unix sockets are not supported on Windows, use a port";
+		return false;
+#else
+		std::string path(address.substr(5));
+		sockaddr_un addr {};
+		if (path.empty() || path.size() >= sizeof(addr.sun_path))
+		{
+			error = std::format("invalid socket path '{}'", path);
+			return false;
+		}
+		addr.sun_family = AF_UNIX;
+		std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+		// Only a socket left by an earlier run is replaced; any other file at the path is kept.
+		struct stat existing {};
+		if (lstat(path.c_str(), &existing) == 0)
+		{
+			if (!S_ISSOCK(existing.st_mode))
+			{
+				error = std::format("{} exists and is not a socket", path);
+				return false;
+			}
+			unlink(path.c_str());
+		}
+
+		socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		if (socket == kInvalidSocket || bind(socket, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+		{
+			if (socket != kInvalidSocket)
+				CloseSocket(socket);
+			error = std::format("cannot bind {}: {}", path, std::strerror(errno));
+			return false;
+		}
+		m_unixPath = std::move(path);
+#endif
+	}
+	else
+	{
+		std::string host = "127.0.0.1";
+		std::string_view port = address;
+		if (auto colon = address.rfind(':'); colon != std::string_view::npos)
+		{
+			host = address.substr(0, colon);
+			port = address.substr(colon + 1);
+		}
+
+		uint16_t number = 0;
+		auto [end, ec] = std::from_chars(port.data(), port.data() + port.size(), number);
+		if (ec != std::errc() || end != port.data() + port.size() || number == 0)
+		{
+			error = std::format("invalid port '{}'", port);
+			return false;
+		}
+
+		sockaddr_in addr {};
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(number);
+		if (host == "localhost")
+			host = "127.0.0.1";
+		if (inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1 || (ntohl(addr.sin_addr.s_addr) >> 24) != 127)
+		{
+			error = std::format("'{}' is not a loopback address", host);
+			return false;
+		}
+
+		socket = ::socket(AF_INET, SOCK_STREAM, 0);
+		int reuse = 1;
+		if (socket != kInvalidSocket)
+			setsockopt(socket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&reuse), sizeof(reuse));
+		if (socket == kInvalidSocket || bind(socket, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0)
+		{
+			if (socket != kInvalidSocket)
+				CloseSocket(socket);
+			error = std::format("cannot bind {}:{}", host, number);
+			return false;
+		}
+	}
+
+	if (listen(socket, 8) != 0)
+	{
+		CloseSocket(socket);
+		error = "cannot listen";
+		return false;
+	}
+
+	m_socket = static_cast<intptr_t>(socket);
+	return true;
+}
+
+void MMMetricsServer::Stop()
+{
+	if (!m_thread.joinable())
+		return;
+
+	m_stop.store(true, std::memory_order_relaxed);
+	m_thread.join();
+	CloseSocket(static_cast<Socket>(m_socket));
+	m_socket = -1;
+#if !defined(_WIN32)
+	if (!m_unixPath.empty())
+		unlink(m_unixPath.c_str());
+#else
+	WSACleanup();
+#endif
+	m_unixPath.clear();
+	m_address.clear();
+}
+
+void MMMetricsServer::Publish(std::string text)
+{
+	auto now = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+	std::scoped_lock lock(m_mutex);
+	m_text = std::move(text);
+	m_published = now;
+}
+
+void MMMetricsServer::Run()
+{
+	auto listener = static_cast<Socket>(m_socket);
+	std::string response;
+	while (!m_stop.load(std::memory_order_relaxed))
+	{
+		pollfd fd {};
+		fd.fd = listener;
+		fd.events = POLLIN;
+		if (PollSocket(&fd, 1, 250) <= 0)
+			continue;
+
+		Socket client = accept(listener, nullptr, nullptr);
+		if (client == kInvalidSocket)
+			continue;
+
+		// A scraper that stops reading must not block this thread, or Stop() would never join it.
+#if defined(_WIN32)
+		DWORD timeout = 1000;
+#else
+		timeval timeout { 1, 0 };
+#endif
+		setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char *>(&timeout), sizeof(timeout));
+
+		// Read the request head; its content does not matter, every path gets the metrics.
+		std::string request;
+		char buffer[1024];
+		while (request.size() < 8192 && request.find("\r\n\r\n") == std::string::npos)
+		{
+			pollfd in {};
+			in.fd = client;
+			in.events = POLLIN;
+			if (PollSocket(&in, 1, 1000) <= 0)
+				break;
+			auto received = recv(client, buffer, sizeof(buffer), 0);
+			if (received <= 0)
+				break;
+			request.append(buffer, static_cast<size_t>(received));
+		}
+
+		{
+			std::scoped_lock lock(m_mutex);
+			// Snapshots are only rebuilt while the game thread runs frames, so scrapers can tell a stale one.
+			auto updated = std::format("# HELP plugify_metrics_last_update_timestamp_seconds When this snapshot was built.\n# TYPE plugify_metrics_last_update_timestamp_seconds gauge\nplugify_metrics_last_update_timestamp_seconds {:.3f}\n", m_published);
+			response = std::format("HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: {}\r\nConnection: close\r\n\r\n", m_text.size() + updated.size());
+			response += m_text;
+			response += updated;
+		}
+		size_t sent = 0;
+		while (sent < response.size() && !m_stop.load(std::memory_order_relaxed))
+		{
+			auto written = send(client, response.data() + sent, static_cast<int>(response.size() - sent), kSendFlags);
+			if (written <= 0)
+				break;
+			sent += static_cast<size_t>(written);
+		}
+		CloseSocket(client);
+		m_scrapes.fetch_add(1, std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace plugifyMM
+{
+	// Appends a Prometheus label value with '\', '"' and newlines escaped, without quotes.
+	void AppendMetricLabel(std::string &out, std::string_view value);
+
+	// Serves Prometheus text exposition over HTTP/1.0 on a Unix socket or a loopback port.
+	// Scrapes are answered from the background thread with the last published snapshot,
+	// so they never wait for the game thread, together with the time it was published.
+	class MMMetricsServer
+	{
+	public:
+		~MMMetricsServer();
+
+		// "unix:<path>", "<port>" or "<host>:<port>" with a loopback host.
+		bool Start(std::string_view address, std::string &error);
+		void Stop();
+		bool IsRunning() const { return m_thread.joinable(); }
+		const std::string &GetAddress() const { return m_address; }
+		uint64_t GetScrapes() const { return m_scrapes.load(std::memory_order_relaxed); }
+
+		void Publish(std::string text);
+
+	private:
+		bool Listen(std::string_view address, std::string &error);
+		void Run();
+
+	private:
+		intptr_t m_socket { -1 };
+		std::string m_address;
+		std::string m_unixPath;
+		std::thread m_thread;
+		std::atomic<bool> m_stop { false };
+		std::atomic<uint64_t> m_scrapes { 0 };
+		std::mutex m_mutex;
+		std::string m_text;
+		double m_published { 0.0 }; // Unix time of the last Publish()
+	};
+} // namespace plugifyMM
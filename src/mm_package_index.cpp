@@ -0,0 +1,149 @@
+#include "mm_package_index.h"
+
+#include <algorithm>
+#include <cctype>
+
+using namespace plugifyMM;
+
+// Lower-case words separated by single spaces, everything else dropped.
+static std::string Normalize(std::string_view text)
+{
+	std::string normalized;
+	normalized.reserve(text.size());
+	for (char c : text)
+	{
+		auto ch = static_cast<unsigned char>(c);
+		if (std::isalnum(ch))
+			normalized += static_cast<char>(std::tolower(ch));
+		else if (!normalized.empty() && normalized.back() != ' ')
+			normalized += ' ';
+	}
+	if (!normalized.empty() && normalized.back() == ' ')
+		normalized.pop_back();
+	return normalized;
+}
+
+// Trigrams of every word padded as "  word ", so short words and prefixes still match.
+template<typename Callback>
+static void ForEachTrigram(std::string_view normalized, Callback &&callback)
+{
+	std::string padded;
+	size_t start = 0;
+	while (start < normalized.size())
+	{
+		size_t end = normalized.find(' ', start);
+		if (end == std::string_view::npos)
+			end = normalized.size();
+
+		padded.assign("  ");
+		padded.append(normalized.substr(start, end - start));
+		padded += ' ';
+		for (size_t i = 0; i + 3 <= padded.size(); ++i)
+		{
+			callback(static_cast<uint32_t>(static_cast<unsigned char>(padded[i])) << 16 | static_cast<uint32_t>(static_cast<unsigned char>(padded[i + 1])) << 8 | static_cast<unsigned char>(padded[i + 2]));
+		}
+		start = end + 1;
+	}
+}
+
+void MMPackageIndex::Build(std::vector<plugify::RemotePackage> packages)
+{
+	std::sort(packages.begin(), packages.end(), [](const auto &a, const auto &b) { return a.name < b.name; });
+
+	m_packages = std::move(packages);
+	m_names.clear();
+	m_texts.clear();
+	m_postings.clear();
+
+	for (uint32_t document = 0; document < m_packages.size(); ++document)
+	{
+		const auto &package = m_packages[document];
+		auto &name = m_names.emplace_back(Normalize(package.name));
+		auto &text = m_texts.emplace_back(Normalize(package.author + " " + package.description));
+
+		auto add = [&](uint8_t field)
+		{
+			return [&, field](uint32_t trigram)
+			{
+				auto &postings = m_postings[trigram];
+				if (!postings.empty() && postings.back().document == document)
+					postings.back().fields |= field;
+				else
+					postings.push_back({ document, field });
+			};
+		};
+		ForEachTrigram(name, add(Field::Name));
+		ForEachTrigram(text, add(Field::Text));
+	}
+	m_stale = false;
+}
+
+PackageSearchResult MMPackageIndex::Search(std::string_view query, std::string_view type, size_t offset, size_t limit) const
+{
+	PackageSearchResult result;
+	auto matchesType = [&](size_t document) { return m_packages[document].type.starts_with(type); };
+
+	auto normalized = Normalize(query);
+	if (normalized.empty())
+	{
+		for (size_t document = 0; document < m_packages.size(); ++document)
+		{
+			if (!matchesType(document))
+				continue;
+			if (result.total >= offset && result.hits.size() < limit)
+				result.hits.push_back({ document, 0.0f });
+			++result.total;
+		}
+		return result;
+	}
+
+	std::vector<uint32_t> trigrams;
+	ForEachTrigram(normalized, [&](uint32_t trigram) { trigrams.push_back(trigram); });
+	std::sort(trigrams.begin(), trigrams.end());
+	trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+	// Share of the query's trigrams found in a package, name hits weighing double.
+	std::vector<float> scores(m_packages.size(), 0.0f);
+	std::vector<uint32_t> candidates;
+	for (uint32_t trigram : trigrams)
+	{
+		auto it = m_postings.find(trigram);
+		if (it == m_postings.end())
+			continue;
+		for (const auto &posting : it->second)
+		{
+			if (scores[posting.document] == 0.0f)
+				candidates.push_back(posting.document);
+			scores[posting.document] += (posting.fields & Field::Name) ? 1.0f : 0.5f;
+		}
+	}
+
+	float total = static_cast<float>(trigrams.size());
+	std::vector<PackageSearchHit> hits;
+	for (uint32_t document : candidates)
+	{
+		float score = scores[document] / total;
+		const auto &name = m_names[document];
+		if (name == normalized)
+			score += 2.0f;
+		else if (name.starts_with(normalized))
+			score += 1.0f;
+		else if (name.find(normalized) != std::string::npos)
+			score += 0.5f;
+		else if (m_texts[document].find(normalized) != std::string::npos)
+			score += 0.25f;
+
+		if (score >= 0.3f && matchesType(document))
+			hits.push_back({ document, score });
+	}
+
+	result.total = hits.size();
+	auto byScore = [&](const PackageSearchHit &a, const PackageSearchHit &b) { return a.score != b.score ? a.score > b.score : a.index < b.index; };
+	size_t end = std::min(hits.size(), offset + limit);
+	if (offset >= end)
+		return result;
+
+	std::partial_sort(hits.begin(), hits.begin() + static_cast<ptrdiff_t>(end), hits.end(), byScore);
+	result.hits.assign(hits.begin() + static_cast<ptrdiff_t>(offset), hits.begin() + static_cast<ptrdiff_t>(end));
+	return result;
+}
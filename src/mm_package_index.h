@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <plugify/package.h>
+
+namespace plugifyMM
+{
+	struct PackageSearchHit
+	{
+		size_t index; // into GetPackages()
+		float score;
+	};
+
+	struct PackageSearchResult
+	{
+		size_t total { 0 }; // matches before pagination
+		std::vector<PackageSearchHit> hits;
+	};
+
+	// In-memory trigram index over remote package names, authors and descriptions.
+	// Built once per manifest load; lookups only touch the postings of the query's trigrams.
+	class MMPackageIndex
+	{
+	public:
+		void Build(std::vector<plugify::RemotePackage> packages);
+
+		void Invalidate() { m_stale = true; }
+		bool IsStale() const { return m_stale; }
+
+		// Ranked fuzzy match; an empty query lists everything by name. 'type' keeps packages
+		// whose type starts with it. Hits are sorted by score and cut to [offset, offset + limit).
+		PackageSearchResult Search(std::string_view query, std::string_view type, size_t offset, size_t limit) const;
+
+		const std::vector<plugify::RemotePackage> &GetPackages() const { return m_packages; }
+
+	private:
+		enum Field : uint8_t
+		{
+			Name = 1 << 0,
+			Text = 1 << 1, // author or description
+		};
+
+		struct Posting
+		{
+			uint32_t document;
+			uint8_t fields;
+		};
+
+	private:
+		std::vector<plugify::RemotePackage> m_packages;
+		std::vector<std::string> m_names; // normalized
+		std::vector<std::string> m_texts; // normalized author and description
+		std::unordered_map<uint32_t, std::vector<Posting>> m_postings;
+		bool m_stale { true };
+	};
+} // namespace plugifyMM
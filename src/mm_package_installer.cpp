@@ -0,0 +1,361 @@
+#include "mm_package_installer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <stdexcept>
+
+#include <miniz.h>
+
+#include "mm_package_verify.h"
+#include "mm_zip_stream.h"
+
+#include <plugify/compat_format.h>
+#include <plugify/package.h>
+#include <plugify/package_manager.h>
+
+using namespace plugifyMM;
+
+MMPackageInstaller::MMPackageInstaller(MMHttpClient &http, std::filesystem::path baseDir) : m_http(http), m_baseDir(std::move(baseDir))
+{
+}
+
+std::vector<PackageDownload> MMPackageInstaller::Plan(const plugify::IPackageManager &packageManager, std::span<const std::string> names, bool update, std::vector<std::string> &messages) const
+{
+	std::vector<PackageDownload> downloads;
+	for (const auto &name : names)
+	{
+		auto remote = packageManager.FindRemotePackage(name);
+		if (!remote || remote->versions.empty())
+		{
+			messages.emplace_back(std::format("Package '{}' not found in repositories", name));
+			continue;
+		}
+
+		const auto &latest = *std::max_element(remote->versions.begin(), remote->versions.end(), [](const auto &a, const auto &b) { return a.version < b.version; });
+
+		auto local = packageManager.FindLocalPackage(name);
+		if (update && !local)
+		{
+			messages.emplace_back(std::format("Package '{}' is not installed", name));
+			continue;
+		}
+		if (!update && local)
+		{
+			messages.emplace_back(std::format("Package '{}' is already installed", name));
+			continue;
+		}
+		if (local && local->version >= latest.version)
+		{
+			messages.emplace_back(std::format("Package '{}' is up to date (v{})", name, local->version));
+			continue;
+		}
+		if (latest.download.empty())
+		{
+			messages.emplace_back(std::format("Package '{}' v{} has no download link", name, latest.version));
+			continue;
+		}
+
+		downloads.push_back(Prepare(name, remote->type, latest.version, latest.download, latest.checksum, local ? local->path.parent_path() : std::filesystem::path()));
+	}
+	return downloads;
+}
+
+PackageDownload MMPackageInstaller::Prepare(std::string_view name, std::string_view type, int32_t version, std::string_view url, std::string_view checksum, const std::filesystem::path &installed) const
+{
+	PackageDownload download;
+	download.name = name;
+	download.version = version;
+	download.url = url;
+	download.checksum = checksum;
+	download.key = StoreKey(download);
+	download.destination = !installed.empty() ? installed : m_baseDir / (type == "plugin" ? "plugins" : "modules") / name;
+	download.archive = m_baseDir / ".cache" / "downloads" / std::format("{}-{}.zip", name, version);
+	return download;
+}
+
+void MMPackageInstaller::Download(std::vector<PackageDownload> &downloads, const std::atomic<bool> *cancel)
+{
+	auto pending = LinkFromStore(downloads);
+	if (pending.empty())
+		return;
+
+	std::error_code ec;
+	std::filesystem::create_directories(downloads.front().archive.parent_path(), ec);
+
+	std::vector<std::ofstream> files(pending.size());
+	std::vector<MMSha256> hashes(pending.size());
+	std::vector<HttpRequest> requests(pending.size());
+	for (size_t i = 0; i < pending.size(); ++i)
+	{
+		const auto &download = downloads[pending[i]];
+		auto part = std::filesystem::path(download.archive).concat(".part");
+		auto &file = files[i];
+		file.open(part, std::ios::binary | std::ios::trunc);
+		if (!file)
+			throw std::runtime_error(std::format("Cannot write {}", part.string()));
+
+		requests[i].url = download.url;
+		auto &hash = hashes[i];
+		requests[i].onData = [&file, &hash](const char *data, size_t size)
+		{
+			hash.Update(data, size);
+			file.write(data, static_cast<std::streamsize>(size));
+			return static_cast<bool>(file);
+		};
+		requests[i].onRetry = [&file, &hash, part]
+		{
+			hash = MMSha256();
+			file.close();
+			file.open(part, std::ios::binary | std::ios::trunc);
+		};
+	}
+
+	auto responses = m_http.Perform(requests, cancel);
+
+	std::string sErrors;
+	for (size_t i = 0; i < pending.size(); ++i)
+	{
+		const auto &download = downloads[pending[i]];
+		files[i].close();
+		auto part = std::filesystem::path(download.archive).concat(".part");
+		std::string error = responses[i].Ok() ? std::string() : responses[i].error.empty() ? std::format("HTTP {}", responses[i].status) : responses[i].error;
+		if (error.empty())
+		{
+			VerifyChecksum(download, hashes[i].Final(), error);
+		}
+		if (!error.empty())
+		{
+			std::filesystem::remove(part, ec);
+			std::format_to(std::back_inserter(sErrors), "{}{}: {}", sErrors.empty() ? "" : ", ", download.name, error);
+			continue;
+		}
+		std::filesystem::rename(part, download.archive, ec);
+	}
+
+	if (!sErrors.empty())
+		throw std::runtime_error(std::format("Download failed ({})", sErrors));
+}
+
+std::vector<size_t> MMPackageInstaller::LinkFromStore(std::vector<PackageDownload> &downloads) const
+{
+	std::vector<size_t> pending;
+	for (size_t i = 0; i < downloads.size(); ++i)
+	{
+		auto &download = downloads[i];
+		std::string error;
+		download.fromStore = m_store && !download.key.empty() && m_store->Materialize(download.key, GetStaging(download), error);
+		if (!download.fromStore)
+			pending.push_back(i);
+	}
+	return pending;
+}
+
+std::filesystem::path MMPackageInstaller::GetStaging(const PackageDownload &download)
+{
+	return download.destination.parent_path() / std::format(".{}.staging", download.name);
+}
+
+std::string MMPackageInstaller::StoreKey(const PackageDownload &download)
+{
+	// Without a checksum nothing vouches for what the URL serves, so the package stays private.
+	std::string key = download.checksum;
+	if (key.size() != 64 || !std::all_of(key.begin(), key.end(), [](unsigned char c) { return std::isxdigit(c); }))
+		return {};
+
+	std::transform(key.begin(), key.end(), key.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+	return key;
+}
+
+bool MMPackageInstaller::VerifyChecksum(const PackageDownload &download, const MMSha256::Digest &digest, std::string &error)
+{
+	// Only SHA-256 hex digests are checked; anything else in the manifest is ignored.
+	const auto &expected = download.checksum;
+	if (expected.size() != 64 || !std::all_of(expected.begin(), expected.end(), [](unsigned char c) { return std::isxdigit(c); }))
+		return true;
+
+	std::string actual = MMSha256::ToHex(digest);
+	if (std::equal(actual.begin(), actual.end(), expected.begin(), [](char a, char b) { return a == std::tolower(static_cast<unsigned char>(b)); }))
+		return true;
+
+	error = std::format("checksum mismatch (expected {}, got {})", expected, actual);
+	return false;
+}
+
+void MMPackageInstaller::Extract(const PackageDownload &download) const
+{
+	Unpack(download);
+	Commit(download);
+	std::error_code ec;
+	std::filesystem::remove(download.archive, ec);
+}
+
+void MMPackageInstaller::Unpack(const PackageDownload &download) const
+{
+	if (download.fromStore)
+		return;
+
+	auto staging = GetStaging(download);
+
+	std::error_code ec;
+	std::filesystem::remove_all(staging, ec);
+	std::filesystem::create_directories(staging, ec);
+	if (ec)
+		throw std::runtime_error(std::format("Cannot create {}: {}", staging.string(), ec.message()));
+
+	mz_zip_archive zip;
+	mz_zip_zero_struct(&zip);
+	if (!mz_zip_reader_init_file(&zip, download.archive.string().c_str(), 0))
+		throw std::runtime_error(std::format("{}: not a valid archive", download.archive.string()));
+
+	std::string error;
+	mz_uint count = mz_zip_reader_get_num_files(&zip);
+	for (mz_uint i = 0; i < count && error.empty(); ++i)
+	{
+		mz_zip_archive_file_stat stat;
+		if (!mz_zip_reader_file_stat(&zip, i, &stat))
+		{
+			error = std::format("corrupt entry #{}", i);
+			break;
+		}
+
+		auto relative = std::filesystem::path(stat.m_filename).lexically_normal();
+		if (relative.is_absolute() || relative.has_root_name() || (!relative.empty() && *relative.begin() == ".."))
+		{
+			error = std::format("entry escapes package directory: {}", stat.m_filename);
+			break;
+		}
+
+		auto target = staging / relative;
+		if (mz_zip_reader_is_file_a_directory(&zip, i))
+		{
+			std::filesystem::create_directories(target, ec);
+			continue;
+		}
+
+		std::filesystem::create_directories(target.parent_path(), ec);
+		if (!mz_zip_reader_extract_to_file(&zip, i, target.string().c_str(), 0))
+			error = std::format("cannot extract {}", stat.m_filename);
+	}
+	mz_zip_reader_end(&zip);
+
+	if (!error.empty())
+	{
+		std::filesystem::remove_all(staging, ec);
+		throw std::runtime_error(std::format("{}: {}", download.name, error));
+	}
+
+	if (m_store && !download.key.empty())
+	{
+		m_store->Import(download.key, staging, error);
+	}
+}
+
+void MMPackageInstaller::DownloadAndExtract(std::vector<PackageDownload> &downloads, const std::atomic<bool> *cancel)
+{
+	auto pending = LinkFromStore(downloads);
+	if (pending.empty())
+		return;
+
+	std::vector<std::unique_ptr<MMZipStreamExtractor>> extractors;
+	std::vector<MMSha256> hashes(pending.size());
+	std::vector<HttpRequest> requests(pending.size());
+	for (size_t i = 0; i < pending.size(); ++i)
+	{
+		const auto &download = downloads[pending[i]];
+		auto &extractor = *extractors.emplace_back(std::make_unique<MMZipStreamExtractor>(GetStaging(download)));
+		auto &hash = hashes[i];
+		requests[i].url = download.url;
+		requests[i].onData = [&extractor, &hash](const char *data, size_t size)
+		{
+			hash.Update(data, size);
+			return extractor.Write(data, size);
+		};
+		requests[i].onRetry = [&extractor, &hash]
+		{
+			hash = MMSha256();
+			extractor.Reset();
+		};
+	}
+
+	auto responses = m_http.Perform(requests, cancel);
+
+	std::string sErrors;
+	for (size_t i = 0; i < pending.size(); ++i)
+	{
+		const auto &download = downloads[pending[i]];
+		auto &extractor = *extractors[i];
+		std::string error;
+		if (!extractor.GetError().empty())
+			error = extractor.GetError();
+		else if (!responses[i].Ok())
+			error = responses[i].error.empty() ? std::format("HTTP {}", responses[i].status) : responses[i].error;
+		else if (!extractor.Finish())
+			error = extractor.GetError();
+		else
+			VerifyChecksum(download, hashes[i].Final(), error);
+
+		if (!error.empty())
+		{
+			std::format_to(std::back_inserter(sErrors), "{}{}: {}", sErrors.empty() ? "" : ", ", download.name, error);
+		}
+	}
+
+	if (!sErrors.empty())
+	{
+		std::error_code ec;
+		for (const auto &download : downloads)
+		{
+			std::filesystem::remove_all(GetStaging(download), ec);
+		}
+		throw std::runtime_error(std::format("Download failed ({})", sErrors));
+	}
+
+	if (m_store)
+	{
+		for (size_t index : pending)
+		{
+			std::string error;
+			if (!downloads[index].key.empty())
+				m_store->Import(downloads[index].key, GetStaging(downloads[index]), error);
+		}
+	}
+}
+
+void MMPackageInstaller::Commit(const PackageDownload &download) const
+{
+	const auto &destination = download.destination;
+	auto staging = GetStaging(download);
+	auto previous = destination.parent_path() / std::format(".{}.old", download.name);
+
+	// Record what was installed so 'plugify verify' can tell later edits apart.
+	MMPackageVerifier({}, 0).WriteBaseline(staging);
+
+	std::error_code ec;
+	std::filesystem::remove_all(previous, ec);
+	bool replaced = std::filesystem::exists(destination);
+	if (replaced)
+	{
+		std::filesystem::rename(destination, previous, ec);
+		if (ec)
+		{
+			std::filesystem::remove_all(staging, ec);
+			throw std::runtime_error(std::format("{}: cannot replace {}", download.name, destination.string()));
+		}
+	}
+
+	std::filesystem::rename(staging, destination, ec);
+	if (ec)
+	{
+		if (replaced)
+			std::filesystem::rename(previous, destination, ec);
+		std::filesystem::remove_all(staging, ec);
+		throw std::runtime_error(std::format("{}: cannot move package into {}", download.name, destination.string()));
+	}
+
+	std::filesystem::remove_all(previous, ec);
+	if (m_store && !download.key.empty())
+	{
+		m_store->AddReference(download.key, destination);
+	}
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "mm_http.h"
+#include "mm_package_store.h"
+#include "mm_sha256.h"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace plugify
+{
+	class IPackageManager;
+}
+
+namespace plugifyMM
+{
+	struct PackageDownload
+	{
+		std::string name;
+		int32_t version;
+		std::string url;
+		std::string checksum;
+		std::filesystem::path destination;
+		std::filesystem::path archive;
+		std::string key;        // store key, the archive's SHA-256; empty when the manifest has none
+		bool fromStore { false }; // staged from the package store, nothing to download
+	};
+
+	// Fetches package archives concurrently through MMHttpClient and swaps them into place.
+	// Used by 'install -p' and 'update -p'; the package manager rescans the tree afterwards.
+	class MMPackageInstaller
+	{
+	public:
+		MMPackageInstaller(MMHttpClient &http, std::filesystem::path baseDir);
+
+		// Optional host-wide store: packages found there are linked instead of downloaded,
+		// and new downloads are added to it.
+		void SetStore(std::shared_ptr<const MMPackageStore> store) { m_store = std::move(store); }
+
+		// Picks the latest remote version of each package. With 'update' set, only installed
+		// packages with a newer remote version are returned. Skipped packages are reported in 'messages'.
+		std::vector<PackageDownload> Plan(const plugify::IPackageManager &packageManager, std::span<const std::string> names, bool update, std::vector<std::string> &messages) const;
+
+		// Describes one exact version, e.g. from a lockfile. 'installed' is the current package
+		// directory, empty when the package is not installed.
+		PackageDownload Prepare(std::string_view name, std::string_view type, int32_t version, std::string_view url, std::string_view checksum, const std::filesystem::path &installed) const;
+
+		// Downloads every archive into the cache; throws if any of them failed.
+		void Download(std::vector<PackageDownload> &downloads, const std::atomic<bool> *cancel);
+
+		// Extracts a cached archive into the staging directory next to the destination, then commits it.
+		void Extract(const PackageDownload &download) const;
+
+		// Extracts a cached archive into the staging directory only, leaving the package in place.
+		void Unpack(const PackageDownload &download) const;
+
+		// Inflates archives into their staging directories while they download, hashing as bytes
+		// arrive, so nothing but the extracted files touches the disk. Throws if any of them failed.
+		void DownloadAndExtract(std::vector<PackageDownload> &downloads, const std::atomic<bool> *cancel);
+
+		// Renames the staging directory into place; the old tree is only removed once that succeeded.
+		void Commit(const PackageDownload &download) const;
+
+		static std::filesystem::path GetStaging(const PackageDownload &download);
+
+	private:
+		std::vector<size_t> LinkFromStore(std::vector<PackageDownload> &downloads) const;
+
+		static std::string StoreKey(const PackageDownload &download);
+		static bool VerifyChecksum(const PackageDownload &download, const MMSha256::Digest &digest, std::string &error);
+
+	private:
+		MMHttpClient &m_http;
+		std::filesystem::path m_baseDir;
+		std::shared_ptr<const MMPackageStore> m_store;
+	};
+} // namespace plugifyMM
@@ -0,0 +1,191 @@
+#include "mm_package_lock.h"
+#include "mm_package_store.h"
+#include "mm_package_verify.h"
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include <plugify/compat_format.h>
+#include <plugify/package.h>
+#include <plugify/package_manager.h>
+
+using namespace plugifyMM;
+
+static constexpr std::string_view kLockHeader = "# plugify lockfile v2";
+static constexpr std::string_view kLockHeaderV1 = "# plugify lockfile v1";
+
+// Fields are separated by spaces, so anything that would split or blank one is %-escaped;
+// '-' alone stands for an empty value.
+static std::string Escape(std::string_view value)
+{
+	if (value.empty())
+		return "-";
+	if (value == "-")
+		return "%2D";
+
+	std::string out;
+	for (char c : value)
+	{
+		auto byte = static_cast<unsigned char>(c);
+		if (byte <= ' ' || byte == '%' || byte == 0x7F)
+			std::format_to(std::back_inserter(out), "%{:02X}", byte);
+		else
+			out += c;
+	}
+	return out;
+}
+
+static std::string Unescape(std::string_view value)
+{
+	if (value == "-")
+		return {};
+
+	std::string out;
+	for (size_t i = 0; i < value.size(); ++i)
+	{
+		unsigned int byte;
+		if (value[i] == '%' && i + 2 < value.size() && std::from_chars(value.data() + i + 1, value.data() + i + 3, byte, 16).ptr == value.data() + i + 3)
+		{
+			out += static_cast<char>(byte);
+			i += 2;
+		}
+		else
+		{
+			out += value[i];
+		}
+	}
+	return out;
+}
+
+MMPackageLock MMPackageLock::Capture(const plugify::IPackageManager &packageManager, MMPackageVerifier &verifier)
+{
+	MMPackageLock lock;
+	for (const auto &local : packageManager.GetLocalPackages())
+	{
+		LockEntry &entry = lock.m_entries.emplace_back();
+		entry.name = local.name;
+		entry.type = local.type;
+		entry.version = local.version;
+		entry.files = verifier.GetContentDigest(local.path.parent_path()).value_or(std::string());
+		entry.store = MMPackageStore::GetSharedKey(local.path.parent_path()).value_or(std::string());
+
+		if (auto remote = packageManager.FindRemotePackage(local.name))
+		{
+			auto it = std::find_if(remote->versions.begin(), remote->versions.end(), [&](const auto &version) { return version.version == local.version; });
+			if (it != remote->versions.end())
+			{
+				entry.checksum = it->checksum;
+				entry.url = it->download;
+			}
+		}
+	}
+	std::sort(lock.m_entries.begin(), lock.m_entries.end(), [](const auto &a, const auto &b) { return a.name < b.name; });
+	return lock;
+}
+
+bool MMPackageLock::Load(const std::filesystem::path &file, std::string &error)
+{
+	std::ifstream stream(file);
+	if (!stream)
+	{
+		error = std::format("cannot open {}", file.string());
+		return false;
+	}
+
+	// v2: "<name> <type> <version> <checksum> <store> <files> <url>", escaped, '-' for unknown values
+	// v1: "<name> <type> <version> <checksum> <files> <url>", unescaped
+	std::vector<LockEntry> entries;
+	std::string line;
+	bool v1 = false;
+	for (size_t number = 1; std::getline(stream, line); ++number)
+	{
+		if (number == 1 && line == kLockHeaderV1)
+			v1 = true;
+		if (line.empty() || line.front() == '#')
+			continue;
+
+		std::istringstream fields(line);
+		LockEntry entry;
+		std::string name, type, checksum, store, files, url;
+		if (!(fields >> name >> type >> entry.version >> checksum) || (!v1 && !(fields >> store)) || !(fields >> files >> url))
+		{
+			error = std::format("{}:{}: malformed entry", file.string(), number);
+			return false;
+		}
+		auto decode = [v1](const std::string &value) { return v1 ? (value == "-" ? std::string() : value) : Unescape(value); };
+		entry.name = decode(name);
+		entry.type = decode(type);
+		entry.checksum = decode(checksum);
+		entry.store = decode(store);
+		entry.files = decode(files);
+		entry.url = decode(url);
+		entries.push_back(std::move(entry));
+	}
+
+	m_entries = std::move(entries);
+	return true;
+}
+
+bool MMPackageLock::Save(const std::filesystem::path &file, std::string &error) const
+{
+	std::ofstream stream(file, std::ios::trunc);
+	stream << kLockHeader << '\n';
+	for (const auto &entry : m_entries)
+	{
+		stream << std::format("{} {} {} {} {} {} {}\n", Escape(entry.name), Escape(entry.type), entry.version, Escape(entry.checksum), Escape(entry.store), Escape(entry.files), Escape(entry.url));
+	}
+	if (!stream)
+	{
+		error = std::format("cannot write {}", file.string());
+		return false;
+	}
+	return true;
+}
+
+std::vector<LockChange> MMPackageLock::Diff(const plugify::IPackageManager &packageManager, MMPackageVerifier &verifier) const
+{
+	std::map<std::string, plugify::LocalPackage, std::less<>> installed;
+	for (auto &local : packageManager.GetLocalPackages())
+	{
+		auto name = local.name;
+		installed.emplace(std::move(name), std::move(local));
+	}
+
+	std::vector<LockChange> changes;
+	for (const auto &entry : m_entries)
+	{
+		auto it = installed.find(entry.name);
+		if (it == installed.end())
+		{
+			changes.push_back({ LockAction::Install, entry, 0, {} });
+			continue;
+		}
+
+		const auto &local = it->second;
+		auto directory = local.path.parent_path();
+		if (local.version != entry.version)
+		{
+			changes.push_back({ LockAction::Update, entry, local.version, directory });
+		}
+		else if (!entry.files.empty())
+		{
+			// Compared against the files on disk, so local edits since the install count as a different build.
+			auto files = verifier.GetContentDigest(directory);
+			if (files && *files != entry.files)
+				changes.push_back({ LockAction::Reinstall, entry, local.version, directory });
+		}
+		installed.erase(it);
+	}
+
+	for (const auto &[name, local] : installed)
+	{
+		LockEntry entry;
+		entry.name = name;
+		entry.type = local.type;
+		changes.push_back({ LockAction::Remove, std::move(entry), local.version, local.path.parent_path() });
+	}
+	return changes;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace plugify
+{
+	class IPackageManager;
+}
+
+namespace plugifyMM
+{
+	class MMPackageVerifier;
+
+	struct LockEntry
+	{
+		std::string name;
+		std::string type;
+		int32_t version { 0 };
+		std::string checksum; // archive SHA-256 from the manifest, may be empty
+		std::string store;    // package store key the install came from, may be empty
+		std::string files;    // SHA-256 of the package files as they were on disk, may be empty
+		std::string url;
+	};
+
+	enum class LockAction
+	{
+		Install,   // locked, not installed
+		Update,    // installed at another version
+		Reinstall, // same version, different build
+		Remove,    // installed, not locked
+	};
+
+	struct LockChange
+	{
+		LockAction action;
+		LockEntry entry;           // locked state, only the name for removals
+		int32_t installed { 0 };   // installed version, 0 when not installed
+		std::filesystem::path path; // installed package directory
+	};
+
+	// Exact description of a set of installed packages. Unlike a package manifest it pins
+	// the download and hashes of every package, so a restore only touches what differs.
+	class MMPackageLock
+	{
+	public:
+		// Records the local packages, resolving download links and checksums from the repositories.
+		static MMPackageLock Capture(const plugify::IPackageManager &packageManager, MMPackageVerifier &verifier);
+
+		bool Load(const std::filesystem::path &file, std::string &error);
+		bool Save(const std::filesystem::path &file, std::string &error) const;
+
+		// Changes needed to turn the local packages into the locked set.
+		std::vector<LockChange> Diff(const plugify::IPackageManager &packageManager, MMPackageVerifier &verifier) const;
+
+		const std::vector<LockEntry> &GetEntries() const { return m_entries; }
+
+	private:
+		std::vector<LockEntry> m_entries;
+	};
+} // namespace plugifyMM
@@ -0,0 +1,269 @@
+#include "mm_package_store.h"
+
+#include <algorithm>
+#include <fstream>
+
+#include <plugify/compat_format.h>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+#if defined(_WIN32)
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+using namespace plugifyMM;
+
+static constexpr std::string_view kMarkerFile = ".plugify-store";
+
+std::optional<StoreLinkMode> plugifyMM::ParseStoreLinkMode(std::string_view mode)
+{
+	if (mode == "hardlink")
+		return StoreLinkMode::Hardlink;
+	if (mode == "reflink")
+		return StoreLinkMode::Reflink;
+	if (mode == "copy")
+		return StoreLinkMode::Copy;
+	return std::nullopt;
+}
+
+std::string_view plugifyMM::StoreLinkModeToString(StoreLinkMode mode)
+{
+	switch (mode)
+	{
+		case StoreLinkMode::Hardlink:
+			return "hardlink";
+		case StoreLinkMode::Reflink:
+			return "reflink";
+		case StoreLinkMode::Copy:
+			return "copy";
+	}
+	return "unknown";
+}
+
+MMPackageStore::MMPackageStore(std::filesystem::path root, StoreLinkMode mode) : m_root(std::move(root)), m_mode(mode)
+{
+}
+
+bool MMPackageStore::Contains(std::string_view key) const
+{
+	if (key.empty())
+		return false;
+
+	std::error_code ec;
+	return std::filesystem::is_directory(m_root / "objects" / key, ec);
+}
+
+bool MMPackageStore::LinkFile(const std::filesystem::path &from, const std::filesystem::path &to) const
+{
+	std::error_code ec;
+	switch (m_mode)
+	{
+		case StoreLinkMode::Hardlink:
+			std::filesystem::create_hard_link(from, to, ec);
+			if (!ec)
+				return true;
+			break; // e.g. store on another filesystem
+		case StoreLinkMode::Reflink:
+		{
+#if defined(__linux__) && defined(FICLONE)
+			int src = open(from.c_str(), O_RDONLY | O_CLOEXEC);
+			if (src >= 0)
+			{
+				int dst = open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+				bool cloned = dst >= 0 && ioctl(dst, FICLONE, src) == 0;
+				if (dst >= 0)
+					close(dst);
+				close(src);
+				if (cloned)
+					return true;
+				std::filesystem::remove(to, ec);
+			}
+#endif
+			break;
+		}
+		case StoreLinkMode::Copy:
+			break;
+	}
+
+	return std::filesystem::copy_file(from, to, std::filesystem::copy_options::overwrite_existing, ec);
+}
+
+bool MMPackageStore::LinkTree(const std::filesystem::path &from, const std::filesystem::path &to, std::string &error) const
+{
+	std::error_code ec;
+	std::filesystem::create_directories(to, ec);
+	for (auto it = std::filesystem::recursive_directory_iterator(from, ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec))
+	{
+		auto relative = it->path().lexically_relative(from);
+		if (relative == kMarkerFile)
+			continue;
+
+		auto target = to / relative;
+		if (it->is_directory(ec))
+		{
+			std::filesystem::create_directories(target, ec);
+		}
+		else if (!LinkFile(it->path(), target))
+		{
+			error = std::format("cannot link {}", target.string());
+			return false;
+		}
+	}
+
+	if (ec)
+	{
+		error = std::format("{}: {}", from.string(), ec.message());
+		return false;
+	}
+	return true;
+}
+
+bool MMPackageStore::Materialize(std::string_view key, const std::filesystem::path &target, std::string &error) const
+{
+	auto object = m_root / "objects" / key;
+	if (!Contains(key))
+	{
+		error = std::format("{} is not in the store", key);
+		return false;
+	}
+
+	std::error_code ec;
+	std::filesystem::remove_all(target, ec);
+	if (!LinkTree(object, target, error))
+	{
+		std::filesystem::remove_all(target, ec);
+		return false;
+	}
+
+	std::ofstream marker(target / kMarkerFile, std::ios::trunc);
+	marker << key << '\n';
+	return true;
+}
+
+bool MMPackageStore::Import(std::string_view key, const std::filesystem::path &source, std::string &error) const
+{
+	if (Contains(key))
+		return true;
+
+	// Build under tmp/ and publish with a single rename so other instances never see a partial entry.
+	auto temp = m_root / "tmp" / std::format("{}.{}", key, getpid());
+	std::error_code ec;
+	std::filesystem::remove_all(temp, ec);
+	if (!LinkTree(source, temp, error))
+	{
+		std::filesystem::remove_all(temp, ec);
+		return false;
+	}
+
+	std::filesystem::create_directories(m_root / "objects", ec);
+	std::filesystem::rename(temp, m_root / "objects" / key, ec);
+	if (ec)
+	{
+		std::filesystem::remove_all(temp, ec);
+		if (Contains(key))
+			return true;
+		error = std::format("cannot publish {}", key);
+		return false;
+	}
+
+	std::ofstream marker(source / kMarkerFile, std::ios::trunc);
+	marker << key << '\n';
+	return true;
+}
+
+void MMPackageStore::AddReference(std::string_view key, const std::filesystem::path &packageDir) const
+{
+	if (!Contains(key))
+		return;
+
+	// One file per package directory, named after it so reinstalls overwrite their own reference.
+	std::string path = std::filesystem::absolute(packageDir).lexically_normal().generic_string();
+	uint64_t hash = 14695981039346656037ull;
+	for (char c : path)
+	{
+		hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+	}
+
+	auto directory = m_root / "refs" / key;
+	std::error_code ec;
+	std::filesystem::create_directories(directory, ec);
+	std::ofstream reference(directory / std::format("{:016x}", hash), std::ios::trunc);
+	reference << path << '\n';
+}
+
+size_t MMPackageStore::CountReferences(std::string_view key) const
+{
+	size_t live = 0;
+	std::error_code ec;
+	for (const auto &file : std::filesystem::directory_iterator(m_root / "refs" / key, ec))
+	{
+		std::ifstream reference(file.path());
+		std::string path;
+		std::getline(reference, path);
+		reference.close();
+
+		if (!path.empty() && GetSharedKey(std::filesystem::path(path)) == key)
+		{
+			++live;
+			continue;
+		}
+		std::error_code remove;
+		std::filesystem::remove(file.path(), remove);
+	}
+	return live;
+}
+
+std::vector<StoreEntry> MMPackageStore::GetEntries() const
+{
+	std::vector<StoreEntry> entries;
+	std::error_code ec;
+	for (const auto &object : std::filesystem::directory_iterator(m_root / "objects", ec))
+	{
+		StoreEntry entry { object.path().filename().string(), 0, 0, 1, CountReferences(object.path().filename().string()) };
+		std::error_code walk;
+		for (auto it = std::filesystem::recursive_directory_iterator(object.path(), walk); !walk && it != std::filesystem::recursive_directory_iterator(); it.increment(walk))
+		{
+			std::error_code stat;
+			if (!it->is_regular_file(stat))
+				continue;
+			entry.size += it->file_size(stat);
+			entry.links = std::max<uint64_t>(entry.links, it->hard_link_count(stat));
+			++entry.files;
+		}
+		entries.push_back(std::move(entry));
+	}
+	std::sort(entries.begin(), entries.end(), [](const auto &a, const auto &b) { return a.key < b.key; });
+	return entries;
+}
+
+size_t MMPackageStore::Collect() const
+{
+	size_t removed = 0;
+	std::error_code ec;
+	for (const auto &entry : GetEntries())
+	{
+		// Entries imported before references were recorded are still kept alive by their hard links.
+		if (entry.references == 0 && entry.links <= 1)
+		{
+			removed += std::filesystem::remove_all(m_root / "objects" / entry.key, ec) > 0;
+			std::filesystem::remove_all(m_root / "refs" / entry.key, ec);
+		}
+	}
+	return removed;
+}
+
+std::optional<std::string> MMPackageStore::GetSharedKey(const std::filesystem::path &packageDir)
+{
+	std::ifstream marker(packageDir / kMarkerFile);
+	std::string key;
+	if (!marker || !std::getline(marker, key) || key.empty())
+		return std::nullopt;
+	return key;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace plugifyMM
+{
+	enum class StoreLinkMode
+	{
+		Hardlink, // shares inodes and page cache between instances
+		Reflink,  // copy-on-write clone where the filesystem supports it
+		Copy,
+	};
+
+	std::optional<StoreLinkMode> ParseStoreLinkMode(std::string_view mode);
+	std::string_view StoreLinkModeToString(StoreLinkMode mode);
+
+	struct StoreEntry
+	{
+		std::string key;
+		uint64_t size;
+		size_t files;
+		uint64_t links;    // highest hard link count of any file, 1 when no instance uses it
+		size_t references; // installed packages that were taken from this entry and still are
+	};
+
+	// Host-wide package store shared by every server instance on the machine.
+	// Extracted packages live under <root>/objects/<key>, where the key is the archive's
+	// SHA-256; installs link them into an instance's baseDir instead of downloading again.
+	// Packages whose manifest has no checksum are never shared, their content is not known.
+	class MMPackageStore
+	{
+	public:
+		MMPackageStore(std::filesystem::path root, StoreLinkMode mode);
+
+		const std::filesystem::path &GetRoot() const { return m_root; }
+		StoreLinkMode GetMode() const { return m_mode; }
+
+		bool Contains(std::string_view key) const;
+
+		// Recreates 'target' from the stored tree and tags it with the key.
+		bool Materialize(std::string_view key, const std::filesystem::path &target, std::string &error) const;
+		// Adds an extracted tree to the store; losing a race to another instance is not an error.
+		bool Import(std::string_view key, const std::filesystem::path &source, std::string &error) const;
+
+		// Records that 'packageDir' was installed from 'key', so Collect() keeps the entry.
+		void AddReference(std::string_view key, const std::filesystem::path &packageDir) const;
+
+		std::vector<StoreEntry> GetEntries() const;
+		// Removes entries no installed package refers to any more. Installed packages never
+		// depend on an entry staying around; a removed one is only downloaded again next time.
+		size_t Collect() const;
+
+		// Key a package directory was materialized from, if it came from a store.
+		static std::optional<std::string> GetSharedKey(const std::filesystem::path &packageDir);
+
+	private:
+		bool LinkTree(const std::filesystem::path &from, const std::filesystem::path &to, std::string &error) const;
+		bool LinkFile(const std::filesystem::path &from, const std::filesystem::path &to) const;
+		// Counts live references and drops the ones whose package was removed or replaced.
+		size_t CountReferences(std::string_view key) const;
+
+	private:
+		std::filesystem::path m_root;
+		StoreLinkMode m_mode;
+	};
+} // namespace plugifyMM
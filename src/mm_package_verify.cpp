@@ -0,0 +1,367 @@
+#include "mm_package_verify.h"
+#include "mm_sha256.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <unordered_set>
+
+#include <plugify/compat_format.h>
+
+using namespace plugifyMM;
+
+static constexpr std::string_view kBaselineFile = ".plugify-files";
+static constexpr std::string_view kIgnoreFile = ".plugify-verify-ignore";
+
+static bool HashFile(const std::filesystem::path &path, std::string &digest)
+{
+#if defined(_WIN32)
+	FILE *file = _wfopen(path.c_str(), L"rb");
+#else
+	FILE *file = std::fopen(path.c_str(), "rb");
+#endif
+	if (!file)
+		return false;
+
+	MMSha256 hash;
+	char buffer[64 * 1024];
+	size_t read;
+	while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+	{
+		hash.Update(buffer, read);
+	}
+	bool ok = !std::ferror(file);
+	std::fclose(file);
+
+	digest = MMSha256::ToHex(hash.Final());
+	return ok;
+}
+
+static std::map<std::string, std::string> ReadBaseline(const std::filesystem::path &directory, bool &found)
+{
+	std::map<std::string, std::string> baseline;
+	std::ifstream stream(directory / kBaselineFile);
+	found = static_cast<bool>(stream);
+
+	// "<sha256> <size> <relative path>"
+	std::string line;
+	while (std::getline(stream, line))
+	{
+		size_t first = line.find(' ');
+		size_t second = first == std::string::npos ? first : line.find(' ', first + 1);
+		if (second == std::string::npos)
+			continue;
+		baseline.emplace(line.substr(second + 1), line.substr(0, first));
+	}
+	return baseline;
+}
+
+static std::vector<std::string> ReadIgnoreList(const std::filesystem::path &directory)
+{
+	std::vector<std::string> patterns;
+	std::ifstream stream(directory / kIgnoreFile);
+	std::string line;
+	while (std::getline(stream, line))
+	{
+		line.erase(std::find(line.begin(), line.end(), '#'), line.end());
+		while (!line.empty() && std::isspace(static_cast<unsigned char>(line.back())))
+			line.pop_back();
+		if (!line.empty())
+			patterns.push_back(std::move(line));
+	}
+	return patterns;
+}
+
+// '*' matches any run of characters, including '/'.
+static bool MatchWildcard(std::string_view pattern, std::string_view text)
+{
+	size_t star = std::string_view::npos, resume = 0, p = 0, t = 0;
+	while (t < text.size())
+	{
+		if (p < pattern.size() && pattern[p] == '*')
+		{
+			star = p++;
+			resume = t;
+		}
+		else if (p < pattern.size() && pattern[p] == text[t])
+		{
+			++p;
+			++t;
+		}
+		else if (star != std::string_view::npos)
+		{
+			p = star + 1;
+			t = ++resume;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	while (p < pattern.size() && pattern[p] == '*')
+		++p;
+	return p == pattern.size();
+}
+
+static bool IsIgnored(const std::vector<std::string> &ignore, std::string_view relative)
+{
+	return std::any_of(ignore.begin(), ignore.end(), [&](const std::string &pattern) { return MatchWildcard(pattern, relative); });
+}
+
+MMPackageVerifier::MMPackageVerifier(std::filesystem::path cacheFile, size_t threads) : m_cacheFile(std::move(cacheFile)), m_threads(threads ? threads : std::max(1u, std::thread::hardware_concurrency()))
+{
+	LoadCache();
+}
+
+bool MMPackageVerifier::IsMetadataFile(const std::filesystem::path &relative)
+{
+	return relative == kBaselineFile || relative == kIgnoreFile || relative == ".plugify-store";
+}
+
+std::optional<std::string> MMPackageVerifier::GetBaselineDigest(const std::filesystem::path &directory)
+{
+	std::string digest;
+	if (!HashFile(directory / kBaselineFile, digest))
+		return std::nullopt;
+	return digest;
+}
+
+void MMPackageVerifier::LoadCache()
+{
+	if (m_cacheFile.empty())
+		return;
+
+	// "<sha256> <size> <mtime> <absolute path>"
+	std::ifstream stream(m_cacheFile);
+	std::string line;
+	while (std::getline(stream, line))
+	{
+		std::istringstream fields(line);
+		std::string digest;
+		CacheEntry entry {};
+		if (!(fields >> digest >> entry.size >> entry.mtime) || digest.size() != 64)
+			continue;
+
+		std::string path;
+		std::getline(fields >> std::ws, path);
+		entry.digest = std::move(digest);
+		m_cache.insert_or_assign(std::move(path), std::move(entry));
+	}
+}
+
+void MMPackageVerifier::SaveCache() const
+{
+	if (m_cacheFile.empty())
+		return;
+
+	std::error_code ec;
+	std::filesystem::create_directories(m_cacheFile.parent_path(), ec);
+
+	auto temp = std::filesystem::path(m_cacheFile).concat(".tmp");
+	{
+		std::ofstream stream(temp, std::ios::trunc);
+		for (const auto &[path, entry] : m_cache)
+		{
+			stream << entry.digest << ' ' << entry.size << ' ' << entry.mtime << ' ' << path << '\n';
+		}
+	}
+	std::filesystem::rename(temp, m_cacheFile, ec);
+}
+
+std::vector<MMPackageVerifier::FileState> MMPackageVerifier::Scan(const std::filesystem::path &directory, const std::vector<std::string> &ignore, size_t *ignored) const
+{
+	std::vector<FileState> files;
+	std::error_code ec;
+	for (auto it = std::filesystem::recursive_directory_iterator(directory, ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec))
+	{
+		std::error_code stat;
+		auto relative = it->path().lexically_relative(directory);
+		if (!it->is_regular_file(stat) || IsMetadataFile(relative))
+			continue;
+		if (IsIgnored(ignore, relative.generic_string()))
+		{
+			if (ignored)
+				++*ignored;
+			continue;
+		}
+
+		FileState file;
+		file.path = it->path();
+		file.size = it->file_size(stat);
+		file.mtime = static_cast<int64_t>(it->last_write_time(stat).time_since_epoch().count());
+		files.push_back(std::move(file));
+	}
+	return files;
+}
+
+void MMPackageVerifier::Hash(std::vector<FileState *> &files) const
+{
+	std::atomic<size_t> next { 0 };
+	auto worker = [&]
+	{
+		for (size_t index; (index = next.fetch_add(1, std::memory_order_relaxed)) < files.size();)
+		{
+			FileState &file = *files[index];
+			if (!HashFile(file.path, file.digest))
+				file.digest.clear();
+		}
+	};
+
+	size_t count = std::min(m_threads, files.size());
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < count; ++i)
+	{
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (auto &thread : threads)
+	{
+		thread.join();
+	}
+}
+
+std::vector<VerifyReport> MMPackageVerifier::Verify(const std::vector<std::pair<std::string, std::filesystem::path>> &packages)
+{
+	std::vector<std::vector<FileState>> scans;
+	std::vector<std::vector<std::string>> ignores;
+	std::vector<size_t> ignored(packages.size());
+	scans.reserve(packages.size());
+	std::vector<FileState *> pending;
+	for (size_t i = 0; i < packages.size(); ++i)
+	{
+		const auto &directory = packages[i].second;
+		auto &ignore = ignores.emplace_back(ReadIgnoreList(directory));
+		auto &files = scans.emplace_back(Scan(directory, ignore, &ignored[i]));
+		for (auto &file : files)
+		{
+			auto it = m_cache.find(file.path.string());
+			if (it != m_cache.end() && it->second.size == file.size && it->second.mtime == file.mtime)
+				file.digest = it->second.digest;
+			else
+				pending.push_back(&file);
+		}
+	}
+
+	// One pool over the files of every package keeps all workers busy even when most packages are cached.
+	Hash(pending);
+	for (const FileState *file : pending)
+	{
+		if (!file->digest.empty())
+			m_cache.insert_or_assign(file->path.string(), CacheEntry { file->size, file->mtime, file->digest });
+	}
+
+	std::vector<VerifyReport> reports;
+	for (size_t i = 0; i < packages.size(); ++i)
+	{
+		const auto &[name, directory] = packages[i];
+		auto &files = scans[i];
+
+		VerifyReport &report = reports.emplace_back();
+		report.package = name;
+		report.files = files.size();
+		report.ignored = ignored[i];
+		report.hashed = static_cast<size_t>(std::count_if(pending.begin(), pending.end(), [&](const FileState *file) { return file >= files.data() && file < files.data() + files.size(); }));
+
+		bool found;
+		auto baseline = ReadBaseline(directory, found);
+		if (!found)
+		{
+			report.baselineCreated = WriteBaseline(directory);
+			if (!report.baselineCreated)
+				report.error = "cannot record file list";
+			continue;
+		}
+
+		for (const auto &file : files)
+		{
+			auto relative = file.path.lexically_relative(directory).generic_string();
+			auto it = baseline.find(relative);
+			if (it == baseline.end())
+			{
+				report.extra.push_back(std::move(relative));
+				continue;
+			}
+			if (file.digest != it->second)
+				report.modified.push_back(relative);
+			baseline.erase(it);
+		}
+		for (auto &[relative, digest] : baseline)
+		{
+			if (!IsIgnored(ignores[i], relative))
+				report.missing.push_back(relative);
+		}
+	}
+
+	// Forget files that disappeared from the verified packages so the cache does not grow forever.
+	std::unordered_set<std::string> seen;
+	std::vector<std::string> prefixes;
+	for (size_t i = 0; i < packages.size(); ++i)
+	{
+		prefixes.push_back((packages[i].second / "").string());
+		for (const auto &file : scans[i])
+			seen.insert(file.path.string());
+	}
+	std::erase_if(m_cache, [&](const auto &item)
+	{
+		const auto &path = item.first;
+		bool verified = std::any_of(prefixes.begin(), prefixes.end(), [&](const std::string &prefix) { return path.starts_with(prefix); });
+		return verified && !seen.contains(path);
+	});
+
+	SaveCache();
+	return reports;
+}
+
+std::optional<std::string> MMPackageVerifier::ListFiles(const std::filesystem::path &directory)
+{
+	auto files = Scan(directory, ReadIgnoreList(directory));
+	std::vector<FileState *> pending;
+	for (auto &file : files)
+	{
+		auto it = m_cache.find(file.path.string());
+		if (it != m_cache.end() && it->second.size == file.size && it->second.mtime == file.mtime)
+			file.digest = it->second.digest;
+		else
+			pending.push_back(&file);
+	}
+	Hash(pending);
+
+	// Sorted so identical trees produce identical lists, lockfiles hash them.
+	std::sort(files.begin(), files.end(), [](const FileState &a, const FileState &b) { return a.path < b.path; });
+
+	std::string list;
+	for (const auto &file : files)
+	{
+		if (file.digest.empty())
+			return std::nullopt;
+		list += std::format("{} {} {}\n", file.digest, file.size, file.path.lexically_relative(directory).generic_string());
+	}
+	return list;
+}
+
+bool MMPackageVerifier::WriteBaseline(const std::filesystem::path &directory)
+{
+	auto list = ListFiles(directory);
+	if (!list)
+		return false;
+
+	std::ofstream stream(directory / kBaselineFile, std::ios::binary | std::ios::trunc);
+	stream << *list;
+	return static_cast<bool>(stream);
+}
+
+std::optional<std::string> MMPackageVerifier::GetContentDigest(const std::filesystem::path &directory)
+{
+	auto list = ListFiles(directory);
+	if (!list)
+		return std::nullopt;
+
+	MMSha256 hash;
+	hash.Update(list->data(), list->size());
+	return MMSha256::ToHex(hash.Final());
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "mm_utils.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace plugifyMM
+{
+	struct VerifyReport
+	{
+		std::string package;
+		size_t files { 0 };
+		size_t hashed { 0 }; // files whose digest was not in the cache
+		bool baselineCreated { false };
+		size_t ignored { 0 };
+		std::vector<std::string> modified;
+		std::vector<std::string> missing;
+		std::vector<std::string> extra; // not part of the install, e.g. configs or logs a plugin wrote
+		std::string error;
+	};
+
+	// Checks package directories against the file list recorded at install time
+	// (<package>/.plugify-files). Digests are cached by path, size and mtime in 'cacheFile',
+	// so a repeated run only hashes files that changed. Hashing is spread over 'threads' workers.
+	// Paths matching a pattern in <package>/.plugify-verify-ignore ('*' wildcards, one per line)
+	// are skipped, for files the package itself rewrites.
+	class MMPackageVerifier
+	{
+	public:
+		MMPackageVerifier(std::filesystem::path cacheFile, size_t threads);
+
+		// Packages without a recorded file list get one from their current contents.
+		std::vector<VerifyReport> Verify(const std::vector<std::pair<std::string, std::filesystem::path>> &packages);
+
+		// Records the current contents of 'directory' as its baseline, sorted by path.
+		bool WriteBaseline(const std::filesystem::path &directory);
+
+		// SHA-256 of the recorded file list, identifies the exact build that was installed.
+		static std::optional<std::string> GetBaselineDigest(const std::filesystem::path &directory);
+		// The same digest computed from the files on disk now; equals the baseline digest until a file changes.
+		std::optional<std::string> GetContentDigest(const std::filesystem::path &directory);
+
+		static bool IsMetadataFile(const std::filesystem::path &relative);
+
+	private:
+		struct CacheEntry
+		{
+			uint64_t size;
+			int64_t mtime;
+			std::string digest;
+		};
+
+		struct FileState
+		{
+			std::filesystem::path path;
+			uint64_t size;
+			int64_t mtime;
+			std::string digest;
+		};
+
+		void LoadCache();
+		void SaveCache() const;
+		std::vector<FileState> Scan(const std::filesystem::path &directory, const std::vector<std::string> &ignore, size_t *ignored = nullptr) const;
+		void Hash(std::vector<FileState *> &files) const;
+		// Current contents in the file list format, sorted by path; empty when a file cannot be read.
+		std::optional<std::string> ListFiles(const std::filesystem::path &directory);
+
+	private:
+		std::filesystem::path m_cacheFile;
+		size_t m_threads;
+		std::unordered_map<std::string, CacheEntry, StringHash, std::equal_to<>> m_cache;
+	};
+} // namespace plugifyMM
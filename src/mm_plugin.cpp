@@ -13,9 +13,15 @@
  */
 
 #include "mm_plugin.h"
+#include "mm_json.h"
+#include "mm_package_installer.h"
+#include "mm_package_lock.h"
+#include "mm_package_verify.h"
+#include "mm_preloader.h"
 
 #include <igameevents.h>
 #include <iserver.h>
+#include <tier0/icommandline.h>
 
 #include <plugify/compat_format.h>
 #include <plugify/plugify.h>
@@ -30,6 +36,7 @@
 
 #include <filesystem>
 #include <chrono>
+#include <exception>
 #include <type_traits>
 
 std::string FormatTime(std::string_view format = "%Y-%m-%d %H:%M:%S")
@@ -45,6 +52,8 @@ void RegisterTags(LoggingChannelID_t channelID)
 {
 }
 
+SH_DECL_HOOK3_void(IServerGameDLL, GameFrame, SH_NOATTRIB, 0, bool, bool, bool);
+
 namespace plugifyMM
 {
 	IServerGameDLL *server = NULL;
@@ -146,470 +155,2146 @@ namespace plugifyMM
 		}
 	}
 
-	ptrdiff_t FormatInt(const std::string &str)
+	template <typename S, typename T, typename F> requires (std::is_function_v<F>)
+	void WriteJson(MMJsonWriter &json, const T &t, F &f, bool details = false)
 	{
-		try
+		auto descriptor = t.GetDescriptor();
+		json.Key("id").Int(t.GetId());
+		json.Key("name").String(t.GetName());
+		json.Key("friendlyName").String(t.GetFriendlyName());
+		json.Key("state").String(f(t.GetState()));
+		if (t.GetState() == S::Error)
 		{
-			size_t pos;
-			ptrdiff_t result = std::stoul(str, &pos);
-			if (pos != str.length())
+			json.Key("error").String(t.GetError());
+		}
+		json.Key("version").Int(descriptor.GetVersion());
+		json.Key("versionName").String(descriptor.GetVersionName());
+		json.Key("createdBy").String(descriptor.GetCreatedBy());
+		if (details)
+		{
+			json.Key("description").String(descriptor.GetDescription());
+			json.Key("createdByURL").String(descriptor.GetCreatedByURL());
+			json.Key("docsURL").String(descriptor.GetDocsURL());
+			json.Key("downloadURL").String(descriptor.GetDownloadURL());
+			json.Key("updateURL").String(descriptor.GetUpdateURL());
+		}
+	}
+
+	void WriteJson(MMJsonWriter &json, const plugify::RemotePackage &package)
+	{
+		json.BeginObject();
+		json.Key("name").String(package.name);
+		json.Key("type").String(package.type);
+		json.Key("author").String(package.author);
+		json.Key("description").String(package.description);
+		json.Key("versions").BeginArray();
+		for (const auto &version : package.versions)
+		{
+			json.BeginObject();
+			json.Key("version").Int(version.version);
+			json.Key("checksum").String(version.checksum);
+			json.Key("download").String(version.download);
+			json.Key("platforms").BeginArray();
+			for (const auto &platform : version.platforms)
 			{
-				throw std::invalid_argument("Trailing characters after the valid part");
+				json.String(platform);
 			}
-			return result;
+			json.EndArray();
+			json.EndObject();
 		}
-		catch (const std::invalid_argument &e)
+		json.EndArray();
+		json.EndObject();
+	}
+
+	void WriteJson(MMJsonWriter &json, const plugify::LocalPackage &package)
+	{
+		auto key = MMPackageStore::GetSharedKey(package.path.parent_path());
+		json.BeginObject();
+		json.Key("name").String(package.name);
+		json.Key("type").String(package.type);
+		json.Key("version").Int(package.version);
+		json.Key("path").String(package.path.string());
+		json.Key("shared").Bool(key.has_value());
+		if (key)
 		{
-			CONPRINT(std::format("Invalid argument: {}\n", e.what()).c_str());
+			json.Key("sharedKey").String(*key);
 		}
-		catch (const std::out_of_range &e)
+		json.EndObject();
+	}
+
+	// Replies of commands run with --json are always a JSON document, errors included.
+	void PrintCommandError(bool json, std::string_view message)
+	{
+		if (!json)
 		{
-			CONPRINT(std::format("Out of range: {}\n", e.what()).c_str());
+			CONPRINT(std::string(message).c_str());
+			return;
 		}
-		catch (const std::exception &e)
+		while (!message.empty() && (message.back() == '\n' || message.back() == '.'))
 		{
-			CONPRINT(std::format("Conversion error: {}\n", e.what()).c_str());
+			message.remove_suffix(1);
 		}
+		MMJsonWriter writer(message.size() + 16);
+		writer.BeginObject().Key("error").String(message).EndObject();
+		CONPRINT(writer.Release().c_str());
+	}
 
-		return ptrdiff_t(-1);
+	void RecordPluginManager(MMFlightRecorder &recorder, const plugify::IPluginManager &pluginManager)
+	{
+		for (const auto &module : pluginManager.GetModules())
+		{
+			recorder.Record(FlightEvent::Lifecycle, std::format("module {} is {}", module.GetName(), plugify::ModuleUtils::ToString(module.GetState())));
+		}
+		for (const auto &plugin : pluginManager.GetPlugins())
+		{
+			recorder.Record(FlightEvent::Lifecycle, std::format("plugin {} is {}", plugin.GetName(), plugify::PluginUtils::ToString(plugin.GetState())));
+		}
 	}
 
-	CON_COMMAND_F(plugify, "Plugify control options", FCVAR_NONE)
+	// Loads modules and plugins as one profiled phase, charging its time to each of them.
+	// With preload, package files are read into the page cache in parallel first; the core
+	// itself still loads everything on this thread.
+	void InitializePluginManager(plugify::IPluginManager &pluginManager)
 	{
-		std::vector<std::string> arguments;
-		std::unordered_set<std::string> options;
-		std::span view(args.ArgV(), args.ArgC());
-		arguments.reserve(view.size());
-		for (size_t i = 0; i < view.size(); i++)
+		auto &profiler = g_Plugin.m_profiler;
+		auto mode = static_cast<PreloadMode>(std::clamp<int64_t>(g_Plugin.m_settings.GetInt("preload"), 0, 1));
+		MMPackagePreloader preloader(mode, static_cast<size_t>(g_Plugin.m_settings.GetInt("preload_threads")));
+		if (mode != PreloadMode::Off)
 		{
-			std::string str(view[i]);
-			if (i > 1 && str.starts_with("-"))
+			MMProfileScope phase(profiler, "preload");
+			std::vector<PreloadPackage> packages;
+			if (auto packageManager = g_Plugin.m_context->GetPackageManager().lock())
 			{
-				options.emplace(std::move(str));
+				for (const auto &package : packageManager->GetLocalPackages())
+				{
+					packages.push_back({ package.name, package.path.parent_path() });
+				}
 			}
-			else
+			auto report = preloader.Run(packages);
+			MM_LOG(g_Plugin.m_logger, Debug, "Preloaded {} packages ({} files, {:.1f} MB) in {:.1f} ms, {:.1f} ms of work", report.packages, report.files, report.bytes / (1024.0 * 1024.0), report.elapsed.count(), report.serial.count());
+			for (const auto &timing : report.slowest)
 			{
-				arguments.emplace_back(std::move(str));
+				MM_LOG(g_Plugin.m_logger, Verbose, "  preload {}: {:.1f} ms", timing.name, timing.elapsed.count());
 			}
 		}
 
-		auto &plugify = g_Plugin.m_context;
-		if (!plugify)
-			return; // Should not trigger!
-
-		auto packageManager = plugify->GetPackageManager().lock();
-		auto pluginManager = plugify->GetPluginManager().lock();
-		if (!packageManager || !pluginManager)
-			return; // Should not trigger!
+		size_t span;
+		{
+			MMProfileScope phase(profiler, "plugin manager initialize");
+			span = phase.GetSpan();
+			pluginManager.Initialize();
+		}
 
-		if (arguments.size() > 1)
+		std::vector<ProfileItem> items;
+		for (const auto &module : pluginManager.GetModules())
 		{
-			if (arguments[1] == "help" || arguments[1] == "-h")
-			{
-				CONPRINT("Plugify Menu\n"
-				         "(c) untrustedmodders\n"
-				         "https://github.com/untrustedmodders\n"
-				         "usage: plugify <command> [options] [arguments]\n"
-				         "  help           - Show help\n"
-				         "  version        - Version information\n"
-				         "Plugin Manager commands:\n"
-				         "  load           - Load plugin manager\n"
-				         "  unload         - Unload plugin manager\n"
-				         "  modules        - List running modules\n"
-				         "  plugins        - List running plugins\n"
-				         "  plugin <name>  - Show information about a module\n"
-				         "  module <name>  - Show information about a plugin\n"
-				         "Plugin Manager options:\n"
-				         "  -h, --help     - Show help\n"
-				         "  -u, --uuid     - Use index instead of name\n"
-				         "Package Manager commands:\n"
-				         "  install <name> - Packages to install (space separated)\n"
-				         "  remove <name>  - Packages to remove (space separated)\n"
-				         "  update <name>  - Packages to update (space separated)\n"
-				         "  list           - Print all local packages\n"
-				         "  query          - Print all remote packages\n"
-				         "  show  <name>   - Show information about local package\n"
-				         "  search <name>  - Search information about remote package\n"
-				         "  snapshot       - Snapshot packages into manifest\n"
-				         "  repo <url>     - Add repository to config\n"
-				         "Package Manager options:\n"
-				         "  -h, --help     - Show help\n"
-				         "  -a, --all      - Install/remove/update all packages\n"
-				         "  -f, --file     - Packages to install (from file manifest)\n"
-				         "  -l, --link     - Packages to install (from HTTP manifest)\n"
-				         "  -m, --missing  - Install missing packages\n"
-				         "  -c, --conflict - Remove conflict packages\n"
-				         "  -i, --ignore   - Ignore missing or conflict packages\n");
-			}
+			items.push_back({ module.GetName(), "module" });
+		}
+		for (const auto &plugin : pluginManager.GetPlugins())
+		{
+			items.push_back({ plugin.GetName(), "plugin" });
+		}
+		profiler.Attribute(span, items);
+		RecordPluginManager(g_Plugin.m_recorder, pluginManager);
+	}
 
-			else if (arguments[1] == "version" || arguments[1] == "-v")
-			{
-				CONPRINT(R"(      ____)" "\n"
-				         R"( ____|    \         Plugify v)" PLUGIFY_PROJECT_VERSION "\n"
-				         R"((____|     `._____  )" "Copyright (C) 2023-" PLUGIFY_PROJECT_YEAR " Untrusted Modders Team\n"
-				         R"( ____|       _|___)" "\n"
-				         R"((____|     .'       This program may be freely redistributed under)" "\n"
-				         R"(     |____/         the terms of the GNU General Public License.)" "\n");
-			}
+	// Snapshot served by the metrics exporter, rebuilt on the game thread about once a second.
+	std::string BuildMetrics()
+	{
+		std::string out;
+		out.reserve(16 * 1024);
 
-			else if (arguments[1] == "load")
+		if (auto pluginManager = g_Plugin.m_context ? g_Plugin.m_context->GetPluginManager().lock() : nullptr)
+		{
+			bool initialized = pluginManager->IsInitialized();
+			std::format_to(std::back_inserter(out), "# HELP plugify_plugin_manager_loaded Whether the plugin manager is loaded.\n# TYPE plugify_plugin_manager_loaded gauge\nplugify_plugin_manager_loaded {}\n", initialized ? 1 : 0);
+			if (initialized)
 			{
-				if (!options.contains("--ignore") && !options.contains("-i"))
-				{
-					if (packageManager->HasMissedPackages())
-					{
-						CONPRINT("Plugin manager has missing packages, run 'install --missing' to resolve issues.\n");
-						return;
-					}
-					if (packageManager->HasConflictedPackages())
-					{
-						CONPRINT("Plugin manager has conflicted packages, run 'remove --conflict' to resolve issues.\n");
-						return;
-					}
-				}
-				if (pluginManager->IsInitialized())
+				out += "# HELP plugify_module_state Current state of each language module.\n# TYPE plugify_module_state gauge\n";
+				for (const auto &module : pluginManager->GetModules())
 				{
-					CONPRINT("Plugin manager already loaded.\n");
+					out += "plugify_module_state{name=\"";
+					AppendMetricLabel(out, module.GetName());
+					std::format_to(std::back_inserter(out), "\",state=\"{}\"}} 1\n", plugify::ModuleUtils::ToString(module.GetState()));
 				}
-				else
+				out += "# HELP plugify_plugin_state Current state of each plugin.\n# TYPE plugify_plugin_state gauge\n";
+				for (const auto &plugin : pluginManager->GetPlugins())
 				{
-					pluginManager->Initialize();
-					CONPRINT("Plugin manager was loaded.\n");
+					out += "plugify_plugin_state{name=\"";
+					AppendMetricLabel(out, plugin.GetName());
+					std::format_to(std::back_inserter(out), "\",state=\"{}\"}} 1\n", plugify::PluginUtils::ToString(plugin.GetState()));
 				}
 			}
+		}
 
-			else if (arguments[1] == "unload")
+		if (g_Plugin.m_logger)
+		{
+			auto stats = g_Plugin.m_logger->GetStats();
+			std::format_to(std::back_inserter(out), "# HELP plugify_log_lines_total Log lines written.\n# TYPE plugify_log_lines_total counter\nplugify_log_lines_total {}\n", stats.written);
+			std::format_to(std::back_inserter(out), "# HELP plugify_log_dropped_total Log lines dropped by a full queue.\n# TYPE plugify_log_dropped_total counter\nplugify_log_dropped_total {}\n", stats.dropped);
+			std::format_to(std::back_inserter(out), "# HELP plugify_log_queue_lines Log lines waiting to be written.\n# TYPE plugify_log_queue_lines gauge\nplugify_log_queue_lines {}\n", stats.pending);
+		}
+
+		// Labelled by command ("install", "update", ...) rather than job id or arguments, so series stay bounded.
+		std::map<std::pair<std::string_view, std::string_view>, size_t> jobCounts;
+		std::map<std::string_view, double> jobSeconds;
+		auto jobs = g_Plugin.m_jobs.GetJobs();
+		for (const auto &job : jobs)
+		{
+			std::string_view kind = job.name;
+			if (kind.starts_with("plugify "))
+				kind.remove_prefix(8);
+			kind = kind.substr(0, kind.find(' '));
+			++jobCounts[{ kind, JobStateToString(job.state) }];
+			if (job.state != JobState::Queued)
+				jobSeconds[kind] = job.elapsed.count();
+		}
+		out += "# HELP plugify_package_jobs Recent package operations by command and state.\n# TYPE plugify_package_jobs gauge\n";
+		for (const auto &[key, count] : jobCounts)
+		{
+			out += "plugify_package_jobs{kind=\"";
+			AppendMetricLabel(out, key.first);
+			std::format_to(std::back_inserter(out), "\",state=\"{}\"}} {}\n", key.second, count);
+		}
+		out += "# HELP plugify_package_job_seconds Duration of the latest package operation of each command.\n# TYPE plugify_package_job_seconds gauge\n";
+		for (const auto &[kind, seconds] : jobSeconds)
+		{
+			out += "plugify_package_job_seconds{kind=\"";
+			AppendMetricLabel(out, kind);
+			std::format_to(std::back_inserter(out), "\"}} {}\n", seconds);
+		}
+
+		g_Plugin.m_profiler.FormatMetrics(out);
+		g_Plugin.m_frames.FormatMetrics(out);
+		g_Plugin.m_memory.FormatMetrics(out);
+		return out;
+	}
+
+	void StartMetrics(std::string_view address)
+	{
+		std::string error;
+		if (g_Plugin.m_metrics.Start(address, error))
+		{
+			g_Plugin.m_metrics.Publish(BuildMetrics());
+			MM_LOG(g_Plugin.m_logger, Info, "Serving metrics on {}", address);
+		}
+		else
+		{
+			MM_LOG(g_Plugin.m_logger, Error, "Metrics exporter: {}", error);
+		}
+	}
+
+	void PrintMemory(std::string &out, std::string_view name)
+	{
+		if (auto usage = g_Plugin.m_memory.Find(name))
+		{
+			std::format_to(std::back_inserter(out), "  Memory: native {} ({} allocations), runtime heap {}\n", MMMemoryTracker::FormatBytes(usage->native), usage->allocations, MMMemoryTracker::FormatBytes(static_cast<int64_t>(usage->runtime)));
+		}
+	}
+
+	void WriteMemory(MMJsonWriter &json, std::string_view name)
+	{
+		if (auto usage = g_Plugin.m_memory.Find(name))
+		{
+			json.Key("memory").BeginObject();
+			json.Key("native").Int(usage->native);
+			json.Key("allocations").Uint(usage->allocations);
+			json.Key("runtime").Uint(usage->runtime);
+			json.EndObject();
+		}
+	}
+
+	// Code plugify loaded, for attributing profiler samples. Plugin libraries live in the plugin directory.
+	std::vector<ProfileImage> GetProfileImages(const plugify::IPluginManager &pluginManager)
+	{
+		std::vector<ProfileImage> images;
+		for (const auto &module : pluginManager.GetModules())
+		{
+			images.push_back({ module.GetFilePath(), std::format("module:{}", module.GetName()) });
+		}
+		for (const auto &plugin : pluginManager.GetPlugins())
+		{
+			images.push_back({ plugin.GetBaseDir(), std::format("plugin:{}", plugin.GetName()) });
+		}
+		for (const auto &module : pluginManager.GetModules())
+		{
+			images.push_back({ module.GetBaseDir(), std::format("module:{}", module.GetName()) });
+		}
+		return images;
+	}
+
+	// Console output of a job step; the console is only written from the main thread.
+	void PrintFromJob(std::string message, bool warning = false)
+	{
+		g_Plugin.m_jobs.Post([message = std::move(message), warning]
+		{
+			if (warning)
 			{
-				if (!pluginManager->IsInitialized())
-				{
-					CONPRINT("Plugin manager already unloaded.\n");
-				}
-				else
-				{
-					pluginManager->Terminate();
-					CONPRINT("Plugin manager was unloaded.\n");
-				}
+				CONPRINTE(message.c_str());
+			}
+			else
+			{
+				CONPRINT(message.c_str());
 			}
+		});
+	}
 
-			else if (arguments[1] == "plugins")
+	void SubmitPackageJob(const std::string &name, std::vector<MMJobQueue::Step> steps)
+	{
+		uint64_t id = g_Plugin.m_jobs.Submit(name, std::move(steps), [](const JobInfo &job)
+		{
+			g_Plugin.m_dependencies.Invalidate();
+			g_Plugin.m_packageIndex.Invalidate();
+			g_Plugin.m_recorder.Record(FlightEvent::Package, std::format("job #{} {}: {}", job.id, JobStateToString(job.state), job.name));
+			if (job.error.empty())
 			{
-				if (!pluginManager->IsInitialized())
-				{
-					CONPRINT("You must load plugin manager before query any information from it.\n");
-					return;
-				}
+				CONPRINT(std::format("Job #{} {} in {:.1f}s: {}\n", job.id, JobStateToString(job.state), job.elapsed.count(), job.name).c_str());
+			}
+			else
+			{
+				CONPRINTE(std::format("Job #{} {} in {:.1f}s: {} - {}\n", job.id, JobStateToString(job.state), job.elapsed.count(), job.name, job.error).c_str());
+			}
+		});
+		g_Plugin.m_recorder.Record(FlightEvent::Package, std::format("job #{} queued: {}", id, name));
+		CONPRINT(std::format("Job #{} queued: {}\n", id, name).c_str());
+	}
 
-				auto count = pluginManager->GetPlugins().size();
-				std::string sMessage = count ? std::format("Listing {} plugin{}:\n", static_cast<int>(count), (count > 1) ? "s" : "") : std::string("No plugins loaded.\n");
+	// The core decides whether loading is blocked; the dependency graph only explains why.
+	bool CheckDependencies(const plugify::IPackageManager &packageManager)
+	{
+		bool missing = packageManager.HasMissedPackages();
+		bool conflicted = packageManager.HasConflictedPackages();
+		if (!missing && !conflicted)
+			return true;
 
-				for (auto &plugin : pluginManager->GetPlugins())
-				{
-					Print<plugify::PluginState>(sMessage, plugin, plugify::PluginUtils::ToString);
-				}
+		auto &graph = g_Plugin.m_dependencies;
+		graph.Sync(packageManager, true);
 
-				CONPRINT(sMessage.c_str());
+		std::string sMessage;
+		if (missing)
+		{
+			sMessage += "Plugin manager has missing packages, run 'install --missing' to resolve issues.\n";
+			for (const auto &[key, reasons] : graph.GetMissing())
+				for (const auto &reason : reasons)
+					std::format_to(std::back_inserter(sMessage), "  {}\n", reason);
+		}
+		if (conflicted)
+		{
+			sMessage += "Plugin manager has conflicted packages, run 'remove --conflict' to resolve issues.\n";
+			for (const auto &[key, reasons] : graph.GetConflicts())
+				for (const auto &reason : reasons)
+					std::format_to(std::back_inserter(sMessage), "  {}\n", reason);
+		}
+		CONPRINT(sMessage.c_str());
+		return false;
+	}
+
+	void ApplyHttpSettings(MMHttpClient &http, const MMSettings &settings)
+	{
+		HttpOptions httpOptions;
+		httpOptions.parallelism = static_cast<size_t>(settings.GetInt("download_parallel"));
+		httpOptions.hostConnections = static_cast<size_t>(settings.GetInt("download_host_connections"));
+		httpOptions.retries = static_cast<int>(settings.GetInt("download_retries"));
+		httpOptions.backoff = std::chrono::milliseconds(settings.GetInt("download_backoff_ms"));
+		httpOptions.timeout = std::chrono::seconds(settings.GetInt("download_timeout_s"));
+		http.SetOptions(httpOptions);
+	}
+
+	// Refreshes the manifest cache and registers the cached copies as file:// repositories.
+	void AddCachedRepositories(plugify::IPlugify &plugify, MMManifestCache &manifests, const MMSettings &settings, MMLogger &logger, bool force)
+	{
+		if (!MMHttpClient::IsSupported())
+		{
+			for (const auto &url : manifests.GetRepositories())
+			{
+				plugify.AddRepository(url);
 			}
+			return;
+		}
 
-			else if (arguments[1] == "modules")
+		auto ttl = std::chrono::seconds(settings.GetInt("manifest_ttl_s"));
+		bool offline = settings.GetInt("offline") != 0;
+		for (const auto &status : manifests.Refresh(ttl, offline, force, MMJobQueue::CancelToken()))
+		{
+			if (status.source == ManifestSource::Missing)
 			{
-				if (!pluginManager->IsInitialized())
+				MM_LOG(&logger, Warning, "Repository {} unavailable: {}", status.url, status.error);
+				continue;
+			}
+			if (status.source == ManifestSource::Stale)
+			{
+				MM_LOG(&logger, Warning, "Repository {} unreachable ({}), using cached copy from {}s ago", status.url, status.error, status.age.count());
+			}
+			else
+			{
+				MM_LOG(&logger, Debug, "Repository {}: {}", status.url, ManifestSourceToString(status.source));
+			}
+			plugify.AddRepository(MMManifestCache::ToFileUrl(status.file));
+		}
+	}
+
+	// Returns the configured package store, or null when 'store_dir' is unset.
+	// The store is kept on the plugin and only rebuilt after 'store_dir' or 'store_link' change.
+	std::shared_ptr<MMPackageStore> GetPackageStore(const MMSettings &settings)
+	{
+		auto root = settings.GetString("store_dir");
+		auto link = settings.GetString("store_link");
+		auto &store = g_Plugin.m_store;
+		if (root.empty())
+		{
+			store.reset();
+			return nullptr;
+		}
+		if (store && store->GetRoot() == std::filesystem::path(root) && g_Plugin.m_storeLink == link)
+			return store;
+
+		auto mode = ParseStoreLinkMode(link);
+		if (!mode)
+		{
+			CONPRINTE(std::format("Unknown store_link '{}', using reflink.\n", link).c_str());
+		}
+		store = std::make_shared<MMPackageStore>(std::filesystem::path(root), mode.value_or(StoreLinkMode::Reflink));
+		g_Plugin.m_storeLink = link;
+		return store;
+	}
+
+	// 'beforeCommit' runs once every package is downloaded, verified and staged, right before they
+	// are swapped in, e.g. the removals of a lockfile restore. A failed or cancelled download
+	// changes nothing; from the first removal on, the job runs to the end and always reloads.
+	void SubmitParallelPackageJob(const std::string &name, std::shared_ptr<plugify::IPackageManager> packageManager, std::vector<PackageDownload> downloads, std::vector<MMJobQueue::Step> beforeCommit = {})
+	{
+		ApplyHttpSettings(g_Plugin.m_http, g_Plugin.m_settings);
+
+		auto installer = std::make_shared<MMPackageInstaller>(g_Plugin.m_http, g_Plugin.m_context->GetConfig().baseDir);
+		installer->SetStore(GetPackageStore(g_Plugin.m_settings));
+		auto shared = std::make_shared<std::vector<PackageDownload>>(std::move(downloads));
+
+		std::vector<MMJobQueue::Step> steps;
+		if (g_Plugin.m_settings.GetInt("download_streaming"))
+		{
+			steps.emplace_back([installer, shared] { installer->DownloadAndExtract(*shared, MMJobQueue::CancelToken()); }, true);
+		}
+		else
+		{
+			steps.emplace_back([installer, shared] { installer->Download(*shared, MMJobQueue::CancelToken()); }, true);
+			for (size_t i = 0; i < shared->size(); ++i)
+			{
+				steps.emplace_back([installer, shared, i] { installer->Unpack((*shared)[i]); });
+			}
+		}
+		// One step, so neither a cancel nor a failed commit can stop the job between removals,
+		// commits and the reload, leaving the core out of step with the files on disk.
+		steps.emplace_back([installer, shared, packageManager, beforeCommit = std::move(beforeCommit)]
+		{
+			std::exception_ptr failure;
+			try
+			{
+				for (const auto &step : beforeCommit)
 				{
-					CONPRINT("You must load plugin manager before query any information from it.\n");
-					return;
+					step.run();
 				}
-				auto count = pluginManager->GetModules().size();
-				std::string sMessage = count ? std::format("Listing {} module{}:\n", static_cast<int>(count), (count > 1) ? "s" : "") : std::string("No modules loaded.\n");
-				for (auto &module : pluginManager->GetModules())
+				for (const auto &download : *shared)
 				{
-					Print<plugify::ModuleState>(sMessage, module, plugify::ModuleUtils::ToString);
+					installer->Commit(download);
+					std::error_code ec;
+					std::filesystem::remove(download.archive, ec);
 				}
-
-				CONPRINT(sMessage.c_str());
 			}
-
-			else if (arguments[1] == "plugin")
+			catch (...)
 			{
-				if (arguments.size() > 2)
-				{
-					if (!pluginManager->IsInitialized())
-					{
-						CONPRINT("You must load plugin manager before query any information from it.\n");
+				failure = std::current_exception();
+			}
+			packageManager->Reload();
+			if (failure)
+			{
+				std::rethrow_exception(failure);
+			}
+		});
+		SubmitPackageJob(name, std::move(steps));
+	}
+
+	// Downloads and verifies updates while plugins keep running, leaving the installed
+	// packages untouched until ApplyStagedUpdates().
+	void SubmitStagedPackageJob(const std::string &name, std::vector<PackageDownload> downloads)
+	{
+		ApplyHttpSettings(g_Plugin.m_http, g_Plugin.m_settings);
+
+		auto installer = std::make_shared<MMPackageInstaller>(g_Plugin.m_http, g_Plugin.m_context->GetConfig().baseDir);
+		installer->SetStore(GetPackageStore(g_Plugin.m_settings));
+		auto shared = std::make_shared<std::vector<PackageDownload>>(std::move(downloads));
+
+		std::vector<MMJobQueue::Step> steps;
+		if (g_Plugin.m_settings.GetInt("download_streaming"))
+		{
+			steps.emplace_back([installer, shared] { installer->DownloadAndExtract(*shared, MMJobQueue::CancelToken()); }, true);
+		}
+		else
+		{
+			steps.emplace_back([installer, shared] { installer->Download(*shared, MMJobQueue::CancelToken()); }, true);
+			for (size_t i = 0; i < shared->size(); ++i)
+			{
+				steps.emplace_back([installer, shared, i] { installer->Unpack((*shared)[i]); });
+			}
+		}
+		for (size_t i = 0; i < shared->size(); ++i)
+		{
+			steps.emplace_back([shared, i]
+			{
+				const auto &download = (*shared)[i];
+				g_Plugin.m_staged->Stage(download);
+				std::error_code ec;
+				std::filesystem::remove(download.archive, ec);
+			});
+		}
+		SubmitPackageJob(name, std::move(steps));
+	}
+
+	// Checks the installed packages with the staged manifests swapped in, so an update that would
+	// leave missing or conflicted packages is rejected before anything is touched.
+	bool CheckStagedUpdates(const plugify::IPackageManager &packageManager)
+	{
+		auto packages = packageManager.GetLocalPackages();
+		std::string error;
+		if (!g_Plugin.m_staged->Preview(packages, error))
+		{
+			MM_LOG(g_Plugin.m_logger, Error, "Staged updates were not applied: {}", error);
+			return false;
+		}
+
+		MMDependencyGraph preview;
+		preview.Sync(packages);
+		if (preview.HasMissing() || preview.HasConflicts())
+		{
+			MM_LOG(g_Plugin.m_logger, Error, "Staged updates were not applied, they would leave the plugin manager with unresolved dependencies:");
+			for (const auto *issues : { &preview.GetMissing(), &preview.GetConflicts() })
+				for (const auto &[key, reasons] : *issues)
+					for (const auto &reason : reasons)
+						MM_LOG(g_Plugin.m_logger, Error, "  {}", reason);
+			g_Plugin.m_recorder.Record(FlightEvent::Package, "staged updates rejected by dependency check");
+			return false;
+		}
+		return true;
+	}
+
+	// Swaps the staged trees in and reloads the package manager; plugins must not be loaded.
+	size_t CommitStagedUpdates(plugify::IPackageManager &packageManager)
+	{
+		MMPackageInstaller installer(g_Plugin.m_http, g_Plugin.m_context->GetConfig().baseDir);
+		installer.SetStore(GetPackageStore(g_Plugin.m_settings));
+		std::vector<std::string> errors;
+		size_t applied = g_Plugin.m_staged->Apply(installer, errors);
+		for (const auto &error : errors)
+		{
+			MM_LOG(g_Plugin.m_logger, Error, "Staged update failed: {}", error);
+		}
+		packageManager.Reload();
+		g_Plugin.m_dependencies.Invalidate();
+		g_Plugin.m_packageIndex.Invalidate();
+		g_Plugin.m_recorder.Record(FlightEvent::Package, std::format("{} staged updates applied", applied));
+		return applied;
+	}
+
+	// Swaps staged updates into place. The core cannot reload single packages, so a running
+	// plugin manager is restarted around the swap; updates that would leave it with missing or
+	// conflicted packages are not applied and nothing is torn down.
+	void ApplyStagedUpdates()
+	{
+		auto &staged = g_Plugin.m_staged;
+		if (!staged || !staged->HasPending())
+			return;
+		if (g_Plugin.m_jobs.IsBusy())
+		{
+			MM_LOG(g_Plugin.m_logger, Debug, "Package jobs are running, staged updates wait for the next map change");
+			return;
+		}
+		auto packageManager = g_Plugin.m_context->GetPackageManager().lock();
+		auto pluginManager = g_Plugin.m_context->GetPluginManager().lock();
+		if (!packageManager || !pluginManager || !CheckStagedUpdates(*packageManager))
+			return;
+
+		auto start = std::chrono::steady_clock::now();
+		bool running = pluginManager->IsInitialized();
+		if (running)
+		{
+			g_Plugin.m_recorder.Record(FlightEvent::Lifecycle, "plugin manager restarting for staged updates");
+			pluginManager->Terminate();
+		}
+
+		size_t applied = CommitStagedUpdates(*packageManager);
+
+		if (running && CheckDependencies(*packageManager))
+		{
+			g_Plugin.m_profiler.Start();
+			InitializePluginManager(*pluginManager);
+			g_Plugin.m_profiler.Stop();
+		}
+		std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+		MM_LOG(g_Plugin.m_logger, Info, "Applied {} staged update{} in {:.1f} ms", applied, applied == 1 ? "" : "s", elapsed.count());
+	}
+
+	ptrdiff_t FormatInt(const std::string &str)
+	{
+		try
+		{
+			size_t pos;
+			ptrdiff_t result = std::stoul(str, &pos);
+			if (pos != str.length())
+			{
+				throw std::invalid_argument("Trailing characters after the valid part");
+			}
+			return result;
+		}
+		catch (const std::invalid_argument &e)
+		{
+			CONPRINT(std::format("Invalid argument: {}\n", e.what()).c_str());
+		}
+		catch (const std::out_of_range &e)
+		{
+			CONPRINT(std::format("Out of range: {}\n", e.what()).c_str());
+		}
+		catch (const std::exception &e)
+		{
+			CONPRINT(std::format("Conversion error: {}\n", e.what()).c_str());
+		}
+
+		return ptrdiff_t(-1);
+	}
+
+	// Search index over the remote packages, rebuilt after package jobs reloaded the manifests.
+	const MMPackageIndex &GetPackageIndex(const plugify::IPackageManager &packageManager)
+	{
+		auto &index = g_Plugin.m_packageIndex;
+		if (index.IsStale())
+		{
+			index.Build(packageManager.GetRemotePackages());
+		}
+		return index;
+	}
+
+	struct SearchArguments
+	{
+		std::string query;
+		std::string type;
+		size_t page { 1 };
+	};
+
+	// Splits "type:<prefix>" and "page:<n>" filters from the search terms.
+	SearchArguments ParseSearchArguments(std::span<const std::string> arguments)
+	{
+		SearchArguments search;
+		for (const auto &argument : arguments)
+		{
+			if (argument.starts_with("type:"))
+			{
+				search.type = argument.substr(5);
+			}
+			else if (argument.starts_with("page:"))
+			{
+				ptrdiff_t page = FormatInt(argument.substr(5));
+				search.page = page > 0 ? static_cast<size_t>(page) : 1;
+			}
+			else
+			{
+				if (!search.query.empty())
+					search.query += ' ';
+				search.query += argument;
+			}
+		}
+		return search;
+	}
+
+	void PrintSearchResult(const MMPackageIndex &index, const PackageSearchResult &result, size_t page, size_t pageSize, std::string_view header, bool json)
+	{
+		if (json)
+		{
+			MMJsonWriter writer(256 + result.hits.size() * 512);
+			writer.BeginObject();
+			writer.Key("total").Uint(result.total);
+			writer.Key("page").Uint(page);
+			writer.Key("pageSize").Uint(pageSize);
+			writer.Key("packages").BeginArray();
+			for (const auto &hit : result.hits)
+			{
+				WriteJson(writer, index.GetPackages()[hit.index]);
+			}
+			writer.EndArray();
+			writer.EndObject();
+			CONPRINT(writer.Release().c_str());
+			return;
+		}
+
+		std::string sMessage;
+		if (result.total == 0)
+		{
+			sMessage = "No remote packages found.\n";
+		}
+		else
+		{
+			size_t pages = (result.total + pageSize - 1) / pageSize;
+			std::format_to(std::back_inserter(sMessage), "{} {} remote package{} (page {}/{}):\n", header, result.total, (result.total > 1) ? "s" : "", page, pages);
+		}
+		for (const auto &hit : result.hits)
+		{
+			const auto &remotePackage = index.GetPackages()[hit.index];
+			if (remotePackage.author.empty() || remotePackage.description.empty())
+			{
+				std::format_to(std::back_inserter(sMessage), "  {} [{}]\n", remotePackage.name, remotePackage.type);
+			}
+			else
+			{
+				std::format_to(std::back_inserter(sMessage), "  {} [{}] ({}) by {}\n", remotePackage.name, remotePackage.type, remotePackage.description, remotePackage.author);
+			}
+		}
+		CONPRINT(sMessage.c_str());
+	}
+
+	CON_COMMAND_F(plugify, "Plugify control options", FCVAR_NONE)
+	{
+		std::vector<std::string> arguments;
+		std::unordered_set<std::string> options;
+		std::span view(args.ArgV(), args.ArgC());
+		arguments.reserve(view.size());
+		for (size_t i = 0; i < view.size(); i++)
+		{
+			std::string str(view[i]);
+			if (i > 1 && str.starts_with("-"))
+			{
+				options.emplace(std::move(str));
+			}
+			else
+			{
+				arguments.emplace_back(std::move(str));
+			}
+		}
+
+		std::string sCommand;
+		for (const auto &argument : view)
+		{
+			if (!sCommand.empty())
+				sCommand += ' ';
+			sCommand += argument;
+		}
+		g_Plugin.m_recorder.Record(FlightEvent::Command, sCommand);
+		g_Plugin.m_jobs.Poll();
+
+		auto &plugify = g_Plugin.m_context;
+		if (!plugify)
+			return; // Should not trigger!
+
+		auto packageManager = plugify->GetPackageManager().lock();
+		auto pluginManager = plugify->GetPluginManager().lock();
+		if (!packageManager || !pluginManager)
+			return; // Should not trigger!
+
+		bool json = options.contains("--json") || options.contains("-j");
+
+		if (arguments.size() > 1)
+		{
+			if (arguments[1] == "help" || arguments[1] == "-h")
+			{
+				CONPRINT("Plugify Menu\n"
+				         "(c) untrustedmodders\n"
+				         "https://github.com/untrustedmodders\n"
+				         "usage: plugify <command> [options] [arguments]\n"
+				         "  help           - Show help\n"
+				         "  version        - Version information\n"
+				         "Plugin Manager commands:\n"
+				         "  load           - Load plugin manager\n"
+				         "  unload         - Unload plugin manager\n"
+				         "  modules        - List running modules\n"
+				         "  plugins        - List running plugins\n"
+				         "  plugin <name>  - Show information about a module\n"
+				         "  module <name>  - Show information about a plugin\n"
+				         "Plugin Manager options:\n"
+				         "  -h, --help     - Show help\n"
+				         "  -u, --uuid     - Use index instead of name\n"
+				         "  -j, --json     - Print plugins, modules, plugin and module as JSON\n"
+				         "Package Manager commands:\n"
+				         "  install <name> - Packages to install (space separated)\n"
+				         "  remove <name>  - Packages to remove (space separated)\n"
+				         "  update <name>  - Packages to update (space separated)\n"
+				         "  staged [apply|discard] - Show, apply now or drop updates staged with update -s\n"
+				         "  list           - Print all local packages\n"
+				         "  query          - Print remote packages (type:<type> page:<n>)\n"
+				         "  show  <name>   - Show information about local package\n"
+				         "  search <name>  - Show a remote package, or fuzzy search name, author and description\n"
+				         "                   (type:<type> page:<n>)\n"
+				         "  deps [name]    - Explain missing and conflicted dependencies\n"
+				         "  snapshot       - Snapshot packages into manifest and lockfile\n"
+				         "  restore <file> - Apply only the differences to a lockfile (-n for dry run)\n"
+				         "  repo <url>     - Add repository to config\n"
+				         "  repo list      - Show cached repository manifests\n"
+				         "  repo refresh   - Revalidate all repository manifests\n"
+				         "  jobs           - List queued, running and recent package jobs\n"
+				         "  job cancel <id> - Cancel a package job\n"
+				         "  set [name] [value] - Show or change settings (download_parallel, ...)\n"
+				         "  store [gc]     - Show the shared package store or drop unused entries\n"
+				         "  verify <name>  - Check package files against the installed file list (-a for all)\n"
+				         "Package Manager options:\n"
+				         "  -h, --help     - Show help\n"
+				         "  -a, --all      - Install/remove/update all packages\n"
+				         "  -f, --file     - Packages to install (from file manifest)\n"
+				         "  -l, --link     - Packages to install (from HTTP manifest)\n"
+				         "  -m, --missing  - Install missing packages\n"
+				         "  -c, --conflict - Remove conflict packages\n"
+				         "  -i, --ignore   - Ignore missing or conflict packages\n"
+				         "  -p, --parallel - Install/update with concurrent downloads\n"
+				         "  -s, --stage    - Update while running, swapping packages in at map change\n"
+				         "  -n, --dry-run  - Print the restore plan without applying it\n"
+				         "  -j, --json     - Print list, query, show and search as JSON\n"
+				         "Logger commands:\n"
+				         "  log stats      - Show logger queue statistics\n"
+				         "  log async <on|off> [policy] [size] - Toggle background logging\n"
+				         "                   (policy: drop-oldest, drop-newest, block)\n"
+				         "  log level [source] [severity|default] - Show or override per-source severity\n"
+				         "                   (sources are 'plugify' and plugins logging through Plugify_Log)\n"
+				         "  log rate <lines/s> [burst] - Rate limit each source (0 disables)\n"
+				         "  log collapse <on|off> - Collapse repeated identical lines\n"
+				         "  log binary <on|off|stats> [severity] [size MB] [files] - Binary log files in <baseDir>/logs\n"
+				         "Profiler commands:\n"
+				         "  perf [reset]   - Show or reset GameFrame time and time reported by language SDKs (p50/p99/max)\n"
+				         "  mem [reset]    - Show process memory and what language SDKs report per plugin and module, or reset allocation counts\n"
+				         "  metrics [start <address>|stop] - Prometheus exporter on unix:<path> or a loopback port\n"
+				         "  profile startup [top] - Show startup phases and estimated times of the slowest modules and plugins\n"
+				         "  profile startup export [file] - Write the startup timeline as Chrome trace JSON\n"
+				         "  profile start [hz] - Sample the game thread (99 Hz by default)\n"
+				         "  profile stop [file] - Stop sampling, show the busiest modules and plugins and write folded stacks\n"
+				         "Flight recorder commands:\n"
+				         "  recorder [count] - Print the most recent records\n"
+				         "  recorder dump  - Write all records to <baseDir>/logs\n"
+				         "  recorder level <severity> - Most verbose log line to record\n");
+			}
+
+			else if (arguments[1] == "version" || arguments[1] == "-v")
+			{
+				CONPRINT(R"(      ____)" "\n"
+				         R"( ____|    \         Plugify v)" PLUGIFY_PROJECT_VERSION "\n"
+				         R"((____|     `._____  )" "Copyright (C) 2023-" PLUGIFY_PROJECT_YEAR " Untrusted Modders Team\n"
+				         R"( ____|       _|___)" "\n"
+				         R"((____|     .'       This program may be freely redistributed under)" "\n"
+				         R"(     |____/         the terms of the GNU General Public License.)" "\n");
+			}
+
+			else if (arguments[1] == "log")
+			{
+				auto &logger = g_Plugin.m_logger;
+				if (arguments.size() > 2 && arguments[2] == "async")
+				{
+					if (arguments.size() > 3 && arguments[3] == "on")
+					{
+						LogOverflowPolicy policy = LogOverflowPolicy::DropNewest;
+						if (arguments.size() > 4)
+						{
+							if (arguments[4] == "drop-oldest")
+							{
+								policy = LogOverflowPolicy::DropOldest;
+							}
+							else if (arguments[4] == "drop-newest")
+							{
+								policy = LogOverflowPolicy::DropNewest;
+							}
+							else if (arguments[4] == "block")
+							{
+								policy = LogOverflowPolicy::Block;
+							}
+							else
+							{
+								CONPRINT(std::format("Unknown overflow policy: {}\n", arguments[4]).c_str());
+								return;
+							}
+						}
+						ptrdiff_t capacity = arguments.size() > 5 ? FormatInt(arguments[5]) : 8192;
+						if (capacity <= 0)
+						{
+							return;
+						}
+						logger->EnableAsync(static_cast<size_t>(capacity), policy);
+						CONPRINT("Asynchronous logging enabled.\n");
+					}
+					else if (arguments.size() > 3 && arguments[3] == "off")
+					{
+						logger->DisableAsync();
+						CONPRINT("Asynchronous logging disabled.\n");
+					}
+					else
+					{
+						CONPRINT("usage: plugify log async <on|off> [drop-oldest|drop-newest|block] [size]\n");
+					}
+				}
+				else if (arguments.size() > 2 && arguments[2] == "stats")
+				{
+					auto stats = logger->GetStats();
+					CONPRINT(std::format("Logger is {}.\n"
+					                     "  Written: {}\n"
+					                     "  Dropped: {}\n"
+					                     "  Pending: {}/{}\n", logger->IsAsync() ? "asynchronous" : "synchronous", stats.written, stats.dropped, stats.pending, stats.capacity).c_str());
+				}
+				else if (arguments.size() > 2 && arguments[2] == "level")
+				{
+					auto &filter = logger->GetFilter();
+					if (arguments.size() > 4)
+					{
+						if (arguments[4] == "default")
+						{
+							filter.SetSourceSeverity(arguments[3], std::nullopt);
+							CONPRINT(std::format("Log severity override for {} removed.\n", arguments[3]).c_str());
+						}
+						else if (auto severity = ParseSeverity(arguments[4]))
+						{
+							auto sources = filter.GetSources();
+							bool logged = arguments[3] == kLogCoreSource || std::any_of(sources.begin(), sources.end(), [&](const LogSourceInfo &source) { return source.name == arguments[3] && source.passed + source.limited + source.collapsed != 0; });
+							filter.SetSourceSeverity(arguments[3], severity);
+							std::string sMessage = std::format("Log severity for {} set to {}.\n", arguments[3], arguments[4]);
+							if (!logged)
+							{
+								// The core reports every line as its own, only Plugify_Log carries a plugin name.
+								std::format_to(std::back_inserter(sMessage), "{} has not logged through Plugify_Log yet; core lines about it are filtered as '{}'.\n", arguments[3], kLogCoreSource);
+							}
+							CONPRINT(sMessage.c_str());
+						}
+						else
+						{
+							CONPRINT(std::format("Unknown severity: {}\n", arguments[4]).c_str());
+						}
+					}
+					else
+					{
+						std::string sMessage = std::format("Rate limit: {}\n", filter.GetRate() > 0.0 ? std::format("{} lines/s (burst {})", filter.GetRate(), filter.GetBurst()) : std::string("off"));
+						std::format_to(std::back_inserter(sMessage), "Collapse repeated: {}\n", filter.GetCollapse() ? "on" : "off");
+						for (const auto &source : filter.GetSources())
+						{
+							if (arguments.size() > 3 && source.name != arguments[3])
+								continue;
+							std::format_to(std::back_inserter(sMessage), "  {} [{}] passed: {}, limited: {}, collapsed: {}\n", source.name, source.severity ? SeverityToString(*source.severity) : "default", source.passed, source.limited, source.collapsed);
+						}
+						CONPRINT(sMessage.c_str());
+					}
+				}
+				else if (arguments.size() > 2 && arguments[2] == "rate")
+				{
+					if (arguments.size() > 3)
+					{
+						ptrdiff_t rate = FormatInt(arguments[3]);
+						ptrdiff_t burst = arguments.size() > 4 ? FormatInt(arguments[4]) : rate;
+						if (rate < 0 || burst < 0)
+						{
+							return;
+						}
+						logger->GetFilter().SetRateLimit(static_cast<double>(rate), static_cast<double>(burst));
+						CONPRINT(rate ? std::format("Log rate limited to {} lines/s per source.\n", rate).c_str() : "Log rate limit disabled.\n");
+					}
+					else
+					{
+						CONPRINT("usage: plugify log rate <lines/s> [burst]\n");
+					}
+				}
+				else if (arguments.size() > 2 && arguments[2] == "collapse")
+				{
+					if (arguments.size() > 3 && (arguments[3] == "on" || arguments[3] == "off"))
+					{
+						logger->GetFilter().SetCollapse(arguments[3] == "on");
+						CONPRINT(std::format("Collapsing of repeated lines turned {}.\n", arguments[3]).c_str());
+					}
+					else
+					{
+						CONPRINT("usage: plugify log collapse <on|off>\n");
+					}
+				}
+				else if (arguments.size() > 2 && arguments[2] == "binary")
+				{
+					auto &sink = logger->GetBinarySink();
+					if (arguments.size() > 3 && arguments[3] == "on")
+					{
+						auto severity = arguments.size() > 4 ? ParseSeverity(arguments[4]) : plugify::Severity::Verbose;
+						if (!severity)
+						{
+							CONPRINT(std::format("Unknown severity: {}\n", arguments[4]).c_str());
+							return;
+						}
+						ptrdiff_t size = arguments.size() > 5 ? FormatInt(arguments[5]) : 64;
+						ptrdiff_t files = arguments.size() > 6 ? FormatInt(arguments[6]) : 8;
+						if (size <= 0 || files <= 0)
+						{
+							return;
+						}
+						auto directory = plugify->GetConfig().baseDir / "logs";
+						if (sink.Open(directory, *severity, static_cast<size_t>(size) << 20, static_cast<size_t>(files)))
+						{
+							CONPRINT(std::format("Binary logging to {}.\n", sink.GetStats().path.string()).c_str());
+						}
+						else
+						{
+							CONPRINT(std::format("Failed to open binary log in {}.\n", directory.string()).c_str());
+						}
+					}
+					else if (arguments.size() > 3 && arguments[3] == "off")
+					{
+						sink.Close();
+						CONPRINT("Binary logging disabled.\n");
+					}
+					else if (arguments.size() > 3 && arguments[3] == "stats")
+					{
+						if (!sink.IsOpen())
+						{
+							CONPRINT("Binary logging is disabled.\n");
+							return;
+						}
+						auto stats = sink.GetStats();
+						CONPRINT(std::format("Binary log: {}\n"
+						                     "  Records: {}\n"
+						                     "  Bytes: {}\n"
+						                     "  Rotations: {}\n", stats.path.string(), stats.records, stats.bytes, stats.rotations).c_str());
+					}
+					else
+					{
+						CONPRINT("usage: plugify log binary <on|off|stats> [severity] [size MB] [files]\n");
+					}
+				}
+				else
+				{
+					CONPRINT("usage: plugify log <async|stats|level|rate|collapse|binary> [arguments]\n");
+				}
+			}
+
+			else if (arguments[1] == "recorder")
+			{
+				auto &recorder = g_Plugin.m_recorder;
+				if (arguments.size() > 2 && arguments[2] == "dump")
+				{
+					auto file = plugify->GetConfig().baseDir / "logs" / std::format("flight_{}.txt", FormatTime("%Y_%m_%d_%H_%M_%S"));
+					if (recorder.Dump(file))
+					{
+						CONPRINT(std::format("Flight recorder written to {}.\n", file.string()).c_str());
+					}
+					else
+					{
+						CONPRINT(std::format("Failed to write flight recorder to {}.\n", file.string()).c_str());
+					}
+				}
+				else if (arguments.size() > 2 && arguments[2] == "level")
+				{
+					auto severity = arguments.size() > 3 ? ParseSeverity(arguments[3]) : std::nullopt;
+					if (severity)
+					{
+						recorder.SetSeverity(*severity);
+						CONPRINT(std::format("Flight recorder level set to {}.\n", arguments[3]).c_str());
+					}
+					else
+					{
+						CONPRINT("usage: plugify recorder level <severity>\n");
+					}
+				}
+				else
+				{
+					ptrdiff_t count = arguments.size() > 2 ? FormatInt(arguments[2]) : 20;
+					if (count <= 0)
+					{
+						return;
+					}
+					CONPRINT(recorder.Tail(static_cast<size_t>(count)).c_str());
+				}
+			}
+
+			else if (arguments[1] == "load")
+			{
+				if (g_Plugin.m_jobs.IsBusy())
+				{
+					CONPRINT("Package manager is busy, see 'plugify jobs'.\n");
+					return;
+				}
+				if (!options.contains("--ignore") && !options.contains("-i") && !CheckDependencies(*packageManager))
+				{
+					return;
+				}
+				if (pluginManager->IsInitialized())
+				{
+					CONPRINT("Plugin manager already loaded.\n");
+				}
+				else
+				{
+					g_Plugin.m_recorder.Record(FlightEvent::Lifecycle, "plugin manager loading");
+					g_Plugin.m_profiler.Start();
+					InitializePluginManager(*pluginManager);
+					g_Plugin.m_profiler.Stop();
+					CONPRINT("Plugin manager was loaded.\n");
+				}
+			}
+
+			else if (arguments[1] == "unload")
+			{
+				if (!pluginManager->IsInitialized())
+				{
+					CONPRINT("Plugin manager already unloaded.\n");
+				}
+				else
+				{
+					g_Plugin.m_recorder.Record(FlightEvent::Lifecycle, "plugin manager unloading");
+					pluginManager->Terminate();
+					g_Plugin.m_recorder.Record(FlightEvent::Lifecycle, "plugin manager unloaded");
+					CONPRINT("Plugin manager was unloaded.\n");
+				}
+			}
+
+			else if (arguments[1] == "plugins")
+			{
+				if (!pluginManager->IsInitialized())
+				{
+					PrintCommandError(json, "You must load plugin manager before query any information from it.\n");
+					return;
+				}
+
+				if (json)
+				{
+					const auto &plugins = pluginManager->GetPlugins();
+					MMJsonWriter writer(256 + plugins.size() * 256);
+					writer.BeginObject();
+					writer.Key("paused").Bool(g_Plugin.m_paused);
+					writer.Key("plugins").BeginArray();
+					for (auto &plugin : plugins)
+					{
+						writer.BeginObject();
+						WriteJson<plugify::PluginState>(writer, plugin, plugify::PluginUtils::ToString);
+						writer.EndObject();
+					}
+					writer.EndArray();
+					writer.EndObject();
+					CONPRINT(writer.Release().c_str());
+					return;
+				}
+
+				auto count = pluginManager->GetPlugins().size();
+				std::string sMessage = count ? std::format("Listing {} plugin{}:\n", static_cast<int>(count), (count > 1) ? "s" : "") : std::string("No plugins loaded.\n");
+
+				for (auto &plugin : pluginManager->GetPlugins())
+				{
+					Print<plugify::PluginState>(sMessage, plugin, plugify::PluginUtils::ToString);
+				}
+				if (g_Plugin.m_paused)
+				{
+					sMessage += "All plugins are paused.\n";
+				}
+
+				CONPRINT(sMessage.c_str());
+			}
+
+			else if (arguments[1] == "metrics")
+			{
+				if (arguments.size() > 3 && arguments[2] == "start")
+				{
+					StartMetrics(arguments[3]);
+				}
+				else if (arguments.size() > 2 && arguments[2] == "stop")
+				{
+					g_Plugin.m_metrics.Stop();
+					CONPRINT("Metrics exporter was stopped.\n");
+				}
+				else if (g_Plugin.m_metrics.IsRunning())
+				{
+					CONPRINT(std::format("Serving metrics on {} ({} scrapes).\n", g_Plugin.m_metrics.GetAddress(), g_Plugin.m_metrics.GetScrapes()).c_str());
+				}
+				else
+				{
+					CONPRINT("Metrics exporter is not running, see 'plugify metrics start <address>'.\n");
+				}
+			}
+
+			else if (arguments[1] == "mem")
+			{
+				if (arguments.size() > 2 && arguments[2] == "reset")
+				{
+					g_Plugin.m_memory.Reset();
+					CONPRINT("Allocation counts were reset.\n");
+					return;
+				}
+				CONPRINT(g_Plugin.m_memory.Format().c_str());
+			}
+
+			else if (arguments[1] == "perf")
+			{
+				if (arguments.size() > 2 && arguments[2] == "reset")
+				{
+					g_Plugin.m_frames.Reset();
+					CONPRINT("Frame time statistics were reset.\n");
+					return;
+				}
+				CONPRINT(g_Plugin.m_frames.Format().c_str());
+			}
+
+			else if (arguments[1] == "modules")
+			{
+				if (!pluginManager->IsInitialized())
+				{
+					PrintCommandError(json, "You must load plugin manager before query any information from it.\n");
+					return;
+				}
+				if (json)
+				{
+					const auto &modules = pluginManager->GetModules();
+					MMJsonWriter writer(256 + modules.size() * 256);
+					writer.BeginObject();
+					writer.Key("modules").BeginArray();
+					for (auto &module : modules)
+					{
+						writer.BeginObject();
+						WriteJson<plugify::ModuleState>(writer, module, plugify::ModuleUtils::ToString);
+						writer.Key("language").String(module.GetLanguage());
+						writer.EndObject();
+					}
+					writer.EndArray();
+					writer.EndObject();
+					CONPRINT(writer.Release().c_str());
+					return;
+				}
+				auto count = pluginManager->GetModules().size();
+				std::string sMessage = count ? std::format("Listing {} module{}:\n", static_cast<int>(count), (count > 1) ? "s" : "") : std::string("No modules loaded.\n");
+				for (auto &module : pluginManager->GetModules())
+				{
+					Print<plugify::ModuleState>(sMessage, module, plugify::ModuleUtils::ToString);
+				}
+
+				CONPRINT(sMessage.c_str());
+			}
+
+			else if (arguments[1] == "plugin")
+			{
+				if (arguments.size() > 2)
+				{
+					if (!pluginManager->IsInitialized())
+					{
+						PrintCommandError(json, "You must load plugin manager before query any information from it.\n");
+						return;
+					}
+					auto plugin = options.contains("--uuid") || options.contains("-u") ? pluginManager->FindPluginFromId(FormatInt(arguments[2])) : pluginManager->FindPlugin(arguments[2]);
+					if (plugin.has_value() && json)
+					{
+						auto descriptor = plugin->GetDescriptor();
+						MMJsonWriter writer;
+						writer.BeginObject();
+						WriteJson<plugify::PluginState>(writer, *plugin, plugify::PluginUtils::ToString, true);
+						writer.Key("languageModule").String(descriptor.GetLanguageModule());
+						writer.Key("dependencies").BeginArray();
+						for (const auto &reference : descriptor.GetDependencies())
+						{
+							auto dependency = pluginManager->FindPlugin(reference.GetName());
+							writer.BeginObject();
+							writer.Key("name").String(reference.GetName());
+							writer.Key("optional").Bool(reference.IsOptional());
+							writer.Key("requestedVersion");
+							if (auto version = reference.GetRequestedVersion())
+							{
+								writer.Int(*version);
+							}
+							else
+							{
+								writer.Null();
+							}
+							writer.Key("state").String(dependency.has_value() ? plugify::PluginUtils::ToString(dependency->GetState()) : "Missing");
+							writer.EndObject();
+						}
+						writer.EndArray();
+						WriteMemory(writer, plugin->GetName());
+						writer.Key("file").String(descriptor.GetEntryPoint());
+						writer.EndObject();
+						CONPRINT(writer.Release().c_str());
+					}
+					else if (plugin.has_value())
+					{
+						std::string sMessage;
+						Print<plugify::PluginState>(sMessage, "Plugin", *plugin, plugify::PluginUtils::ToString);
+						auto descriptor = plugin->GetDescriptor();
+						std::format_to(std::back_inserter(sMessage), "  Language module: {}\n", descriptor.GetLanguageModule());
+						sMessage += "  Dependencies: \n";
+						for (const auto &reference : descriptor.GetDependencies())
+						{
+							auto dependency = pluginManager->FindPlugin(reference.GetName());
+							if (dependency.has_value())
+							{
+								Print<plugify::PluginState>(sMessage, *dependency, plugify::PluginUtils::ToString, "    ");
+							}
+							else
+							{
+								std::format_to(std::back_inserter(sMessage), "    {} <Missing> (v{})", reference.GetName(), reference.GetRequestedVersion().has_value() ? std::to_string(*reference.GetRequestedVersion()) : "[latest]");
+							}
+						}
+						PrintMemory(sMessage, plugin->GetName());
+						std::format_to(std::back_inserter(sMessage), "  File: {}\n\n", descriptor.GetEntryPoint());
+
+						CONPRINT(sMessage.c_str());
+					}
+					else
+					{
+						PrintCommandError(json, std::format("Plugin {} not found.\n", arguments[2]));
+					}
+				}
+				else
+				{
+					PrintCommandError(json, "You must provide name.\n");
+				}
+			}
+
+			else if (arguments[1] == "module")
+			{
+				if (arguments.size() > 2)
+				{
+					if (!pluginManager->IsInitialized())
+					{
+						PrintCommandError(json, "You must load plugin manager before query any information from it.\n");
+						return;
+					}
+					auto module = options.contains("--uuid") || options.contains("-u") ? pluginManager->FindModuleFromId(FormatInt(arguments[2])) : pluginManager->FindModule(arguments[2]);
+					if (module.has_value() && json)
+					{
+						MMJsonWriter writer;
+						writer.BeginObject();
+						WriteJson<plugify::ModuleState>(writer, *module, plugify::ModuleUtils::ToString, true);
+						writer.Key("language").String(module->GetLanguage());
+						WriteMemory(writer, module->GetName());
+						writer.Key("file").String(std::filesystem::path(module->GetFilePath()).string());
+						writer.EndObject();
+						CONPRINT(writer.Release().c_str());
+					}
+					else if (module.has_value())
+					{
+						std::string sMessage;
+
+						Print<plugify::ModuleState>(sMessage, "Module", *module, plugify::ModuleUtils::ToString);
+						std::format_to(std::back_inserter(sMessage), "  Language: {}\n", module->GetLanguage());
+						PrintMemory(sMessage, module->GetName());
+						std::format_to(std::back_inserter(sMessage), "  File: {}\n\n", std::filesystem::path(module->GetFilePath()).string());
+
+						CONPRINT(sMessage.c_str());
+					}
+					else
+					{
+						PrintCommandError(json, std::format("Module {} not found.\n", arguments[2]));
+					}
+				}
+				else
+				{
+					PrintCommandError(json, "You must provide name.\n");
+				}
+			}
+
+			else if (arguments[1] == "deps")
+			{
+				if (g_Plugin.m_jobs.IsBusy())
+				{
+					CONPRINT("Package manager is busy, see 'plugify jobs'.\n");
+					return;
+				}
+
+				auto &graph = g_Plugin.m_dependencies;
+				size_t changed = graph.Sync(*packageManager, true);
+				if (arguments.size() > 2)
+				{
+					auto sMessage = graph.Explain(arguments[2]);
+					CONPRINT(sMessage.empty() ? std::format("Package {} is not installed.\n", arguments[2]).c_str() : sMessage.c_str());
+					return;
+				}
+
+				std::string sMessage = std::format("{} package{}, {} changed since last check.\n", graph.GetPackageCount(), (graph.GetPackageCount() == 1) ? "" : "s", changed);
+				for (const auto &[title, issues] : { std::pair{ "Missing", &graph.GetMissing() }, std::pair{ "Conflicts", &graph.GetConflicts() } })
+				{
+					for (const auto &[key, reasons] : *issues)
+					{
+						std::format_to(std::back_inserter(sMessage), "  {} {}:\n", title, MMDependencyGraph::DescribeKey(key));
+						for (const auto &reason : reasons)
+							std::format_to(std::back_inserter(sMessage), "    {}\n", reason);
+					}
+				}
+				if (!graph.HasMissing() && !graph.HasConflicts())
+				{
+					sMessage += "No missing or conflicted packages.\n";
+				}
+				CONPRINT(sMessage.c_str());
+			}
+
+			else if (arguments[1] == "profile")
+			{
+				if (arguments.size() > 2 && arguments[2] == "startup")
+				{
+					if (arguments.size() > 3 && arguments[3] == "export")
+					{
+						auto file = arguments.size() > 4 ? std::filesystem::path(arguments[4]) : plugify->GetConfig().baseDir / "logs" / std::format("startup_{}.json", FormatTime("%Y_%m_%d_%H_%M_%S"));
+						std::string error;
+						if (g_Plugin.m_profiler.WriteChromeTrace(file, error))
+						{
+							CONPRINT(std::format("Startup trace written to {} (open in chrome://tracing or ui.perfetto.dev)\n", file.string()).c_str());
+						}
+						else
+						{
+							CONPRINTE(std::format("{}\n", error).c_str());
+						}
 						return;
 					}
-					auto plugin = options.contains("--uuid") || options.contains("-u") ? pluginManager->FindPluginFromId(FormatInt(arguments[2])) : pluginManager->FindPlugin(arguments[2]);
-					if (plugin.has_value())
+
+					ptrdiff_t top = arguments.size() > 3 ? FormatInt(arguments[3]) : 10;
+					if (top <= 0)
 					{
-						std::string sMessage;
-						Print<plugify::PluginState>(sMessage, "Plugin", *plugin, plugify::PluginUtils::ToString);
-						auto descriptor = plugin->GetDescriptor();
-						std::format_to(std::back_inserter(sMessage), "  Language module: {}\n", descriptor.GetLanguageModule());
-						sMessage += "  Dependencies: \n";
-						for (const auto &reference : descriptor.GetDependencies())
+						return;
+					}
+					CONPRINT(g_Plugin.m_profiler.Format(static_cast<size_t>(top)).c_str());
+				}
+				else if (arguments.size() > 2 && arguments[2] == "start")
+				{
+					ptrdiff_t frequency = arguments.size() > 3 ? FormatInt(arguments[3]) : 99;
+					if (frequency <= 0)
+					{
+						return;
+					}
+					std::string error;
+					if (g_Plugin.m_sampler.Start(static_cast<int>(frequency), error))
+					{
+						CONPRINT(std::format("Sampling the game thread at {} Hz, see 'plugify profile stop'.\n", frequency).c_str());
+					}
+					else
+					{
+						CONPRINTE(std::format("{}\n", error).c_str());
+					}
+				}
+				else if (arguments.size() > 2 && arguments[2] == "stop")
+				{
+					if (!g_Plugin.m_sampler.IsRunning())
+					{
+						CONPRINT("Profiler is not running.\n");
+						return;
+					}
+					g_Plugin.m_sampler.Stop();
+
+					auto images = pluginManager->IsInitialized() ? GetProfileImages(*pluginManager) : std::vector<ProfileImage>{};
+					auto file = arguments.size() > 3 ? std::filesystem::path(arguments[3]) : plugify->GetConfig().baseDir / "logs" / std::format("profile_{}.folded", FormatTime("%Y_%m_%d_%H_%M_%S"));
+					std::string sMessage = g_Plugin.m_sampler.Format(images, 10);
+					std::string error;
+					if (g_Plugin.m_sampler.WriteFolded(file, images, error))
+					{
+						std::format_to(std::back_inserter(sMessage), "Folded stacks written to {} (flamegraph.pl or speedscope.app)\n", file.string());
+					}
+					else
+					{
+						std::format_to(std::back_inserter(sMessage), "{}\n", error);
+					}
+					CONPRINT(sMessage.c_str());
+				}
+				else
+				{
+					CONPRINT("usage: plugify profile startup [top] | startup export [file] | start [hz] | stop [file]\n");
+				}
+			}
+
+			else if (arguments[1] == "snapshot")
+			{
+				if (pluginManager->IsInitialized())
+				{
+					CONPRINT("You must unload plugin manager before bring any change with package manager.\n");
+					return;
+				}
+				auto stem = std::format("snapshot_{}", FormatTime("%Y_%m_%d_%H_%M_%S"));
+				auto file = plugify->GetConfig().baseDir / std::format("{}.wpackagemanifest", stem);
+				auto lockFile = plugify->GetConfig().baseDir / std::format("{}.plock", stem);
+				auto cacheFile = plugify->GetConfig().baseDir / ".cache" / "verify.cache";
+				auto threads = static_cast<size_t>(g_Plugin.m_settings.GetInt("verify_threads"));
+				SubmitPackageJob(sCommand, {
+					[packageManager, file] { packageManager->SnapshotPackages(file, true); },
+					[packageManager, lockFile, cacheFile, threads]
+					{
+						MMPackageVerifier verifier(cacheFile, threads);
+						auto lock = MMPackageLock::Capture(*packageManager, verifier);
+						std::string error;
+						if (!lock.Save(lockFile, error))
+							throw std::runtime_error(error);
+						PrintFromJob(std::format("Locked {} package{} in {}\n", lock.GetEntries().size(), (lock.GetEntries().size() == 1) ? "" : "s", lockFile.string()));
+					} });
+			}
+
+			else if (arguments[1] == "restore")
+			{
+				bool dryRun = options.contains("--dry-run") || options.contains("-n");
+				if (!dryRun && pluginManager->IsInitialized())
+				{
+					CONPRINT("You must unload plugin manager before bring any change with package manager.\n");
+					return;
+				}
+				if (g_Plugin.m_jobs.IsBusy())
+				{
+					CONPRINT("Package manager is busy, see 'plugify jobs'.\n");
+					return;
+				}
+				if (arguments.size() < 3)
+				{
+					CONPRINT("usage: plugify restore <file.plock> [--dry-run]\n");
+					return;
+				}
+
+				MMPackageLock lock;
+				std::string error;
+				if (!lock.Load(arguments[2], error))
+				{
+					CONPRINTE(std::format("{}\n", error).c_str());
+					return;
+				}
+
+				MMPackageVerifier verifier(plugify->GetConfig().baseDir / ".cache" / "verify.cache", static_cast<size_t>(g_Plugin.m_settings.GetInt("verify_threads")));
+				auto changes = lock.Diff(*packageManager, verifier);
+				if (changes.empty())
+				{
+					CONPRINT(std::format("All {} package{} match the lockfile.\n", lock.GetEntries().size(), (lock.GetEntries().size() == 1) ? "" : "s").c_str());
+					return;
+				}
+
+				std::string sMessage = std::format("{} change{} ({} package{} locked):\n", changes.size(), (changes.size() == 1) ? "" : "s", lock.GetEntries().size(), (lock.GetEntries().size() == 1) ? "" : "s");
+				for (const auto &change : changes)
+				{
+					switch (change.action)
+					{
+						case LockAction::Install:
+							std::format_to(std::back_inserter(sMessage), "  + {} v{}\n", change.entry.name, change.entry.version);
+							break;
+						case LockAction::Update:
+							std::format_to(std::back_inserter(sMessage), "  ~ {} v{} -> v{}\n", change.entry.name, change.installed, change.entry.version);
+							break;
+						case LockAction::Reinstall:
+							std::format_to(std::back_inserter(sMessage), "  ! {} v{} (different build)\n", change.entry.name, change.entry.version);
+							break;
+						case LockAction::Remove:
+							std::format_to(std::back_inserter(sMessage), "  - {} v{}\n", change.entry.name, change.installed);
+							break;
+					}
+				}
+				CONPRINT(sMessage.c_str());
+				if (dryRun)
+				{
+					return;
+				}
+
+				// Removals go last, after the locked packages are fetched, so a failed download changes nothing.
+				std::vector<MMJobQueue::Step> removalSteps;
+				std::vector<std::string> removals;
+				for (const auto &change : changes)
+				{
+					if (change.action == LockAction::Remove)
+						removals.push_back(change.entry.name);
+				}
+				if (!removals.empty())
+				{
+					removalSteps.emplace_back([packageManager, removals] { packageManager->UninstallPackages(removals); });
+				}
+
+				if (MMHttpClient::IsSupported())
+				{
+					// Locked links and checksums are used as-is, the repositories may have moved on.
+					auto store = GetPackageStore(g_Plugin.m_settings);
+					MMPackageInstaller installer(g_Plugin.m_http, plugify->GetConfig().baseDir);
+					std::vector<PackageDownload> downloads;
+					for (const auto &change : changes)
+					{
+						if (change.action == LockAction::Remove)
+							continue;
+
+						const auto &entry = change.entry;
+						auto download = installer.Prepare(entry.name, entry.type, entry.version, entry.url, entry.checksum, change.path);
+						if (download.key.empty())
 						{
-							auto dependency = pluginManager->FindPlugin(reference.GetName());
-							if (dependency.has_value())
+							download.key = entry.store;
+						}
+						if (download.url.empty() && !(store && store->Contains(download.key)))
+						{
+							CONPRINTE(std::format("Package '{}' v{} has no download link in the lockfile.\n", entry.name, entry.version).c_str());
+							return;
+						}
+						downloads.push_back(std::move(download));
+					}
+					SubmitParallelPackageJob(sCommand, packageManager, std::move(downloads), std::move(removalSteps));
+				}
+				else
+				{
+					std::vector<MMJobQueue::Step> steps;
+					for (const auto &change : changes)
+					{
+						const auto &entry = change.entry;
+						switch (change.action)
+						{
+							case LockAction::Install:
+								steps.emplace_back([packageManager, name = entry.name, version = entry.version] { packageManager->InstallPackage(name, version); });
+								break;
+							case LockAction::Update:
+								steps.emplace_back([packageManager, name = entry.name, version = entry.version] { packageManager->UpdatePackage(name, version); });
+								break;
+							case LockAction::Reinstall:
+								steps.emplace_back([packageManager, name = entry.name, version = entry.version]
+								{
+									packageManager->UninstallPackage(name);
+									packageManager->InstallPackage(name, version);
+								});
+								break;
+							case LockAction::Remove:
+								break;
+						}
+					}
+					std::move(removalSteps.begin(), removalSteps.end(), std::back_inserter(steps));
+					SubmitPackageJob(sCommand, std::move(steps));
+				}
+			}
+
+			else if (arguments[1] == "repo")
+			{
+				if (arguments.size() > 2 && arguments[2] == "list")
+				{
+					if (!g_Plugin.m_manifests)
+					{
+						return;
+					}
+					auto status = g_Plugin.m_manifests->GetStatus();
+					std::string sMessage = std::format("Listing {} repositor{}:\n", status.size(), (status.size() == 1) ? "y" : "ies");
+					for (const auto &entry : status)
+					{
+						std::format_to(std::back_inserter(sMessage), "  <{}> {} (age {}s)", ManifestSourceToString(entry.source), entry.url, entry.age.count());
+						if (!entry.error.empty())
+						{
+							std::format_to(std::back_inserter(sMessage), " - {}", entry.error);
+						}
+						sMessage += '\n';
+					}
+					CONPRINT(sMessage.c_str());
+					return;
+				}
+
+				if (pluginManager->IsInitialized())
+				{
+					CONPRINT("You must unload plugin manager before bring any change with package manager.\n");
+					return;
+				}
+				if (g_Plugin.m_jobs.IsBusy())
+				{
+					CONPRINT("Package manager is busy, see 'plugify jobs'.\n");
+					return;
+				}
+
+				if (arguments.size() > 2 && arguments[2] == "refresh")
+				{
+					if (!g_Plugin.m_manifests)
+					{
+						return;
+					}
+					SubmitPackageJob(sCommand, { { [plugify]
+					{
+						AddCachedRepositories(*plugify, *g_Plugin.m_manifests, g_Plugin.m_settings, *g_Plugin.m_logger, true);
+					}, true }, [packageManager] { packageManager->Reload(); } });
+				}
+				else if (arguments.size() > 2)
+				{
+					bool success = false;
+					for (const auto &repository : std::span(arguments.begin() + 2, arguments.size() - 2))
+					{
+						success |= g_Plugin.m_manifests ? g_Plugin.m_manifests->AddRepository(repository) : plugify->AddRepository(repository);
+					}
+					if (success)
+					{
+						SubmitPackageJob(sCommand, { { [plugify]
+						{
+							if (g_Plugin.m_manifests)
 							{
-								Print<plugify::PluginState>(sMessage, *dependency, plugify::PluginUtils::ToString, "    ");
+								AddCachedRepositories(*plugify, *g_Plugin.m_manifests, g_Plugin.m_settings, *g_Plugin.m_logger, false);
 							}
-							else
+						}, true }, [packageManager] { packageManager->Reload(); } });
+					}
+				}
+				else
+				{
+					CONPRINT("You must give at least one repository to add.\n");
+				}
+			}
+
+			else if (arguments[1] == "install")
+			{
+				if (pluginManager->IsInitialized())
+				{
+					CONPRINT("You must unload plugin manager before bring any change with package manager.\n");
+					return;
+				}
+				if (options.contains("--missing") || options.contains("-m"))
+				{
+					SubmitPackageJob(sCommand, { [packageManager]
+					{
+						if (packageManager->HasMissedPackages())
+						{
+							packageManager->InstallMissedPackages();
+						}
+						else
+						{
+							PrintFromJob("No missing packages were found.\n");
+						}
+					} });
+				}
+				else
+				{
+					if (arguments.size() > 2)
+					{
+						if (options.contains("--link") || options.contains("-l"))
+						{
+							SubmitPackageJob(sCommand, { [packageManager, link = arguments[2], reinstall = arguments.size() > 3] { packageManager->InstallAllPackages(link, reinstall); } });
+						}
+						else if (options.contains("--file") || options.contains("-f"))
+						{
+							SubmitPackageJob(sCommand, { [packageManager, file = std::filesystem::path{ arguments[2] }, reinstall = arguments.size() > 3] { packageManager->InstallAllPackages(file, reinstall); } });
+						}
+						else if ((options.contains("--parallel") || options.contains("-p") || GetPackageStore(g_Plugin.m_settings)) && MMHttpClient::IsSupported())
+						{
+							// Planning reads the package manager, which a running job may be changing.
+							if (g_Plugin.m_jobs.IsBusy())
 							{
-								std::format_to(std::back_inserter(sMessage), "    {} <Missing> (v{})", reference.GetName(), reference.GetRequestedVersion().has_value() ? std::to_string(*reference.GetRequestedVersion()) : "[latest]");
+								CONPRINT("Package manager is busy, see 'plugify jobs'.\n");
+								return;
+							}
+							std::vector<std::string> messages;
+							MMPackageInstaller installer(g_Plugin.m_http, plugify->GetConfig().baseDir);
+							auto downloads = installer.Plan(*packageManager, std::span(arguments.begin() + 2, arguments.size() - 2), false, messages);
+							for (const auto &message : messages)
+							{
+								CONPRINT(std::format("{}\n", message).c_str());
+							}
+							if (!downloads.empty())
+							{
+								SubmitParallelPackageJob(sCommand, packageManager, std::move(downloads));
 							}
 						}
-						std::format_to(std::back_inserter(sMessage), "  File: {}\n\n", descriptor.GetEntryPoint());
+						else
+						{
+							std::vector<MMJobQueue::Step> steps;
+							for (const auto &name : std::span(arguments.begin() + 2, arguments.size() - 2))
+							{
+								steps.emplace_back([packageManager, name] { packageManager->InstallPackages(std::span(&name, 1)); });
+							}
+							SubmitPackageJob(sCommand, std::move(steps));
+						}
+					}
+					else
+					{
+						CONPRINT("You must give at least one requirement to install.\n");
+					}
+				}
+			}
 
-						CONPRINT(sMessage.c_str());
+			else if (arguments[1] == "remove")
+			{
+				if (pluginManager->IsInitialized())
+				{
+					CONPRINT("You must unload plugin manager before bring any change with package manager.\n");
+					return;
+				}
+				if (options.contains("--all") || options.contains("-a"))
+				{
+					SubmitPackageJob(sCommand, { [packageManager] { packageManager->UninstallAllPackages(); } });
+				}
+				else if (options.contains("--conflict") || options.contains("-c"))
+				{
+					SubmitPackageJob(sCommand, { [packageManager]
+					{
+						if (packageManager->HasConflictedPackages())
+						{
+							packageManager->UninstallConflictedPackages();
+						}
+						else
+						{
+							PrintFromJob("No conflicted packages were found.\n");
+						}
+					} });
+				}
+				else
+				{
+					if (arguments.size() > 2)
+					{
+						std::vector<MMJobQueue::Step> steps;
+						for (const auto &name : std::span(arguments.begin() + 2, arguments.size() - 2))
+						{
+							steps.emplace_back([packageManager, name] { packageManager->UninstallPackages(std::span(&name, 1)); });
+						}
+						SubmitPackageJob(sCommand, std::move(steps));
 					}
 					else
 					{
-						CONPRINT(std::format("Plugin {} not found.\n", arguments[2]).c_str());
+						CONPRINT("You must give at least one requirement to remove.\n");
 					}
 				}
-				else
+			}
+
+			else if (arguments[1] == "staged")
+			{
+				if (!g_Plugin.m_staged)
+				{
+					return;
+				}
+				if (arguments.size() > 2 && arguments[2] == "apply")
+				{
+					ApplyStagedUpdates();
+					return;
+				}
+				if (arguments.size() > 2 && arguments[2] == "discard")
+				{
+					g_Plugin.m_staged->Discard();
+					CONPRINT("Staged updates were discarded.\n");
+					return;
+				}
+				auto pending = g_Plugin.m_staged->GetPending();
+				std::string sMessage = pending.empty() ? std::string("No staged updates.\n") : std::format("Listing {} staged update{} (applied at map change):\n", pending.size(), (pending.size() > 1) ? "s" : "");
+				for (const auto &package : pending)
 				{
-					CONPRINT("You must provide name.\n");
+					std::format_to(std::back_inserter(sMessage), "  {} -> v{}\n", package.name, package.version);
 				}
+				CONPRINT(sMessage.c_str());
 			}
 
-			else if (arguments[1] == "module")
+			else if (arguments[1] == "update")
 			{
-				if (arguments.size() > 2)
+				bool stage = options.contains("--stage") || options.contains("-s");
+				if (pluginManager->IsInitialized() && !stage)
 				{
-					if (!pluginManager->IsInitialized())
+					CONPRINT("You must unload plugin manager before bring any change with package manager (or stage updates with -s).\n");
+					return;
+				}
+				if (stage && !MMHttpClient::IsSupported())
+				{
+					CONPRINT("Staged updates require the built-in HTTP client.\n");
+					return;
+				}
+				if (stage || ((options.contains("--parallel") || options.contains("-p") || GetPackageStore(g_Plugin.m_settings)) && MMHttpClient::IsSupported()))
+				{
+					if (g_Plugin.m_jobs.IsBusy())
 					{
-						CONPRINT("You must load plugin manager before query any information from it.");
+						CONPRINT("Package manager is busy, see 'plugify jobs'.\n");
 						return;
 					}
-					auto module = options.contains("--uuid") || options.contains("-u") ? pluginManager->FindModuleFromId(FormatInt(arguments[2])) : pluginManager->FindModule(arguments[2]);
-					if (module.has_value())
+					std::vector<std::string> names;
+					if (options.contains("--all") || options.contains("-a"))
 					{
-						std::string sMessage;
-
-						Print<plugify::ModuleState>(sMessage, "Module", *module, plugify::ModuleUtils::ToString);
-						std::format_to(std::back_inserter(sMessage), "  Language: {}\n", module->GetLanguage());
-						std::format_to(std::back_inserter(sMessage), "  File: {}\n\n", std::filesystem::path(module->GetFilePath()).string());
+						for (const auto &package : packageManager->GetLocalPackages())
+						{
+							names.push_back(package.name);
+						}
+					}
+					else
+					{
+						names.assign(arguments.begin() + 2, arguments.end());
+					}
+					if (names.empty())
+					{
+						CONPRINT("You must give at least one requirement to update.\n");
+						return;
+					}
 
-						CONPRINT(sMessage.c_str());
+					std::vector<std::string> messages;
+					MMPackageInstaller installer(g_Plugin.m_http, plugify->GetConfig().baseDir);
+					auto downloads = installer.Plan(*packageManager, names, true, messages);
+					for (const auto &message : messages)
+					{
+						CONPRINT(std::format("{}\n", message).c_str());
+					}
+					if (downloads.empty())
+					{
+						return;
+					}
+					if (stage)
+					{
+						SubmitStagedPackageJob(sCommand, std::move(downloads));
 					}
 					else
 					{
-						CONPRINT(std::format("Module {} not found.\n", arguments[2]).c_str());
+						SubmitParallelPackageJob(sCommand, packageManager, std::move(downloads));
 					}
 				}
-				else
+				else if (options.contains("--all") || options.contains("-a"))
 				{
-					CONPRINT("You must provide name.\n");
+					SubmitPackageJob(sCommand, { [packageManager] { packageManager->UpdateAllPackages(); } });
 				}
-			}
-
-			else if (arguments[1] == "snapshot")
-			{
-				if (pluginManager->IsInitialized())
+				else
 				{
-					CONPRINT("You must unload plugin manager before bring any change with package manager.\n");
-					return;
+					if (arguments.size() > 2)
+					{
+						std::vector<MMJobQueue::Step> steps;
+						for (const auto &name : std::span(arguments.begin() + 2, arguments.size() - 2))
+						{
+							steps.emplace_back([packageManager, name] { packageManager->UpdatePackages(std::span(&name, 1)); });
+						}
+						SubmitPackageJob(sCommand, std::move(steps));
+					}
+					else
+					{
+						CONPRINT("You must give at least one requirement to update.\n");
+					}
 				}
-				packageManager->SnapshotPackages(plugify->GetConfig().baseDir / std::format("snapshot_{}.wpackagemanifest", FormatTime("%Y_%m_%d_%H_%M_%S")), true);
 			}
 
-			else if (arguments[1] == "repo")
+			else if (arguments[1] == "set")
 			{
-				if (pluginManager->IsInitialized())
-				{
-					CONPRINT("You must unload plugin manager before bring any change with package manager.\n");
-					return;
-				}
-
-				if (arguments.size() > 2)
+				if (arguments.size() > 3)
 				{
-					bool success = false;
-					for (const auto &repository : std::span(arguments.begin() + 2, arguments.size() - 2))
+					std::string error;
+					if (g_Plugin.m_settings.Set(arguments[2], arguments[3], error))
 					{
-						success |= plugify->AddRepository(repository);
+						if (arguments[2] == "mem_sample_bytes")
+						{
+							g_Plugin.m_memory.SetSampleInterval(static_cast<uint64_t>(std::max<int64_t>(g_Plugin.m_settings.GetInt("mem_sample_bytes"), 0)));
+						}
+						CONPRINT(std::format("{} = {}\n", arguments[2], arguments[3]).c_str());
 					}
-					if (success)
+					else
 					{
-						packageManager->Reload();
+						CONPRINTE(std::format("{}\n", error).c_str());
 					}
 				}
 				else
 				{
-					CONPRINT("You must give at least one repository to add.\n");
+					std::string sMessage = "Settings:\n";
+					for (const auto &entry : g_Plugin.m_settings.GetEntries())
+					{
+						if (arguments.size() > 2 && entry.name != arguments[2])
+							continue;
+						std::visit([&](const auto &value) { std::format_to(std::back_inserter(sMessage), "  {} = {} - {}\n", entry.name, value, entry.description); }, entry.value);
+					}
+					CONPRINT(sMessage.c_str());
 				}
 			}
 
-			else if (arguments[1] == "install")
+			else if (arguments[1] == "verify")
 			{
-				if (pluginManager->IsInitialized())
+				if (g_Plugin.m_jobs.IsBusy())
 				{
-					CONPRINT("You must unload plugin manager before bring any change with package manager.\n");
+					CONPRINT("Package manager is busy, see 'plugify jobs'.\n");
 					return;
 				}
-				if (options.contains("--missing") || options.contains("-m"))
+
+				std::vector<std::pair<std::string, std::filesystem::path>> packages;
+				bool all = options.contains("--all") || options.contains("-a");
+				for (const auto &localPackage : packageManager->GetLocalPackages())
 				{
-					if (packageManager->HasMissedPackages())
-					{
-						packageManager->InstallMissedPackages();
-					}
-					else
+					if (all || std::find(arguments.begin() + 2, arguments.end(), localPackage.name) != arguments.end())
 					{
-						CONPRINT("No missing packages were found.\n");
+						packages.emplace_back(localPackage.name, localPackage.path.parent_path());
 					}
 				}
-				else
+				if (packages.empty())
 				{
-					if (arguments.size() > 2)
+					CONPRINT(all ? "No local packages found.\n" : "usage: plugify verify <name>... | --all\n");
+					return;
+				}
+
+				auto cacheFile = plugify->GetConfig().baseDir / ".cache" / "verify.cache";
+				auto threads = static_cast<size_t>(g_Plugin.m_settings.GetInt("verify_threads"));
+				SubmitPackageJob(sCommand, { [packages = std::move(packages), cacheFile, threads]
+				{
+					MMPackageVerifier verifier(cacheFile, threads);
+					size_t failed = 0;
+					std::string sMessage;
+					for (const auto &report : verifier.Verify(packages))
 					{
-						if (options.contains("--link") || options.contains("-l"))
+						if (!report.error.empty())
 						{
-							packageManager->InstallAllPackages(arguments[2], arguments.size() > 3);
+							++failed;
+							std::format_to(std::back_inserter(sMessage), "  {}: {}\n", report.package, report.error);
+							continue;
 						}
-						else if (options.contains("--file") || options.contains("-f"))
-						{
-							packageManager->InstallAllPackages(std::filesystem::path{ arguments[2] }, arguments.size() > 3);
-						}
-						else
+						if (report.baselineCreated)
 						{
-							packageManager->InstallPackages(std::span(arguments.begin() + 2, arguments.size() - 2));
+							std::format_to(std::back_inserter(sMessage), "  {}: no file list from install, trusted the files on disk and recorded {} as the baseline\n", report.package, report.files);
+							continue;
 						}
+
+						// Extra files are usually configs or logs the plugin wrote; they are listed, not failed.
+						bool clean = report.modified.empty() && report.missing.empty();
+						failed += !clean;
+						std::format_to(std::back_inserter(sMessage), "  {}: {} ({} files, {} hashed", report.package, clean ? "ok" : "FAILED", report.files, report.hashed);
+						if (report.ignored)
+							std::format_to(std::back_inserter(sMessage), ", {} ignored", report.ignored);
+						sMessage += ")\n";
+						for (const auto &file : report.modified)
+							std::format_to(std::back_inserter(sMessage), "    modified: {}\n", file);
+						for (const auto &file : report.missing)
+							std::format_to(std::back_inserter(sMessage), "    missing: {}\n", file);
+						for (const auto &file : report.extra)
+							std::format_to(std::back_inserter(sMessage), "    extra (not installed by the package): {}\n", file);
 					}
-					else
+					if (failed)
 					{
-						CONPRINT("You must give at least one requirement to install.\n");
+						PrintFromJob(std::move(sMessage), true);
+						throw std::runtime_error(std::format("{} package{} failed verification", failed, (failed > 1) ? "s" : ""));
 					}
-				}
+					PrintFromJob(std::move(sMessage));
+				} });
 			}
 
-			else if (arguments[1] == "remove")
+			else if (arguments[1] == "store")
 			{
-				if (pluginManager->IsInitialized())
+				auto store = GetPackageStore(g_Plugin.m_settings);
+				if (!store)
 				{
-					CONPRINT("You must unload plugin manager before bring any change with package manager.\n");
+					CONPRINT("Package store is disabled, set 'store_dir' to enable it.\n");
 					return;
 				}
-				if (options.contains("--all") || options.contains("-a"))
+
+				if (arguments.size() > 2 && arguments[2] == "gc")
 				{
-					packageManager->UninstallAllPackages();
+					SubmitPackageJob(sCommand, { [store]
+					{
+						size_t removed = store->Collect();
+						PrintFromJob(std::format("Removed {} unused package{} from the store.\n", removed, (removed == 1) ? "" : "s"));
+					} });
+					return;
 				}
-				else if (options.contains("--conflict") || options.contains("-c"))
+
+				auto entries = store->GetEntries();
+				uint64_t total = 0;
+				std::string sMessage = std::format("Package store at {} ({}):\n", store->GetRoot().string(), StoreLinkModeToString(store->GetMode()));
+				for (const auto &entry : entries)
 				{
-					if (packageManager->HasConflictedPackages())
-					{
-						packageManager->UninstallConflictedPackages();
-					}
-					else
-					{
-						CONPRINT("No conflicted packages were found.\n");
-					}
+					total += entry.size;
+					std::format_to(std::back_inserter(sMessage), "  {} - {} files, {:.1f} MB, used by {} package{}\n", entry.key.substr(0, 16), entry.files, entry.size / (1024.0 * 1024.0), entry.references, (entry.references == 1) ? "" : "s");
 				}
-				else
+				std::format_to(std::back_inserter(sMessage), "{} package{}, {:.1f} MB\n", entries.size(), (entries.size() == 1) ? "" : "s", total / (1024.0 * 1024.0));
+				CONPRINT(sMessage.c_str());
+			}
+
+			else if (arguments[1] == "jobs")
+			{
+				auto jobs = g_Plugin.m_jobs.GetJobs();
+				std::string sMessage = jobs.empty() ? std::string("No package jobs.\n") : std::format("Listing {} package job{}:\n", jobs.size(), (jobs.size() > 1) ? "s" : "");
+				for (const auto &job : jobs)
 				{
-					if (arguments.size() > 2)
+					std::format_to(std::back_inserter(sMessage), "  #{} <{}> {}/{} ({:.1f}s) {}", job.id, JobStateToString(job.state), job.done, job.total, job.elapsed.count(), job.name);
+					if (!job.error.empty())
 					{
-						packageManager->UninstallPackages(std::span(arguments.begin() + 2, arguments.size() - 2));
-					}
-					else
-					{
-						CONPRINT("You must give at least one requirement to remove.\n");
+						std::format_to(std::back_inserter(sMessage), " - {}", job.error);
 					}
+					sMessage += '\n';
 				}
+				CONPRINT(sMessage.c_str());
 			}
 
-			else if (arguments[1] == "update")
+			else if (arguments[1] == "job")
 			{
-				if (pluginManager->IsInitialized())
-				{
-					CONPRINT("You must unload plugin manager before bring any change with package manager.\n");
-					return;
-				}
-				if (options.contains("--all") || options.contains("-a"))
+				if (arguments.size() > 3 && arguments[2] == "cancel")
 				{
-					packageManager->UpdateAllPackages();
-				}
-				else
-				{
-					if (arguments.size() > 2)
+					ptrdiff_t id = FormatInt(arguments[3]);
+					if (id < 0)
 					{
-						packageManager->UpdatePackages(std::span(arguments.begin() + 2, arguments.size() - 2));
+						return;
 					}
-					else
+					switch (g_Plugin.m_jobs.Cancel(static_cast<uint64_t>(id)))
 					{
-						CONPRINT("You must give at least one requirement to update.\n");
+						case CancelResult::Cancelled:
+							CONPRINT(std::format("Job #{} cancelled.\n", id).c_str());
+							break;
+						case CancelResult::Requested:
+							CONPRINT(std::format("Job #{} cancellation requested, it stops at the next step.\n", id).c_str());
+							break;
+						case CancelResult::Uncancellable:
+							CONPRINT(std::format("Job #{} is in a package manager operation that cannot be interrupted.\n", id).c_str());
+							break;
+						case CancelResult::NotFound:
+							CONPRINT(std::format("Job #{} is not queued or running.\n", id).c_str());
+							break;
 					}
 				}
+				else
+				{
+					CONPRINT("usage: plugify job cancel <id>\n");
+				}
 			}
 
 			else if (arguments[1] == "list")
 			{
 				if (pluginManager->IsInitialized())
 				{
-					CONPRINT("You must unload plugin manager before bring any change with package manager.\n");
+					PrintCommandError(json, "You must unload plugin manager before bring any change with package manager.\n");
 					return;
 				}
-				auto count = packageManager->GetLocalPackages().size();
-				if (!count)
+				if (g_Plugin.m_jobs.IsBusy())
 				{
-					CONPRINT("No local packages found.\n");
+					PrintCommandError(json, "Package manager is busy, see 'plugify jobs'.\n");
+					return;
 				}
-				else
+				const auto &localPackages = packageManager->GetLocalPackages();
+				auto count = localPackages.size();
+				if (json)
 				{
-					CONPRINT(std::format("Listing {} local package{}:\n", static_cast<int>(count), (count > 1) ? "s" : "").c_str());
+					MMJsonWriter writer(64 + count * 256);
+					writer.BeginObject();
+					writer.Key("packages").BeginArray();
+					for (const auto &localPackage : localPackages)
+					{
+						WriteJson(writer, localPackage);
+					}
+					writer.EndArray();
+					writer.EndObject();
+					CONPRINT(writer.Release().c_str());
+					return;
 				}
-				for (auto &localPackage : packageManager->GetLocalPackages())
+
+				std::string sMessage = count ? std::format("Listing {} local package{}:\n", static_cast<int>(count), (count > 1) ? "s" : "") : std::string("No local packages found.\n");
+				sMessage.reserve(sMessage.size() + count * 128);
+				for (const auto &localPackage : localPackages)
 				{
-					CONPRINT(std::format("  {} [{}] (v{}) at {}\n", localPackage.name, localPackage.type, localPackage.version, localPackage.path.string()).c_str());
+					bool shared = MMPackageStore::GetSharedKey(localPackage.path.parent_path()).has_value();
+					std::format_to(std::back_inserter(sMessage), "  {} [{}] (v{}) <{}> at {}\n", localPackage.name, localPackage.type, localPackage.version, shared ? "shared" : "private", localPackage.path.string());
 				}
+				CONPRINT(sMessage.c_str());
 			}
 
 			else if (arguments[1] == "query")
 			{
 				if (pluginManager->IsInitialized())
 				{
-					CONPRINT("You must unload plugin manager before bring any change with package manager.\n");
+					PrintCommandError(json, "You must unload plugin manager before bring any change with package manager.\n");
 					return;
 				}
-				auto count = packageManager->GetRemotePackages().size();
-				std::string sMessage = count ? std::format("Listing {} remote package{}:\n", static_cast<int>(count), (count > 1) ? "s" : "") : std::string("No remote packages found.\n");
-				for (auto &remotePackage : packageManager->GetRemotePackages())
+				if (g_Plugin.m_jobs.IsBusy())
 				{
-					if (remotePackage.author.empty() || remotePackage.description.empty())
-					{
-						std::format_to(std::back_inserter(sMessage), "  {} [{}]\n", remotePackage.name, remotePackage.type);
-					}
-					else
-					{
-						std::format_to(std::back_inserter(sMessage), "  {} [{}] ({}) by {}\n", remotePackage.name, remotePackage.type, remotePackage.description, remotePackage.author);
-					}
+					PrintCommandError(json, "Package manager is busy, see 'plugify jobs'.\n");
+					return;
 				}
-
-				CONPRINT(sMessage.c_str());
+				const auto &index = GetPackageIndex(*packageManager);
+				auto search = ParseSearchArguments(std::span(arguments.begin() + 2, arguments.size() - 2));
+				auto pageSize = static_cast<size_t>(std::max<int64_t>(1, g_Plugin.m_settings.GetInt("search_page_size")));
+				auto result = index.Search({}, search.type, (search.page - 1) * pageSize, pageSize);
+				PrintSearchResult(index, result, search.page, pageSize, "Listing", json);
 			}
 
 			else if (arguments[1] == "show")
 			{
 				if (pluginManager->IsInitialized())
 				{
-					CONPRINT("You must unload plugin manager before bring any change with package manager.\n");
+					PrintCommandError(json, "You must unload plugin manager before bring any change with package manager.\n");
+					return;
+				}
+				if (g_Plugin.m_jobs.IsBusy())
+				{
+					PrintCommandError(json, "Package manager is busy, see 'plugify jobs'.\n");
 					return;
 				}
 				if (arguments.size() > 2)
 				{
 					auto package = packageManager->FindLocalPackage(arguments[2]);
-					if (package.has_value())
+					if (package.has_value() && json)
+					{
+						MMJsonWriter writer(512);
+						WriteJson(writer, *package);
+						CONPRINT(writer.Release().c_str());
+					}
+					else if (package.has_value())
 					{
+						auto key = MMPackageStore::GetSharedKey(package->path.parent_path());
 						CONPRINT(std::format("  Name: {}\n"
 						                     "  Type: {}\n"
 						                     "  Version: {}\n"
-						                     "  File: {}\n\n", package->name, package->type, package->version, package->path.string()).c_str());
+						                     "  File: {}\n"
+						                     "  Storage: {}\n\n", package->name, package->type, package->version, package->path.string(), key ? std::format("shared ({})", key->substr(0, 16)) : std::string("private")).c_str());
 					}
 					else
 					{
-						CONPRINT(std::format("Package {} not found.\n", arguments[2]).c_str());
+						PrintCommandError(json, std::format("Package {} not found.\n", arguments[2]));
 					}
 				}
 				else
 				{
-					CONPRINT("You must provide name.\n");
+					PrintCommandError(json, "You must provide name.\n");
 				}
 			}
 
@@ -617,13 +2302,41 @@ namespace plugifyMM
 			{
 				if (pluginManager->IsInitialized())
 				{
-					CONPRINT("You must unload plugin manager before bring any change with package manager.\n");
+					PrintCommandError(json, "You must unload plugin manager before bring any change with package manager.\n");
 					return;
 				}
-				if (arguments.size() > 2)
+				if (g_Plugin.m_jobs.IsBusy())
+				{
+					PrintCommandError(json, "Package manager is busy, see 'plugify jobs'.\n");
+					return;
+				}
+				auto search = ParseSearchArguments(std::span(arguments.begin() + 2, arguments.size() - 2));
+				if (!search.query.empty())
 				{
-					auto package = packageManager->FindRemotePackage(arguments[2]);
-					if (package.has_value())
+					auto package = search.type.empty() && search.page == 1 ? packageManager->FindRemotePackage(search.query) : std::nullopt;
+					if (!package.has_value())
+					{
+						const auto &index = GetPackageIndex(*packageManager);
+						auto pageSize = static_cast<size_t>(std::max<int64_t>(1, g_Plugin.m_settings.GetInt("search_page_size")));
+						auto start = std::chrono::steady_clock::now();
+						auto result = index.Search(search.query, search.type, (search.page - 1) * pageSize, pageSize);
+						std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+						PrintSearchResult(index, result, search.page, pageSize, std::format("Found in {:.2f} ms:", elapsed.count()), json);
+					}
+					else if (json)
+					{
+						MMJsonWriter writer(1024);
+						writer.BeginObject();
+						writer.Key("total").Uint(1);
+						writer.Key("page").Uint(1);
+						writer.Key("exact").Bool(true);
+						writer.Key("packages").BeginArray();
+						WriteJson(writer, *package);
+						writer.EndArray();
+						writer.EndObject();
+						CONPRINT(writer.Release().c_str());
+					}
+					else
 					{
 						std::string sMessage;
 
@@ -655,14 +2368,10 @@ namespace plugifyMM
 							CONPRINT("\n");
 						}
 					}
-					else
-					{
-						CONPRINT(std::format("Package {} not found.\n", arguments[2]).c_str());
-					}
 				}
 				else
 				{
-					CONPRINT("You must provide name.\n");
+					PrintCommandError(json, "You must provide name.\n");
 				}
 			}
 
@@ -693,6 +2402,8 @@ namespace plugifyMM
 		GET_V_IFACE_ANY(GetEngineFactory, g_pNetworkServerService, INetworkServerService, NETWORKSERVERSERVICE_INTERFACE_VERSION);
 
 		g_SMAPI->AddListener(this, &m_listener);
+		SH_ADD_HOOK(IServerGameDLL, GameFrame, server, SH_MEMBER(this, &PlugifyMMPlugin::Hook_GameFramePre), false);
+		SH_ADD_HOOK(IServerGameDLL, GameFrame, server, SH_MEMBER(this, &PlugifyMMPlugin::Hook_GameFrame), true);
 
 		g_pCVar = icvar;
 		ConVar_Register(FCVAR_RELEASE | FCVAR_SERVER_CAN_EXECUTE | FCVAR_GAMEDLL);
@@ -701,42 +2412,137 @@ namespace plugifyMM
 
 		m_logger = std::make_shared<MMLogger>("plugify", &RegisterTags);
 		m_logger->SetSeverity(plugify::Severity::Info);
+		m_logger->SetFlightRecorder(&m_recorder);
+		m_logger->SetStartupProfiler(&m_profiler);
+		m_recorder.Record(FlightEvent::Lifecycle, "plugify loading");
 		m_context->SetLogger(m_logger);
+		m_jobs.Start();
+
+		m_profiler.Start();
+		MMProfileScope startup(m_profiler, "startup");
 
 		std::filesystem::path rootDir(Plat_GetGameDirectory());
-		auto result = m_context->Initialize(rootDir / "csgo");
+		{
+			// Repositories left in the pconfig would be fetched by the core directly, past the cache.
+			std::string error;
+			auto migrated = MMManifestCache::MigrateRepositories(rootDir / "csgo" / "plugify.pconfig", rootDir / "csgo" / "plugify.prepos", error);
+			if (!error.empty())
+			{
+				MM_LOG(m_logger, Warning, "Could not move repositories out of plugify.pconfig: {}", error);
+			}
+			else if (!migrated.empty())
+			{
+				MM_LOG(m_logger, Info, "Moved {} repositories from plugify.pconfig to plugify.prepos", migrated.size());
+			}
+		}
+		bool result;
+		{
+			MMProfileScope phase(m_profiler, "plugify initialize");
+			result = m_context->Initialize(rootDir / "csgo");
+		}
 		if (result)
 		{
 			m_logger->SetSeverity(m_context->GetConfig().logSeverity);
+			// Recording more than the console shows would format lines nobody asked for; raise it with 'recorder level'.
+			m_recorder.SetSeverity(m_context->GetConfig().logSeverity);
+			MM_LOG(m_logger, Debug, "Plugify base directory: {}", m_context->GetConfig().baseDir.string());
+			m_recorder.InstallCrashHandler(m_context->GetConfig().baseDir / "logs" / "flight_crash.txt");
 
-			if (auto packageManager = m_context->GetPackageManager().lock())
+			if (CommandLine()->HasParm("-plugify_offline"))
+			{
+				std::string error;
+				m_settings.Set("offline", "1", error);
+			}
+			if (CommandLine()->HasParm("-plugify_preload"))
+			{
+				std::string error;
+				m_settings.Set("preload", "1", error);
+			}
+			if (const char *store = CommandLine()->ParmValue("-plugify_store", static_cast<const char *>(nullptr)))
 			{
-				packageManager->Initialize();
+				std::string error;
+				m_settings.Set("store_dir", store, error);
+			}
+			if (const char *metrics = CommandLine()->ParmValue("-plugify_metrics", static_cast<const char *>(nullptr)))
+			{
+				std::string error;
+				m_settings.Set("metrics_address", metrics, error);
+			}
+			if (const char *ttl = CommandLine()->ParmValue("-plugify_manifest_ttl", static_cast<const char *>(nullptr)))
+			{
+				std::string error;
+				if (!m_settings.Set("manifest_ttl_s", ttl, error))
+				{
+					MM_LOG(m_logger, Warning, "-plugify_manifest_ttl: {}", error);
+				}
+			}
+
+			if (auto address = m_settings.GetString("metrics_address"); !address.empty())
+			{
+				StartMetrics(address);
+			}
 
-				if (packageManager->HasMissedPackages())
+			ApplyHttpSettings(m_http, m_settings);
+			{
+				MMProfileScope phase(m_profiler, "repositories");
+				m_manifests = std::make_unique<MMManifestCache>(m_http, m_context->GetConfig().baseDir / ".cache" / "manifests");
+				m_staged = std::make_unique<MMStagedUpdates>(m_context->GetConfig().baseDir / ".cache" / "staged");
+				if (m_manifests->LoadRepositories(rootDir / "csgo" / "plugify.prepos"))
 				{
-					CONPRINT("Plugin manager has missing packages, run 'update --missing' to resolve issues.");
-					return true;
+					AddCachedRepositories(*m_context, *m_manifests, m_settings, *m_logger, false);
+				}
+			}
+
+			if (auto packageManager = m_context->GetPackageManager().lock())
+			{
+				{
+					MMProfileScope phase(m_profiler, "package manager initialize");
+					packageManager->Initialize();
+					// Updates staged before the server stopped, checked like at a map change; nothing is loaded yet.
+					if (m_staged->HasPending() && CheckStagedUpdates(*packageManager))
+					{
+						size_t applied = CommitStagedUpdates(*packageManager);
+						MM_LOG(m_logger, Info, "Applied {} staged update{}", applied, applied == 1 ? "" : "s");
+					}
 				}
-				if (packageManager->HasConflictedPackages())
 				{
-					CONPRINT("Plugin manager has conflicted packages, run 'remove --conflict' to resolve issues.");
+					MMProfileScope phase(m_profiler, "package index");
+					m_packageIndex.Build(packageManager->GetRemotePackages());
+				}
+
+				MMProfileScope phase(m_profiler, "dependency check");
+				if (!CheckDependencies(*packageManager))
+				{
+					m_profiler.Stop();
 					return true;
 				}
 			}
 
 			if (auto pluginManager = m_context->GetPluginManager().lock())
 			{
-				pluginManager->Initialize();
+				InitializePluginManager(*pluginManager);
 			}
 		}
+		m_profiler.Stop();
 
 		return result;
 	}
 
 	bool PlugifyMMPlugin::Unload(char *error, size_t maxlen)
 	{
+		m_recorder.Record(FlightEvent::Lifecycle, "plugify unloading");
+		SH_REMOVE_HOOK(IServerGameDLL, GameFrame, server, SH_MEMBER(this, &PlugifyMMPlugin::Hook_GameFramePre), false);
+		SH_REMOVE_HOOK(IServerGameDLL, GameFrame, server, SH_MEMBER(this, &PlugifyMMPlugin::Hook_GameFrame), true);
+		m_jobs.Stop();
+		m_sampler.Stop();
+		m_metrics.Stop();
+		m_manifests.reset();
+		m_staged.reset();
 		m_context.reset();
+		m_recorder.RemoveCrashHandler();
+		m_logger->SetFlightRecorder(nullptr);
+		m_logger->SetStartupProfiler(nullptr);
+		m_logger->DisableAsync();
 		return true;
 	}
 
@@ -744,13 +2550,54 @@ namespace plugifyMM
 	{
 	}
 
+	void MMListener::OnLevelShutdown()
+	{
+		ApplyStagedUpdates();
+	}
+
+	// The pre-hook runs before the game and hooks ordered after ours, so the span covers both
+	// without telling them apart.
+	void PlugifyMMPlugin::Hook_GameFramePre(bool simulating, bool bFirstTick, bool bLastTick)
+	{
+		m_frames.BeginTick();
+	}
+
+	void PlugifyMMPlugin::Hook_GameFrame(bool simulating, bool bFirstTick, bool bLastTick)
+	{
+		static const size_t slot = m_frames.Register("plugify (jobs)", false);
+		auto start = MMFrameProfiler::Clock::now();
+		m_jobs.Poll();
+		m_frames.Add(slot, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(MMFrameProfiler::Clock::now() - start).count()));
+		m_frames.EndTick();
+
+		if (start - m_logFlushed >= std::chrono::seconds(1))
+		{
+			m_logFlushed = start;
+			m_logger->FlushSummaries();
+		}
+
+		if (m_metrics.IsRunning() && start - m_metricsPublished >= std::chrono::seconds(1))
+		{
+			m_metricsPublished = start;
+			m_metrics.Publish(BuildMetrics());
+		}
+	}
+
+	// Metamod pauses every SourceHook hook registered under our id, which plugify plugins share
+	// through Plugify_Id(). Other callbacks are dispatched by the language SDKs, which can check
+	// Plugify_IsPaused(); modules and plugins stay loaded either way. Our own GameFrame hooks
+	// are paused too, so job output and the metrics snapshot wait until plugify is unpaused.
 	bool PlugifyMMPlugin::Pause(char *error, size_t maxlen)
 	{
+		m_paused = true;
+		m_recorder.Record(FlightEvent::Lifecycle, "plugify paused");
 		return true;
 	}
 
 	bool PlugifyMMPlugin::Unpause(char *error, size_t maxlen)
 	{
+		m_paused = false;
+		m_recorder.Record(FlightEvent::Lifecycle, "plugify resumed");
 		return true;
 	}
 
@@ -819,3 +2666,58 @@ SMM_API SourceHook::ISourceHook *Plugify_SourceHook()
 {
 	return plugifyMM::g_SHPtr;
 }
+
+SMM_API void Plugify_Log(const char *source, int severity, const char *message)
+{
+	if (!source || !message || severity < static_cast<int>(plugify::Severity::None) || severity > static_cast<int>(plugify::Severity::Verbose))
+		return;
+	if (auto &logger = plugifyMM::g_Plugin.m_logger)
+	{
+		logger->Log(source, message, static_cast<plugify::Severity>(severity));
+	}
+}
+
+SMM_API bool Plugify_IsPaused()
+{
+	return plugifyMM::g_Plugin.m_paused;
+}
+
+// For language SDKs to report the time they spend dispatching callbacks to each plugin or
+// module; nothing is shown per plugin in 'plugify perf' until an SDK calls these.
+SMM_API int Plugify_PerfRegister(const char *name)
+{
+	if (!name)
+		return -1;
+	size_t slot = plugifyMM::g_Plugin.m_frames.Register(name);
+	return slot == plugifyMM::MMFrameProfiler::kInvalidSlot ? -1 : static_cast<int>(slot);
+}
+
+SMM_API void Plugify_PerfAdd(int slot, uint64_t nanoseconds)
+{
+	plugifyMM::g_Plugin.m_frames.Add(static_cast<size_t>(slot), nanoseconds);
+}
+
+// 'name' is the plugin or module name, so 'plugify plugin <name>' can show the usage.
+SMM_API int Plugify_MemRegister(const char *name)
+{
+	if (!name)
+		return -1;
+	size_t slot = plugifyMM::g_Plugin.m_memory.Register(name);
+	return slot == plugifyMM::MMMemoryTracker::kInvalidSlot ? -1 : static_cast<int>(slot);
+}
+
+SMM_API void Plugify_MemAdd(int slot, int64_t bytes)
+{
+	plugifyMM::g_Plugin.m_memory.Add(static_cast<size_t>(slot), bytes);
+}
+
+SMM_API void Plugify_MemSetRuntimeHeap(int slot, uint64_t bytes)
+{
+	plugifyMM::g_Plugin.m_memory.SetRuntimeHeap(static_cast<size_t>(slot), bytes);
+}
+
+// Shims report one allocation per this many bytes, weighted by the interval; 0 reports all.
+SMM_API uint64_t Plugify_MemSampleInterval()
+{
+	return plugifyMM::g_Plugin.m_memory.GetSampleInterval();
+}
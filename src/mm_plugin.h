@@ -16,7 +16,21 @@
 
 #include <ISmmPlugin.h>
 
+#include "mm_dependency_graph.h"
+#include "mm_flight_recorder.h"
+#include "mm_frame_profiler.h"
+#include "mm_http.h"
+#include "mm_jobs.h"
 #include "mm_logger.h"
+#include "mm_manifest_cache.h"
+#include "mm_memory_tracker.h"
+#include "mm_metrics.h"
+#include "mm_package_index.h"
+#include "mm_package_store.h"
+#include "mm_sampling_profiler.h"
+#include "mm_settings.h"
+#include "mm_staged_updates.h"
+#include "mm_startup_profiler.h"
 
 namespace plugify
 {
@@ -25,6 +39,14 @@ namespace plugify
 
 namespace plugifyMM
 {
+	// Listener registered with Metamod and handed to plugins through Plugify_ImmListener().
+	class MMListener : public IMetamodListener
+	{
+	public:
+		// Map change is the safe point for swapping in staged updates.
+		void OnLevelShutdown() override;
+	};
+
 	class PlugifyMMPlugin : public ISmmPlugin
 	{
 	public:
@@ -34,6 +56,9 @@ namespace plugifyMM
 		bool Unpause(char *error, size_t maxlen) override;
 		void AllPluginsLoaded() override;
 
+		void Hook_GameFramePre(bool simulating, bool bFirstTick, bool bLastTick);
+		void Hook_GameFrame(bool simulating, bool bFirstTick, bool bLastTick);
+
 	public:
 		const char *GetAuthor() override;
 		const char *GetName() override;
@@ -44,9 +69,27 @@ namespace plugifyMM
 		const char *GetDate() override;
 		const char *GetLogTag() override;
 
-		IMetamodListener m_listener;
+		MMListener m_listener;
 		std::shared_ptr<MMLogger> m_logger;
 		std::shared_ptr<plugify::IPlugify> m_context;
+		MMFlightRecorder m_recorder;
+		MMStartupProfiler m_profiler;
+		MMFrameProfiler m_frames;
+		MMSamplingProfiler m_sampler;
+		MMMemoryTracker m_memory;
+		MMMetricsServer m_metrics;
+		std::chrono::steady_clock::time_point m_metricsPublished;
+		std::chrono::steady_clock::time_point m_logFlushed;
+		MMSettings m_settings;
+		MMHttpClient m_http;
+		std::unique_ptr<MMManifestCache> m_manifests;
+		std::unique_ptr<MMStagedUpdates> m_staged;
+		std::shared_ptr<MMPackageStore> m_store;
+		std::string m_storeLink;
+		MMJobQueue m_jobs;
+		MMDependencyGraph m_dependencies;
+		std::atomic<bool> m_paused { false };
+		MMPackageIndex m_packageIndex;
 	};
 
 	extern PlugifyMMPlugin g_Plugin;
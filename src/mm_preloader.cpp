@@ -0,0 +1,96 @@
+#include "mm_preloader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+using namespace plugifyMM;
+
+MMPackagePreloader::MMPackagePreloader(PreloadMode mode, size_t threads) : m_mode(mode), m_threads(threads ? threads : std::max(1u, std::thread::hardware_concurrency()))
+{
+}
+
+MMPackagePreloader::Counters MMPackagePreloader::Preload(const PreloadPackage &package) const
+{
+	Counters counters;
+	std::vector<char> buffer(256 * 1024);
+	std::error_code ec;
+	for (auto it = std::filesystem::recursive_directory_iterator(package.directory, ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec))
+	{
+		std::error_code stat;
+		if (!it->is_regular_file(stat))
+			continue;
+
+#if defined(_WIN32)
+		FILE *file = _wfopen(it->path().c_str(), L"rb");
+#else
+		FILE *file = std::fopen(it->path().c_str(), "rb");
+#endif
+		if (!file)
+			continue;
+		size_t read;
+		while ((read = std::fread(buffer.data(), 1, buffer.size(), file)) > 0)
+		{
+			counters.bytes += read;
+		}
+		std::fclose(file);
+		++counters.files;
+	}
+	return counters;
+}
+
+PreloadReport MMPackagePreloader::Run(const std::vector<PreloadPackage> &packages)
+{
+	PreloadReport report;
+	if (m_mode == PreloadMode::Off || packages.empty())
+		return report;
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::mutex mutex;
+	std::atomic<size_t> next { 0 };
+	std::vector<PreloadTiming> timings;
+	auto worker = [&]
+	{
+		for (;;)
+		{
+			size_t index = next.fetch_add(1, std::memory_order_relaxed);
+			if (index >= packages.size())
+				break;
+
+			auto begin = std::chrono::steady_clock::now();
+			auto counters = Preload(packages[index]);
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+
+			std::lock_guard lock(mutex);
+			report.files += counters.files;
+			report.bytes += counters.bytes;
+			timings.push_back({ packages[index].name, elapsed });
+		}
+	};
+
+	size_t count = std::min(m_threads, packages.size());
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < count; ++i)
+	{
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (auto &thread : threads)
+	{
+		thread.join();
+	}
+
+	report.packages = timings.size();
+	report.elapsed = std::chrono::steady_clock::now() - start;
+	for (const auto &timing : timings)
+	{
+		report.serial += timing.elapsed;
+	}
+	std::sort(timings.begin(), timings.end(), [](const auto &a, const auto &b) { return a.elapsed > b.elapsed; });
+	timings.resize(std::min<size_t>(timings.size(), 5));
+	report.slowest = std::move(timings);
+	return report;
+}
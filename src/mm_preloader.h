@@ -0,0 +1,63 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace plugifyMM
+{
+	enum class PreloadMode
+	{
+		Off,
+		Files, // read package files into the page cache
+	};
+
+	struct PreloadPackage
+	{
+		std::string name;
+		std::filesystem::path directory;
+	};
+
+	struct PreloadTiming
+	{
+		std::string name;
+		std::chrono::duration<double, std::milli> elapsed;
+	};
+
+	struct PreloadReport
+	{
+		size_t packages { 0 };
+		size_t files { 0 };
+		uint64_t bytes { 0 };
+		std::chrono::duration<double, std::milli> elapsed {}; // wall time
+		std::chrono::duration<double, std::milli> serial {};  // sum of all packages
+		std::vector<PreloadTiming> slowest;
+	};
+
+	// Page-cache warmer: reads the files of modules and plugins on a worker pool before the
+	// plugin manager loads them one by one on the main thread. Reads have no ordering
+	// constraint, so workers take packages from one flat list; nothing here loads libraries
+	// or calls into the game or the core.
+	class MMPackagePreloader
+	{
+	public:
+		MMPackagePreloader(PreloadMode mode, size_t threads);
+
+		PreloadReport Run(const std::vector<PreloadPackage> &packages);
+
+	private:
+		struct Counters
+		{
+			size_t files { 0 };
+			uint64_t bytes { 0 };
+		};
+
+		Counters Preload(const PreloadPackage &package) const;
+
+	private:
+		PreloadMode m_mode;
+		size_t m_threads;
+	};
+} // namespace plugifyMM
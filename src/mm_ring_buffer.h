@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+
+namespace plugifyMM
+{
+	// Bounded lock-free queue (Vyukov). Safe for any number of producers and consumers,
+	// which lets a producer evict the oldest cell when the consumer falls behind.
+	template <typename T>
+	class MMRingBuffer
+	{
+	public:
+		explicit MMRingBuffer(size_t capacity) : m_mask(RoundUp(capacity) - 1), m_cells(std::make_unique<Cell[]>(m_mask + 1))
+		{
+			for (size_t i = 0; i <= m_mask; ++i)
+			{
+				m_cells[i].sequence.store(i, std::memory_order_relaxed);
+			}
+		}
+
+		MMRingBuffer(const MMRingBuffer &) = delete;
+		MMRingBuffer &operator=(const MMRingBuffer &) = delete;
+
+		template <typename F>
+		bool TryPush(F &&write)
+		{
+			size_t pos = m_enqueue.load(std::memory_order_relaxed);
+			Cell *cell;
+			for (;;)
+			{
+				cell = &m_cells[pos & m_mask];
+				size_t seq = cell->sequence.load(std::memory_order_acquire);
+				auto diff = static_cast<ptrdiff_t>(seq) - static_cast<ptrdiff_t>(pos);
+				if (diff == 0)
+				{
+					if (m_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+						break;
+				}
+				else if (diff < 0)
+				{
+					return false;
+				}
+				else
+				{
+					pos = m_enqueue.load(std::memory_order_relaxed);
+				}
+			}
+			write(cell->data);
+			cell->sequence.store(pos + 1, std::memory_order_release);
+			return true;
+		}
+
+		template <typename F>
+		bool TryPop(F &&read)
+		{
+			size_t pos = m_dequeue.load(std::memory_order_relaxed);
+			Cell *cell;
+			for (;;)
+			{
+				cell = &m_cells[pos & m_mask];
+				size_t seq = cell->sequence.load(std::memory_order_acquire);
+				auto diff = static_cast<ptrdiff_t>(seq) - static_cast<ptrdiff_t>(pos + 1);
+				if (diff == 0)
+				{
+					if (m_dequeue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+						break;
+				}
+				else if (diff < 0)
+				{
+					return false;
+				}
+				else
+				{
+					pos = m_dequeue.load(std::memory_order_relaxed);
+				}
+			}
+			read(cell->data);
+			cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+			return true;
+		}
+
+		size_t Capacity() const { return m_mask + 1; }
+
+		size_t SizeApprox() const
+		{
+			size_t enqueue = m_enqueue.load(std::memory_order_relaxed);
+			size_t dequeue = m_dequeue.load(std::memory_order_relaxed);
+			return enqueue > dequeue ? enqueue - dequeue : 0;
+		}
+
+	private:
+		static size_t RoundUp(size_t value)
+		{
+			size_t result = 2;
+			while (result < value)
+				result <<= 1;
+			return result;
+		}
+
+		struct Cell
+		{
+			std::atomic<size_t> sequence;
+			T data;
+		};
+
+		static constexpr size_t kCacheLine = 64;
+
+		const size_t m_mask;
+		std::unique_ptr<Cell[]> m_cells;
+		alignas(kCacheLine) std::atomic<size_t> m_enqueue { 0 };
+		alignas(kCacheLine) std::atomic<size_t> m_dequeue { 0 };
+	};
+} // namespace plugifyMM
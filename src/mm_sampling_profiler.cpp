@@ -0,0 +1,331 @@
+#include "mm_sampling_profiler.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <unordered_map>
+
+#include <plugify/compat_format.h>
+
+#if !defined(_WIN32)
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <pthread.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+using namespace plugifyMM;
+
+#if !defined(_WIN32) && !defined(__APPLE__) && (defined(__x86_64__) || defined(__aarch64__))
+#define PLUGIFY_FRAME_WALK 1
+#endif
+
+namespace
+{
+	MMSamplingProfiler *s_active = nullptr;
+} // namespace
+
+bool MMSamplingProfiler::IsSupported()
+{
+#if defined(PLUGIFY_FRAME_WALK)
+	return true;
+#else
+	return false;
+#endif
+}
+
+MMSamplingProfiler::~MMSamplingProfiler()
+{
+	Stop();
+}
+
+#if defined(PLUGIFY_FRAME_WALK)
+
+void MMSamplingProfiler::OnSignal(int, siginfo_t *, void *context)
+{
+	MMSamplingProfiler *profiler = s_active;
+	if (!profiler)
+		return;
+
+	size_t index = profiler->m_next.fetch_add(1, std::memory_order_relaxed);
+	if (index >= kMaxSamples)
+		return;
+
+	const auto &mcontext = static_cast<ucontext_t *>(context)->uc_mcontext;
+#if defined(__x86_64__)
+	auto pc = static_cast<uintptr_t>(mcontext.gregs[REG_RIP]);
+	auto fp = static_cast<uintptr_t>(mcontext.gregs[REG_RBP]);
+#else
+	auto pc = static_cast<uintptr_t>(mcontext.pc);
+	auto fp = static_cast<uintptr_t>(mcontext.regs[29]);
+#endif
+
+	Sample &sample = profiler->m_samples[index];
+	sample.frames[0] = reinterpret_cast<void *>(pc);
+	uint32_t depth = 1;
+	// Each frame starts with the caller's frame pointer followed by the return address. Frames
+	// only move towards the stack base, so anything outside it or out of order ends the walk.
+	while (depth < kMaxDepth && fp % sizeof(uintptr_t) == 0 && fp >= profiler->m_stackLow && fp + 2 * sizeof(uintptr_t) <= profiler->m_stackHigh)
+	{
+		const auto *frame = reinterpret_cast<const uintptr_t *>(fp);
+		if (frame[1] == 0)
+			break;
+		sample.frames[depth++] = reinterpret_cast<void *>(frame[1]);
+		if (frame[0] <= fp)
+			break;
+		fp = frame[0];
+	}
+	sample.depth = depth;
+}
+
+bool MMSamplingProfiler::Start(int frequency, std::string &error)
+{
+	if (m_running)
+	{
+		error = "profiler is already running";
+		return false;
+	}
+	if (frequency <= 0 || frequency > 1000)
+	{
+		error = "frequency must be between 1 and 1000 Hz";
+		return false;
+	}
+
+	// The handler reads frames only within this thread's stack.
+	pthread_attr_t attributes;
+	void *stack = nullptr;
+	size_t stackSize = 0;
+	if (pthread_getattr_np(pthread_self(), &attributes) != 0)
+	{
+		error = "cannot get the thread stack";
+		return false;
+	}
+	pthread_attr_getstack(&attributes, &stack, &stackSize);
+	pthread_attr_destroy(&attributes);
+	m_stackLow = reinterpret_cast<uintptr_t>(stack);
+	m_stackHigh = m_stackLow + stackSize;
+
+	m_samples = std::make_unique<Sample[]>(kMaxSamples);
+	m_next.store(0, std::memory_order_relaxed);
+
+	clockid_t clock;
+	if (pthread_getcpuclockid(pthread_self(), &clock) != 0)
+	{
+		error = "cannot get the thread CPU clock";
+		return false;
+	}
+
+	struct sigaction action {};
+	action.sa_sigaction = &MMSamplingProfiler::OnSignal;
+	action.sa_flags = SA_SIGINFO | SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	s_active = this;
+	sigaction(SIGPROF, &action, &m_previous);
+
+	struct sigevent event {};
+	event.sigev_notify = SIGEV_THREAD_ID;
+	event.sigev_signo = SIGPROF;
+	event._sigev_un._tid = static_cast<pid_t>(syscall(SYS_gettid));
+	if (timer_create(clock, &event, &m_timer) != 0)
+	{
+		sigaction(SIGPROF, &m_previous, nullptr);
+		s_active = nullptr;
+		error = "cannot create the sampling timer";
+		return false;
+	}
+
+	long interval = 1000000000L / frequency;
+	struct itimerspec spec {};
+	spec.it_interval.tv_sec = interval / 1000000000L;
+	spec.it_interval.tv_nsec = interval % 1000000000L;
+	spec.it_value = spec.it_interval;
+	timer_settime(m_timer, 0, &spec, nullptr);
+
+	m_running = true;
+	return true;
+}
+
+void MMSamplingProfiler::Stop()
+{
+	if (!m_running)
+		return;
+
+	timer_delete(m_timer);
+	sigaction(SIGPROF, &m_previous, nullptr);
+	s_active = nullptr;
+	m_running = false;
+}
+
+std::vector<std::vector<const MMSamplingProfiler::Frame *>> MMSamplingProfiler::Symbolize(std::span<const ProfileImage> images, std::vector<std::unique_ptr<Frame>> &frames) const
+{
+	std::vector<ProfileImage> canonical;
+	for (const auto &image : images)
+	{
+		std::error_code ec;
+		auto path = std::filesystem::weakly_canonical(image.path, ec);
+		canonical.push_back({ ec ? image.path : path, image.label });
+	}
+
+	std::unordered_map<const void *, const Frame *> cache;
+	auto resolve = [&](void *address) -> const Frame *
+	{
+		auto [it, inserted] = cache.emplace(address, nullptr);
+		if (!inserted)
+			return it->second;
+
+		auto &frame = *frames.emplace_back(std::make_unique<Frame>());
+		it->second = &frame;
+
+		Dl_info info {};
+		if (!dladdr(address, &info) || !info.dli_fname)
+		{
+			frame.image = "[unknown]";
+			frame.name = std::format("[unknown]`{}", address);
+			return &frame;
+		}
+
+		std::error_code ec;
+		auto library = std::filesystem::weakly_canonical(info.dli_fname, ec);
+		if (ec)
+			library = info.dli_fname;
+		frame.image = library.filename().string();
+		for (const auto &image : canonical)
+		{
+			const auto &path = image.path.native();
+			const auto &file = library.native();
+			if (file == path || (file.size() > path.size() && file.starts_with(path) && file[path.size()] == '/'))
+			{
+				frame.image = image.label;
+				break;
+			}
+		}
+
+		std::string symbol;
+		if (info.dli_sname)
+		{
+			int status = 0;
+			char *demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+			symbol = status == 0 && demangled ? demangled : info.dli_sname;
+			std::free(demangled);
+		}
+		else
+		{
+			symbol = std::format("+{:#x}", static_cast<const char *>(address) - static_cast<const char *>(info.dli_fbase));
+		}
+		// Folded stacks use ';' between frames and ' ' before the count.
+		std::replace(symbol.begin(), symbol.end(), ';', ':');
+		std::replace(symbol.begin(), symbol.end(), ' ', '_');
+		frame.name = std::format("{}`{}", frame.image, symbol);
+		return &frame;
+	};
+
+	std::vector<std::vector<const Frame *>> stacks;
+	size_t count = GetSampleCount();
+	stacks.reserve(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		const Sample &sample = m_samples[i];
+		auto &stack = stacks.emplace_back();
+		// Return addresses point past the call; step back into it for symbol lookup.
+		for (uint32_t j = 0; j < sample.depth; ++j)
+		{
+			stack.push_back(resolve(static_cast<char *>(sample.frames[j]) - (j ? 1 : 0)));
+		}
+	}
+	return stacks;
+}
+
+#else
+
+bool MMSamplingProfiler::Start(int, std::string &error)
+{
+	error = "sampling is only supported on Linux x86-64 and AArch64";
+	return false;
+}
+
+void MMSamplingProfiler::Stop()
+{
+}
+
+std::vector<std::vector<const MMSamplingProfiler::Frame *>> MMSamplingProfiler::Symbolize(std::span<const ProfileImage>, std::vector<std::unique_ptr<Frame>> &) const
+{
+	return {};
+}
+
+#endif
+
+bool MMSamplingProfiler::WriteFolded(const std::filesystem::path &file, std::span<const ProfileImage> images, std::string &error) const
+{
+	std::vector<std::unique_ptr<Frame>> frames;
+	std::map<std::string, size_t> folded;
+	for (const auto &stack : Symbolize(images, frames))
+	{
+		std::string line;
+		for (auto it = stack.rbegin(); it != stack.rend(); ++it)
+		{
+			if (!line.empty())
+				line += ';';
+			line += (*it)->name;
+		}
+		if (!line.empty())
+			++folded[std::move(line)];
+	}
+
+	std::error_code ec;
+	std::filesystem::create_directories(file.parent_path(), ec);
+	std::ofstream stream(file, std::ios::trunc);
+	for (const auto &[stack, count] : folded)
+	{
+		stream << stack << ' ' << count << '\n';
+	}
+	if (!stream)
+	{
+		error = std::format("cannot write {}", file.string());
+		return false;
+	}
+	return true;
+}
+
+std::string MMSamplingProfiler::Format(std::span<const ProfileImage> images, size_t top) const
+{
+	struct Counts
+	{
+		size_t self { 0 };
+		size_t total { 0 };
+	};
+
+	std::vector<std::unique_ptr<Frame>> frames;
+	auto stacks = Symbolize(images, frames);
+	std::unordered_map<std::string_view, Counts> counts;
+	for (const auto &stack : stacks)
+	{
+		if (stack.empty())
+			continue;
+		++counts[stack.front()->image].self;
+
+		std::vector<std::string_view> seen;
+		for (const Frame *frame : stack)
+		{
+			if (std::find(seen.begin(), seen.end(), frame->image) != seen.end())
+				continue;
+			seen.push_back(frame->image);
+			++counts[frame->image].total;
+		}
+	}
+
+	std::vector<std::pair<std::string_view, Counts>> sorted(counts.begin(), counts.end());
+	std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) { return a.second.self > b.second.self; });
+	sorted.resize(std::min(sorted.size(), top));
+
+	std::string out = std::format("{} samples ({} dropped):\n", stacks.size(), GetDropped());
+	std::format_to(std::back_inserter(out), "  {:<40} {:>7} {:>7}\n", "", "self", "total");
+	for (const auto &[image, count] : sorted)
+	{
+		double total = static_cast<double>(std::max<size_t>(stacks.size(), 1));
+		std::format_to(std::back_inserter(out), "  {:<40} {:>6.1f}% {:>6.1f}%\n", image, 100.0 * static_cast<double>(count.self) / total, 100.0 * static_cast<double>(count.total) / total);
+	}
+	return out;
+}
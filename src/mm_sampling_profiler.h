@@ -0,0 +1,85 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <csignal>
+#include <ctime>
+#endif
+
+namespace plugifyMM
+{
+	// Code that plugify loaded: a module library or a plugin directory.
+	struct ProfileImage
+	{
+		std::filesystem::path path; // library file, or a directory matched as a prefix
+		std::string label;          // e.g. "module:cpp", "plugin:admin"
+	};
+
+	// Samples the call stack of the thread that called Start() on its CPU-time clock, so idle
+	// time between ticks is not sampled. Nothing is installed while stopped. The handler only
+	// follows frame pointers within that thread's stack, which is async-signal-safe unlike
+	// backtrace(); code built without them still gets its own frame, with a shorter stack.
+	// Stacks are only symbolized after Stop(), off the signal handler.
+	class MMSamplingProfiler
+	{
+	public:
+		static constexpr size_t kMaxDepth = 48;
+		static constexpr size_t kMaxSamples = 32768;
+
+		static bool IsSupported();
+
+		MMSamplingProfiler() = default;
+		~MMSamplingProfiler();
+
+		bool Start(int frequency, std::string &error);
+		void Stop();
+		bool IsRunning() const { return m_running; }
+
+		size_t GetSampleCount() const { return std::min(m_next.load(std::memory_order_acquire), kMaxSamples); }
+		size_t GetDropped() const { return m_next.load(std::memory_order_acquire) > kMaxSamples ? m_next.load(std::memory_order_acquire) - kMaxSamples : 0; }
+
+		// Folded stacks, root first: "label`symbol;label`symbol <count>", for flamegraph.pl or speedscope.
+		bool WriteFolded(const std::filesystem::path &file, std::span<const ProfileImage> images, std::string &error) const;
+
+		// Self and total share of the busiest images.
+		std::string Format(std::span<const ProfileImage> images, size_t top) const;
+
+	private:
+		struct Sample
+		{
+			uint32_t depth;
+			void *frames[kMaxDepth];
+		};
+
+		struct Frame
+		{
+			std::string image; // plugify label, or the library file name
+			std::string name;  // image`symbol
+		};
+
+		std::vector<std::vector<const Frame *>> Symbolize(std::span<const ProfileImage> images, std::vector<std::unique_ptr<Frame>> &frames) const;
+
+#if !defined(_WIN32)
+		static void OnSignal(int sig, siginfo_t *info, void *context);
+#endif
+
+	private:
+		std::unique_ptr<Sample[]> m_samples;
+		std::atomic<size_t> m_next { 0 };
+		bool m_running { false };
+		uintptr_t m_stackLow { 0 };
+		uintptr_t m_stackHigh { 0 };
+#if !defined(_WIN32)
+		timer_t m_timer {};
+		struct sigaction m_previous {};
+#endif
+	};
+} // namespace plugifyMM
@@ -0,0 +1,97 @@
+#include "mm_settings.h"
+
+#include <charconv>
+
+#include <plugify/compat_format.h>
+
+using namespace plugifyMM;
+
+MMSettings::MMSettings()
+{
+	m_entries = {
+		{ "download_parallel", "Concurrent package downloads", int64_t{ 4 } },
+		{ "download_host_connections", "Concurrent connections per repository host", int64_t{ 4 } },
+		{ "download_retries", "Retries for failed downloads", int64_t{ 3 } },
+		{ "download_backoff_ms", "Initial retry backoff, doubled on each attempt", int64_t{ 500 } },
+		{ "download_timeout_s", "Timeout for a single download", int64_t{ 300 } },
+		{ "download_streaming", "Extract package archives while they download (1) or after (0)", int64_t{ 1 } },
+		{ "store_dir", "Host-wide package store shared by all instances (empty disables)", std::string() },
+		{ "store_link", "How packages are taken from the store: reflink (copy where unsupported), copy, or hardlink (files shared, edits reach every instance)", std::string("reflink") },
+		{ "verify_threads", "Threads used to hash package files (0 uses every core)", int64_t{ 2 } },
+		{ "manifest_ttl_s", "Seconds a cached repository manifest is used without revalidation", int64_t{ 3600 } },
+		{ "offline", "Use cached repository manifests only (1) or fetch them (0)", int64_t{ 0 } },
+		{ "preload", "Before loading plugins: 0 off, 1 read package files into the page cache", int64_t{ 0 } },
+		{ "preload_threads", "Threads reading package files (0 uses every core)", int64_t{ 0 } },
+		{ "mem_sample_bytes", "Allocator shims report one allocation per this many bytes (0 reports all)", int64_t{ 0 } },
+		{ "metrics_address", "Prometheus exporter: unix:<path>, <port> or 127.0.0.1:<port> (empty disables)", std::string() },
+		{ "search_page_size", "Packages per page in query and search output", int64_t{ 20 } },
+	};
+}
+
+int64_t MMSettings::GetInt(std::string_view name) const
+{
+	std::lock_guard lock(m_mutex);
+	const Entry *entry = Find(name);
+	return entry && std::holds_alternative<int64_t>(entry->value) ? std::get<int64_t>(entry->value) : 0;
+}
+
+std::string MMSettings::GetString(std::string_view name) const
+{
+	std::lock_guard lock(m_mutex);
+	const Entry *entry = Find(name);
+	return entry && std::holds_alternative<std::string>(entry->value) ? std::get<std::string>(entry->value) : std::string();
+}
+
+bool MMSettings::Set(std::string_view name, std::string_view value, std::string &error)
+{
+	std::lock_guard lock(m_mutex);
+	Entry *entry = Find(name);
+	if (!entry)
+	{
+		error = std::format("Unknown setting: {}", name);
+		return false;
+	}
+
+	if (std::holds_alternative<int64_t>(entry->value))
+	{
+		int64_t number = 0;
+		auto result = std::from_chars(value.data(), value.data() + value.size(), number);
+		if (result.ec != std::errc() || result.ptr != value.data() + value.size() || number < 0)
+		{
+			error = std::format("{} expects a non-negative integer", name);
+			return false;
+		}
+		entry->value = number;
+	}
+	else
+	{
+		entry->value = std::string(value);
+	}
+	return true;
+}
+
+std::vector<MMSettings::Entry> MMSettings::GetEntries() const
+{
+	std::lock_guard lock(m_mutex);
+	return m_entries;
+}
+
+MMSettings::Entry *MMSettings::Find(std::string_view name)
+{
+	for (auto &entry : m_entries)
+	{
+		if (entry.name == name)
+			return &entry;
+	}
+	return nullptr;
+}
+
+const MMSettings::Entry *MMSettings::Find(std::string_view name) const
+{
+	for (const auto &entry : m_entries)
+	{
+		if (entry.name == name)
+			return &entry;
+	}
+	return nullptr;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace plugifyMM
+{
+	// Runtime tunables changed with 'plugify set <name> <value>'.
+	class MMSettings
+	{
+	public:
+		struct Entry
+		{
+			std::string_view name;
+			std::string_view description;
+			std::variant<int64_t, std::string> value;
+		};
+
+		MMSettings();
+
+		int64_t GetInt(std::string_view name) const;
+		std::string GetString(std::string_view name) const;
+		bool Set(std::string_view name, std::string_view value, std::string &error);
+		std::vector<Entry> GetEntries() const;
+
+	private:
+		Entry *Find(std::string_view name);
+		const Entry *Find(std::string_view name) const;
+
+	private:
+		mutable std::mutex m_mutex;
+		std::vector<Entry> m_entries;
+	};
+} // namespace plugifyMM
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace plugifyMM
+{
+	// Incremental SHA-256, fed as data arrives.
+	class MMSha256
+	{
+	public:
+		using Digest = std::array<uint8_t, 32>;
+
+		MMSha256();
+
+		void Update(const void *data, size_t size);
+		Digest Final();
+
+		static std::string ToHex(const Digest &digest);
+
+	private:
+		void Transform(const uint8_t *block);
+
+	private:
+		std::array<uint32_t, 8> m_state;
+		std::array<uint8_t, 64> m_block;
+		size_t m_blockSize { 0 };
+		uint64_t m_length { 0 };
+	};
+} // namespace plugifyMM
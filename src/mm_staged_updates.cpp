@@ -0,0 +1,165 @@
+#include "mm_staged_updates.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <plugify/compat_format.h>
+#include <plugify/package.h>
+
+using namespace plugifyMM;
+
+static constexpr std::string_view kStagedList = "staged.txt";
+
+MMStagedUpdates::MMStagedUpdates(std::filesystem::path dir) : m_dir(std::move(dir))
+{
+	// "<name> <version> <destination>", left behind when the server stopped before a swap
+	std::ifstream stream(m_dir / kStagedList);
+	std::string line;
+	while (std::getline(stream, line))
+	{
+		std::istringstream fields(line);
+		StagedPackage package;
+		std::string destination;
+		if (!(fields >> package.name >> package.version >> std::ws) || !std::getline(fields, destination))
+			continue;
+
+		std::error_code ec;
+		if (!std::filesystem::is_directory(GetParked(package), ec))
+			continue;
+		package.destination = destination;
+		m_pending.push_back(std::move(package));
+	}
+}
+
+std::filesystem::path MMStagedUpdates::GetParked(const StagedPackage &package) const
+{
+	return m_dir / std::format("{}-{}", package.name, package.version);
+}
+
+void MMStagedUpdates::Stage(const PackageDownload &download)
+{
+	std::error_code ec;
+	std::filesystem::create_directories(m_dir, ec);
+	StagedPackage staged { download.name, download.version, download.destination };
+	auto parked = GetParked(staged);
+	std::filesystem::remove_all(parked, ec);
+	std::filesystem::rename(MMPackageInstaller::GetStaging(download), parked, ec);
+	if (ec)
+	{
+		std::filesystem::remove_all(MMPackageInstaller::GetStaging(download), ec);
+		throw std::runtime_error(std::format("{}: cannot stage into {}", download.name, parked.string()));
+	}
+
+	std::scoped_lock lock(m_mutex);
+	std::erase_if(m_pending, [&](const StagedPackage &package)
+	{
+		if (package.name != download.name)
+			return false;
+		if (package.version != download.version)
+			std::filesystem::remove_all(GetParked(package), ec);
+		return true;
+	});
+	m_pending.push_back(std::move(staged));
+	Save();
+}
+
+std::vector<StagedPackage> MMStagedUpdates::GetPending() const
+{
+	std::scoped_lock lock(m_mutex);
+	return m_pending;
+}
+
+bool MMStagedUpdates::HasPending() const
+{
+	std::scoped_lock lock(m_mutex);
+	return !m_pending.empty();
+}
+
+bool MMStagedUpdates::Preview(std::vector<plugify::LocalPackage> &packages, std::string &error) const
+{
+	std::scoped_lock lock(m_mutex);
+	for (const auto &staged : m_pending)
+	{
+		auto it = std::find_if(packages.begin(), packages.end(), [&](const plugify::LocalPackage &package) { return package.name == staged.name; });
+		if (it == packages.end())
+		{
+			error = std::format("{} is no longer installed", staged.name);
+			return false;
+		}
+
+		auto manifest = GetParked(staged) / it->path.filename();
+		std::error_code ec;
+		if (!std::filesystem::is_regular_file(manifest, ec))
+		{
+			error = std::format("{}: staged tree has no {}", staged.name, it->path.filename().string());
+			return false;
+		}
+		it->path = std::move(manifest);
+		it->version = staged.version;
+	}
+	return true;
+}
+
+size_t MMStagedUpdates::Apply(const MMPackageInstaller &installer, std::vector<std::string> &errors)
+{
+	std::scoped_lock lock(m_mutex);
+	size_t applied = 0;
+	for (const auto &package : m_pending)
+	{
+		PackageDownload download;
+		download.name = package.name;
+		download.version = package.version;
+		download.destination = package.destination;
+
+		std::error_code ec;
+		std::filesystem::rename(GetParked(package), MMPackageInstaller::GetStaging(download), ec);
+		if (ec)
+		{
+			errors.push_back(std::format("{}: {}", package.name, ec.message()));
+			continue;
+		}
+
+		try
+		{
+			installer.Commit(download);
+			++applied;
+		}
+		catch (const std::exception &e)
+		{
+			errors.emplace_back(e.what());
+		}
+	}
+	m_pending.clear();
+	Save();
+	return applied;
+}
+
+void MMStagedUpdates::Discard()
+{
+	std::scoped_lock lock(m_mutex);
+	std::error_code ec;
+	for (const auto &package : m_pending)
+	{
+		std::filesystem::remove_all(GetParked(package), ec);
+	}
+	m_pending.clear();
+	Save();
+}
+
+void MMStagedUpdates::Save() const
+{
+	std::error_code ec;
+	if (m_pending.empty())
+	{
+		std::filesystem::remove(m_dir / kStagedList, ec);
+		return;
+	}
+
+	std::ofstream stream(m_dir / kStagedList, std::ios::trunc);
+	for (const auto &package : m_pending)
+	{
+		stream << std::format("{} {} {}\n", package.name, package.version, package.destination.string());
+	}
+}
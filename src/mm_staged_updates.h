@@ -0,0 +1,57 @@
+#pragma once
+
+#include "mm_package_installer.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace plugify
+{
+	struct LocalPackage;
+}
+
+namespace plugifyMM
+{
+	struct StagedPackage
+	{
+		std::string name;
+		int32_t version { 0 };
+		std::filesystem::path destination;
+	};
+
+	// Updates downloaded and verified while plugins keep running. Staged trees are parked
+	// outside the package directories as <name>-<version>, where the plugin manager cannot
+	// discover them, and swapped into place by Apply() at the next safe point.
+	class MMStagedUpdates
+	{
+	public:
+		explicit MMStagedUpdates(std::filesystem::path dir);
+
+		// Moves a package unpacked by MMPackageInstaller out of the tree. Called from job threads.
+		void Stage(const PackageDownload &download);
+
+		std::vector<StagedPackage> GetPending() const;
+		bool HasPending() const;
+
+		// Rewrites the installed packages to point at the staged manifests, so dependencies can
+		// be checked before anything is swapped. Fails if a staged package is no longer installed
+		// or its tree lacks the manifest.
+		bool Preview(std::vector<plugify::LocalPackage> &packages, std::string &error) const;
+
+		// Commits every staged package; failures are reported in 'errors' and dropped.
+		size_t Apply(const MMPackageInstaller &installer, std::vector<std::string> &errors);
+		void Discard();
+
+	private:
+		std::filesystem::path GetParked(const StagedPackage &package) const;
+		void Save() const;
+
+	private:
+		std::filesystem::path m_dir;
+		mutable std::mutex m_mutex;
+		std::vector<StagedPackage> m_pending;
+	};
+} // namespace plugifyMM
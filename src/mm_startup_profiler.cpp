@@ -0,0 +1,192 @@
+#include "mm_startup_profiler.h"
+#include "mm_json.h"
+#include "mm_metrics.h"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+
+#include <plugify/compat_format.h>
+
+using namespace plugifyMM;
+
+void MMStartupProfiler::Start()
+{
+	std::lock_guard lock(m_mutex);
+	m_spans.clear();
+	m_marks.clear();
+	m_depth = 0;
+	m_origin = Clock::now();
+	m_recording.store(true, std::memory_order_relaxed);
+}
+
+void MMStartupProfiler::Stop()
+{
+	m_recording.store(false, std::memory_order_relaxed);
+}
+
+size_t MMStartupProfiler::Begin(std::string name)
+{
+	std::lock_guard lock(m_mutex);
+	auto now = Clock::now();
+	m_spans.push_back({ std::move(name), "phase", now, now, m_depth++ });
+	return m_spans.size() - 1;
+}
+
+void MMStartupProfiler::End(size_t span)
+{
+	std::lock_guard lock(m_mutex);
+	if (span >= m_spans.size())
+		return;
+	m_spans[span].end = Clock::now();
+	--m_depth;
+}
+
+void MMStartupProfiler::Mark(std::string_view text)
+{
+	if (!IsRecording())
+		return;
+
+	while (!text.empty() && (text.back() == '\n' || text.back() == '\r'))
+		text.remove_suffix(1);
+
+	auto now = Clock::now();
+	std::lock_guard lock(m_mutex);
+	m_marks.push_back({ now, std::string(text) });
+}
+
+void MMStartupProfiler::Attribute(size_t span, std::span<const ProfileItem> items)
+{
+	std::lock_guard lock(m_mutex);
+	if (span >= m_spans.size())
+		return;
+
+	Span phase = m_spans[span];
+	auto previous = phase.start;
+	for (const auto &mark : m_marks)
+	{
+		if (mark.time < phase.start || mark.time > phase.end)
+			continue;
+
+		// Longest name wins, so "cpp" does not claim lines about "cpp-utils".
+		const ProfileItem *owner = nullptr;
+		for (const auto &item : items)
+		{
+			if ((!owner || item.name.size() > owner->name.size()) && mark.text.find(item.name) != std::string::npos)
+				owner = &item;
+		}
+		if (!owner)
+			continue;
+
+		m_spans.push_back({ owner->name, owner->category, previous, mark.time, phase.depth + 1 });
+		previous = mark.time;
+	}
+}
+
+std::string MMStartupProfiler::Format(size_t top) const
+{
+	std::lock_guard lock(m_mutex);
+	if (m_spans.empty())
+		return "No startup profile recorded.\n";
+
+	auto milliseconds = [](Clock::duration duration) { return std::chrono::duration<double, std::milli>(duration).count(); };
+
+	std::string sMessage = "Startup phases:\n";
+	for (const auto &span : m_spans)
+	{
+		if (span.category == "phase")
+			std::format_to(std::back_inserter(sMessage), "  {:>{}}{:<{}} {:>10.1f} ms\n", "", span.depth * 2, span.name, 36 - span.depth * 2, milliseconds(span.end - span.start));
+	}
+
+	std::map<std::pair<std::string, std::string>, Clock::duration> totals;
+	for (const auto &span : m_spans)
+	{
+		if (span.category != "phase")
+			totals[{ span.category, span.name }] += span.end - span.start;
+	}
+	if (!totals.empty())
+	{
+		std::vector<std::pair<std::pair<std::string, std::string>, Clock::duration>> sorted(totals.begin(), totals.end());
+		std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b) { return a.second > b.second; });
+		if (sorted.size() > top)
+			sorted.resize(top);
+
+		sMessage += "Slowest modules and plugins (estimated from the timing of core log lines, not measured):\n";
+		for (const auto &[key, duration] : sorted)
+		{
+			std::format_to(std::back_inserter(sMessage), "  {:<8}{:<30} ~{:>9.1f} ms\n", key.first, key.second, milliseconds(duration));
+		}
+	}
+	std::format_to(std::back_inserter(sMessage), "{} log marks recorded.\n", m_marks.size());
+	return sMessage;
+}
+
+void MMStartupProfiler::FormatMetrics(std::string &out) const
+{
+	std::lock_guard lock(m_mutex);
+	std::map<std::pair<std::string, std::string>, Clock::duration> phases;
+	std::map<std::pair<std::string, std::string>, Clock::duration> totals;
+	for (const auto &span : m_spans)
+	{
+		auto &target = span.category == "phase" ? phases : totals;
+		target[{ span.category, span.name }] += span.end - span.start;
+	}
+
+	out += "# HELP plugify_startup_phase_seconds Duration of each phase of the last plugify load.\n# TYPE plugify_startup_phase_seconds gauge\n";
+	for (const auto &[key, duration] : phases)
+	{
+		out += "plugify_startup_phase_seconds{phase=\"";
+		AppendMetricLabel(out, key.second);
+		std::format_to(std::back_inserter(out), "\"}} {}\n", std::chrono::duration<double>(duration).count());
+	}
+	out += "# HELP plugify_load_estimate_seconds Estimated time the last load spent on each module and plugin, inferred from core log lines.\n# TYPE plugify_load_estimate_seconds gauge\n";
+	for (const auto &[key, duration] : totals)
+	{
+		out += "plugify_load_estimate_seconds{category=\"";
+		AppendMetricLabel(out, key.first);
+		out += "\",name=\"";
+		AppendMetricLabel(out, key.second);
+		std::format_to(std::back_inserter(out), "\"}} {}\n", std::chrono::duration<double>(duration).count());
+	}
+}
+
+bool MMStartupProfiler::WriteChromeTrace(const std::filesystem::path &file, std::string &error) const
+{
+	std::string json;
+	{
+		std::lock_guard lock(m_mutex);
+		json.reserve(256 * (m_spans.size() + m_marks.size()) + 64);
+		json += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+		bool first = true;
+		for (const auto &span : m_spans)
+		{
+			json += first ? "" : ",";
+			first = false;
+			json += "{\"name\":";
+			AppendJsonString(json, span.category == "phase" ? span.name : std::format("{} (estimate)", span.name));
+			json += ",\"cat\":";
+			AppendJsonString(json, span.category);
+			std::format_to(std::back_inserter(json), ",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":{:.3f},\"dur\":{:.3f}}}", ToMicroseconds(span.start), ToMicroseconds(span.end) - ToMicroseconds(span.start));
+		}
+		for (const auto &mark : m_marks)
+		{
+			json += first ? "" : ",";
+			first = false;
+			json += "{\"name\":";
+			AppendJsonString(json, mark.text);
+			std::format_to(std::back_inserter(json), ",\"cat\":\"log\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":1,\"ts\":{:.3f}}}", ToMicroseconds(mark.time));
+		}
+		json += "]}\n";
+	}
+
+	std::error_code ec;
+	std::filesystem::create_directories(file.parent_path(), ec);
+	std::ofstream stream(file, std::ios::binary | std::ios::trunc);
+	stream.write(json.data(), static_cast<std::streamsize>(json.size()));
+	if (!stream)
+	{
+		error = std::format("cannot write {}", file.string());
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace plugifyMM
+{
+	struct ProfileItem
+	{
+		std::string name;
+		std::string category; // "module" or "plugin"
+	};
+
+	// Timeline of plugify startup. Phases are timed explicitly around the calls made from
+	// Load(); inside a phase, time between consecutive core log lines is charged to the
+	// module or plugin the later line names, since the core loads them without callbacks.
+	// Only the phases are measured; per-module and per-plugin times are estimates and are
+	// labelled as such wherever they are shown.
+	class MMStartupProfiler
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		// Clears the previous profile and starts taking log lines as marks.
+		void Start();
+		void Stop();
+		bool IsRecording() const { return m_recording.load(std::memory_order_relaxed); }
+
+		size_t Begin(std::string name);
+		void End(size_t span);
+
+		// Called for every core log line; ignored unless recording.
+		void Mark(std::string_view text);
+
+		// Estimates how the time of a finished phase splits between the given items.
+		void Attribute(size_t span, std::span<const ProfileItem> items);
+
+		std::string Format(size_t top) const;
+		// Prometheus gauges for the last profiled load.
+		void FormatMetrics(std::string &out) const;
+		bool WriteChromeTrace(const std::filesystem::path &file, std::string &error) const;
+
+	private:
+		struct Span
+		{
+			std::string name;
+			std::string category;
+			Clock::time_point start;
+			Clock::time_point end;
+			int depth;
+		};
+
+		struct LogMark
+		{
+			Clock::time_point time;
+			std::string text;
+		};
+
+		double ToMicroseconds(Clock::time_point time) const { return std::chrono::duration<double, std::micro>(time - m_origin).count(); }
+
+	private:
+		mutable std::mutex m_mutex;
+		std::atomic<bool> m_recording { false };
+		Clock::time_point m_origin;
+		std::vector<Span> m_spans;
+		std::vector<LogMark> m_marks;
+		int m_depth { 0 };
+	};
+
+	// Times the enclosing block as one startup phase.
+	class MMProfileScope
+	{
+	public:
+		MMProfileScope(MMStartupProfiler &profiler, std::string name) : m_profiler(profiler), m_span(profiler.Begin(std::move(name))) {}
+		~MMProfileScope() { m_profiler.End(m_span); }
+
+		size_t GetSpan() const { return m_span; }
+
+		MMProfileScope(const MMProfileScope &) = delete;
+		MMProfileScope &operator=(const MMProfileScope &) = delete;
+
+	private:
+		MMStartupProfiler &m_profiler;
+		size_t m_span;
+	};
+} // namespace plugifyMM
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace plugifyMM
+{
+	// Transparent hash so string-keyed maps can be searched with string_view without allocating.
+	struct StringHash
+	{
+		using is_transparent = void;
+		size_t operator()(std::string_view str) const { return std::hash<std::string_view>{}(str); }
+	};
+} // namespace plugifyMM
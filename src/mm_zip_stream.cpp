@@ -0,0 +1,353 @@
+#include "mm_zip_stream.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <miniz.h>
+
+#include <plugify/compat_format.h>
+
+using namespace plugifyMM;
+
+static constexpr uint32_t kLocalHeader = 0x04034b50;
+static constexpr uint32_t kCentralHeader = 0x02014b50;
+static constexpr uint32_t kEndOfCentral = 0x06054b50;
+static constexpr uint32_t kDescriptor = 0x08074b50;
+static constexpr size_t kLocalHeaderSize = 30;
+
+static uint16_t Read16(const uint8_t *p)
+{
+	return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+static uint32_t Read32(const uint8_t *p)
+{
+	return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+static uint64_t Read64(const uint8_t *p)
+{
+	return uint64_t(Read32(p)) | (uint64_t(Read32(p + 4)) << 32);
+}
+
+struct MMZipStreamExtractor::Inflater
+{
+	mz_stream stream {};
+	bool ended { false };
+	uint8_t out[64 * 1024];
+
+	Inflater() { mz_inflateInit2(&stream, -MZ_DEFAULT_WINDOW_BITS); }
+	~Inflater() { mz_inflateEnd(&stream); }
+};
+
+MMZipStreamExtractor::MMZipStreamExtractor(std::filesystem::path directory) : m_directory(std::move(directory))
+{
+	Reset();
+}
+
+MMZipStreamExtractor::~MMZipStreamExtractor()
+{
+	CloseFile();
+}
+
+void MMZipStreamExtractor::Reset()
+{
+	CloseFile();
+	m_inflater.reset();
+	m_pending.clear();
+	m_needed = 4;
+	m_state = State::Signature;
+	m_entries = 0;
+	m_error.clear();
+
+	std::error_code ec;
+	std::filesystem::remove_all(m_directory, ec);
+	std::filesystem::create_directories(m_directory, ec);
+	if (ec)
+		Fail(std::format("cannot create {}: {}", m_directory.string(), ec.message()));
+}
+
+bool MMZipStreamExtractor::Fail(std::string error)
+{
+	CloseFile();
+	m_inflater.reset();
+	m_error = std::move(error);
+	m_state = State::Failed;
+	return false;
+}
+
+void MMZipStreamExtractor::CloseFile()
+{
+	if (m_file)
+	{
+		std::fclose(m_file);
+		m_file = nullptr;
+	}
+}
+
+bool MMZipStreamExtractor::Finish()
+{
+	if (m_state == State::Done)
+		return true;
+	if (m_state != State::Failed)
+		Fail(m_entries ? "archive is truncated" : "archive is empty or not a zip file");
+	return false;
+}
+
+bool MMZipStreamExtractor::Write(const char *data, size_t size)
+{
+	auto *bytes = reinterpret_cast<const uint8_t *>(data);
+	while (size)
+	{
+		switch (m_state)
+		{
+			case State::Done:
+				// Central directory and trailer: everything we need is already on disk.
+				return true;
+			case State::Failed:
+				return false;
+			case State::Data:
+			{
+				size_t used = 0;
+				if (!FeedData(bytes, size, used))
+					return false;
+				bytes += used;
+				size -= used;
+				continue;
+			}
+			default:
+				break;
+		}
+
+		size_t take = std::min(size, m_needed - m_pending.size());
+		m_pending.insert(m_pending.end(), bytes, bytes + take);
+		bytes += take;
+		size -= take;
+
+		while (m_pending.size() >= m_needed && m_state != State::Data && m_state != State::Done && m_state != State::Failed)
+		{
+			const uint8_t *p = m_pending.data();
+			switch (m_state)
+			{
+				case State::Signature:
+				{
+					uint32_t signature = Read32(p);
+					if (signature == kLocalHeader)
+					{
+						m_state = State::Header;
+						m_needed = kLocalHeaderSize;
+					}
+					else if (signature == kCentralHeader || signature == kEndOfCentral)
+					{
+						m_state = State::Done;
+					}
+					else
+					{
+						return Fail(std::format("unexpected signature {:08x} after {} entries", signature, m_entries));
+					}
+					break;
+				}
+				case State::Header:
+					m_state = State::Name;
+					m_needed = kLocalHeaderSize + Read16(p + 26) + Read16(p + 28);
+					break;
+				case State::Name:
+					if (!BeginEntry())
+						return false;
+					break;
+				case State::Descriptor:
+				{
+					// Optional signature, then CRC-32 and the two sizes (8 bytes each for zip64).
+					bool signature = Read32(p) == kDescriptor;
+					size_t length = (signature ? 4 : 0) + 4 + (m_zip64 ? 16 : 8);
+					if (m_needed < length)
+					{
+						m_needed = length;
+						break;
+					}
+					if (!EndEntry(Read32(p + (signature ? 4 : 0))))
+						return false;
+					break;
+				}
+				default:
+					break;
+			}
+		}
+	}
+	return m_state != State::Failed;
+}
+
+bool MMZipStreamExtractor::BeginEntry()
+{
+	const uint8_t *p = m_pending.data();
+	m_flags = Read16(p + 6);
+	m_method = Read16(p + 8);
+	m_crc = Read32(p + 14);
+	m_compressed = Read32(p + 18);
+	uint64_t uncompressed = Read32(p + 22);
+	uint16_t nameLength = Read16(p + 26);
+	uint16_t extraLength = Read16(p + 28);
+	m_name.assign(reinterpret_cast<const char *>(p + kLocalHeaderSize), nameLength);
+
+	// Zip64 extended information replaces sizes stored as 0xFFFFFFFF.
+	m_zip64 = false;
+	const uint8_t *extra = p + kLocalHeaderSize + nameLength;
+	for (size_t offset = 0; offset + 4 <= extraLength;)
+	{
+		uint16_t id = Read16(extra + offset);
+		uint16_t length = Read16(extra + offset + 2);
+		if (id == 0x0001 && offset + 4 + length <= extraLength)
+		{
+			m_zip64 = true;
+			const uint8_t *field = extra + offset + 4;
+			size_t available = length;
+			if (uncompressed == 0xFFFFFFFF && available >= 8)
+			{
+				uncompressed = Read64(field);
+				field += 8;
+				available -= 8;
+			}
+			if (m_compressed == 0xFFFFFFFF && available >= 8)
+			{
+				m_compressed = Read64(field);
+			}
+		}
+		offset += 4 + length;
+	}
+
+	if (m_flags & 0x0001)
+		return Fail(std::format("{}: encrypted entries are not supported", m_name));
+	if (m_method != 0 && m_method != 8)
+		return Fail(std::format("{}: unsupported compression method {}", m_name, m_method));
+
+	auto relative = std::filesystem::path(m_name).lexically_normal();
+	if (m_name.empty() || relative.is_absolute() || relative.has_root_name() || *relative.begin() == "..")
+		return Fail(std::format("entry escapes package directory: {}", m_name));
+
+	bool directory = m_name.back() == '/' || m_name.back() == '\\';
+	if ((m_flags & 0x0008) && m_method == 0 && !directory)
+		return Fail(std::format("{}: stored entry without sizes cannot be streamed", m_name));
+
+	auto target = m_directory / relative;
+	std::error_code ec;
+	if (directory)
+	{
+		std::filesystem::create_directories(target, ec);
+	}
+	else
+	{
+		std::filesystem::create_directories(target.parent_path(), ec);
+#if defined(_WIN32)
+		m_file = _wfopen(target.c_str(), L"wb");
+#else
+		m_file = std::fopen(target.c_str(), "wb");
+#endif
+		if (!m_file)
+			return Fail(std::format("cannot create {}", target.string()));
+	}
+
+	m_remaining = m_compressed;
+	m_actualCrc = static_cast<uint32_t>(mz_crc32(MZ_CRC32_INIT, nullptr, 0));
+	if (m_method == 8)
+		m_inflater = std::make_unique<Inflater>();
+
+	m_pending.clear();
+	m_state = State::Data;
+
+	if (m_flags & 0x0008)
+	{
+		// Streamed directory entries carry no data, only the trailing descriptor.
+		if (m_method == 0)
+		{
+			m_state = State::Descriptor;
+			m_needed = 4;
+		}
+		return true;
+	}
+	if (m_remaining == 0)
+		return EndEntry(m_crc);
+	return true;
+}
+
+bool MMZipStreamExtractor::Output(const uint8_t *data, size_t size)
+{
+	m_actualCrc = static_cast<uint32_t>(mz_crc32(m_actualCrc, data, size));
+	if (m_file && std::fwrite(data, 1, size, m_file) != size)
+		return Fail(std::format("{}: write failed", m_name));
+	return true;
+}
+
+bool MMZipStreamExtractor::FeedData(const uint8_t *data, size_t size, size_t &used)
+{
+	bool sized = !(m_flags & 0x0008);
+	size_t chunk = sized ? static_cast<size_t>(std::min<uint64_t>(size, m_remaining)) : size;
+
+	if (m_method == 0)
+	{
+		if (!Output(data, chunk))
+			return false;
+		used = chunk;
+	}
+	else
+	{
+		auto &stream = m_inflater->stream;
+		stream.next_in = data;
+		stream.avail_in = static_cast<unsigned int>(chunk);
+		for (;;)
+		{
+			stream.next_out = m_inflater->out;
+			stream.avail_out = sizeof(m_inflater->out);
+			int status = mz_inflate(&stream, MZ_NO_FLUSH);
+			size_t produced = sizeof(m_inflater->out) - stream.avail_out;
+			if (produced && !Output(m_inflater->out, produced))
+				return false;
+
+			if (status == MZ_STREAM_END)
+			{
+				m_inflater->ended = true;
+				break;
+			}
+			if (status != MZ_OK && status != MZ_BUF_ERROR)
+				return Fail(std::format("{}: corrupt deflate data", m_name));
+			if (stream.avail_in == 0 && stream.avail_out != 0)
+				break;
+			if (status == MZ_BUF_ERROR && produced == 0)
+				return Fail(std::format("{}: corrupt deflate data", m_name));
+		}
+		used = chunk - stream.avail_in;
+		if (sized && m_inflater->ended && used != chunk)
+			return Fail(std::format("{}: trailing data after deflate stream", m_name));
+	}
+
+	if (sized)
+	{
+		m_remaining -= used;
+		if (m_remaining)
+			return true;
+		if (m_method == 8 && !m_inflater->ended)
+			return Fail(std::format("{}: deflate stream is truncated", m_name));
+		return EndEntry(m_crc);
+	}
+
+	if (m_inflater->ended)
+	{
+		CloseFile();
+		m_state = State::Descriptor;
+		m_needed = 4;
+	}
+	return true;
+}
+
+bool MMZipStreamExtractor::EndEntry(uint32_t crc)
+{
+	CloseFile();
+	m_inflater.reset();
+	if (crc != m_actualCrc)
+		return Fail(std::format("{}: CRC mismatch", m_name));
+
+	++m_entries;
+	m_pending.clear();
+	m_needed = 4;
+	m_state = State::Signature;
+	return true;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace plugifyMM
+{
+	// Extracts a zip archive while it is being received. Entries are parsed from their
+	// local headers in order, inflated and written as bytes arrive, and checked against
+	// their CRC-32; the central directory at the end is not needed.
+	class MMZipStreamExtractor
+	{
+	public:
+		explicit MMZipStreamExtractor(std::filesystem::path directory);
+		~MMZipStreamExtractor();
+
+		MMZipStreamExtractor(const MMZipStreamExtractor &) = delete;
+		MMZipStreamExtractor &operator=(const MMZipStreamExtractor &) = delete;
+
+		// Returns false once the archive is found invalid; GetError() says why.
+		bool Write(const char *data, size_t size);
+		// True when every entry was written and the central directory was reached.
+		bool Finish();
+		// Discards everything written so far, e.g. before a download is retried.
+		void Reset();
+
+		const std::string &GetError() const { return m_error; }
+		size_t GetEntries() const { return m_entries; }
+
+	private:
+		enum class State
+		{
+			Signature,
+			Header,
+			Name,
+			Data,
+			Descriptor,
+			Done,
+			Failed,
+		};
+
+		bool BeginEntry();
+		bool FeedData(const uint8_t *data, size_t size, size_t &used);
+		bool Output(const uint8_t *data, size_t size);
+		bool EndEntry(uint32_t crc);
+		bool Fail(std::string error);
+		void CloseFile();
+
+	private:
+		std::filesystem::path m_directory;
+		State m_state { State::Signature };
+		std::vector<uint8_t> m_pending;
+		size_t m_needed { 4 };
+
+		// Current entry.
+		uint16_t m_flags { 0 };
+		uint16_t m_method { 0 };
+		uint32_t m_crc { 0 };
+		uint64_t m_compressed { 0 };
+		uint64_t m_remaining { 0 };
+		uint32_t m_actualCrc { 0 };
+		bool m_zip64 { false };
+		std::string m_name;
+		FILE *m_file { nullptr };
+		struct Inflater;
+		std::unique_ptr<Inflater> m_inflater;
+
+		size_t m_entries { 0 };
+		std::string m_error;
+	};
+} // namespace plugifyMM
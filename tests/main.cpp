@@ -0,0 +1,13 @@
+#include "test.h"
+
+int main()
+{
+	using namespace plugifyMM::test;
+	for (const auto &test : Cases())
+	{
+		int before = Failures();
+		test.run();
+		std::printf("%s %s\n", Failures() == before ? "ok  " : "FAIL", test.name);
+	}
+	return Failures() == 0 ? 0 : 1;
+}
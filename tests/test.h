@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdio>
+#include <vector>
+
+// Minimal test runner: TEST_CASE registers a function, CHECK records a failure and continues.
+namespace plugifyMM::test
+{
+	struct Case
+	{
+		const char *name;
+		void (*run)();
+	};
+
+	inline std::vector<Case> &Cases()
+	{
+		static std::vector<Case> cases;
+		return cases;
+	}
+
+	inline int &Failures()
+	{
+		static int failures = 0;
+		return failures;
+	}
+
+	struct Registrar
+	{
+		Registrar(const char *name, void (*run)()) { Cases().push_back({ name, run }); }
+	};
+} // namespace plugifyMM::test
+
+#define TEST_CASE(name) \
+	static void name(); \
+	static const ::plugifyMM::test::Registrar name##_registrar(#name, &name); \
+	static void name()
+
+#define CHECK(expr) \
+	do \
+	{ \
+		if (!(expr)) \
+		{ \
+			std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr); \
+			++::plugifyMM::test::Failures(); \
+		} \
+	} while (false)
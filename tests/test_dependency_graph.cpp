@@ -0,0 +1,80 @@
+#include "test.h"
+
+#include <mm_dependency_graph.h>
+
+#include <fstream>
+
+#include <plugify/package.h>
+
+using namespace plugifyMM;
+
+namespace
+{
+	// Writes a manifest under a scratch directory and describes it the way the core would.
+	plugify::LocalPackage WritePackage(const std::filesystem::path &root, std::string name, std::string type, int32_t version, std::string_view manifest)
+	{
+		auto directory = root / name;
+		std::filesystem::create_directories(directory);
+		auto file = directory / (name + (type == "plugin" ? ".pplugin" : ".pmodule"));
+		std::ofstream(file, std::ios::binary | std::ios::trunc) << manifest;
+
+		plugify::LocalPackage package;
+		package.name = std::move(name);
+		package.type = std::move(type);
+		package.version = version;
+		package.path = file;
+		return package;
+	}
+
+	std::filesystem::path ScratchDir(std::string_view name)
+	{
+		auto directory = std::filesystem::temp_directory_path() / ("plugify-tests-" + std::string(name));
+		std::filesystem::remove_all(directory);
+		return directory;
+	}
+} // namespace
+
+TEST_CASE(DependencyGraphReportsMissingAndConflicts)
+{
+	auto root = ScratchDir("graph-issues");
+	std::vector<plugify::LocalPackage> packages {
+		WritePackage(root, "cpp", "module", 1, R"({ "language": "cpp" })"),
+		WritePackage(root, "core", "plugin", 2, R"({ "languageModule": { "name": "cpp" } })"),
+		WritePackage(root, "admin", "plugin", 1, R"({ "languageModule": { "name": "cpp" }, "dependencies": [ { "name": "core", "requestedVersion": 3 }, { "name": "menus" }, { "name": "extras", "optional": true } ] })"),
+		WritePackage(root, "stats", "plugin", 1, R"({ "languageModule": { "name": "python" } })"),
+	};
+
+	MMDependencyGraph graph;
+	CHECK(graph.Sync(packages) == 4);
+	CHECK(graph.GetMissing().contains("menus"));
+	CHECK(graph.GetMissing().contains("language:python"));
+	CHECK(!graph.GetMissing().contains("extras"));
+	CHECK(graph.GetConflicts().contains("core"));
+	CHECK(graph.Explain("admin").find("CONFLICT, 'core' v2 installed") != std::string::npos);
+	CHECK(graph.Explain("unknown").empty());
+	std::filesystem::remove_all(root);
+}
+
+TEST_CASE(DependencyGraphResyncsOnlyChangedPackages)
+{
+	auto root = ScratchDir("graph-sync");
+	std::vector<plugify::LocalPackage> packages {
+		WritePackage(root, "cpp", "module", 1, R"({ "language": "cpp" })"),
+		WritePackage(root, "lib", "plugin", 1, R"({ "languageModule": { "name": "cpp" } })"),
+		WritePackage(root, "app", "plugin", 1, R"({ "languageModule": { "name": "cpp" }, "dependencies": [ { "name": "lib", "requestedVersion": 2 } ] })"),
+	};
+
+	MMDependencyGraph graph;
+	graph.Sync(packages);
+	CHECK(graph.HasConflicts());
+	CHECK(graph.Sync(packages) == 0);
+
+	packages[1] = WritePackage(root, "lib", "plugin", 2, R"({ "languageModule": { "name": "cpp" } })");
+	CHECK(graph.Sync(packages) == 1);
+	CHECK(!graph.HasConflicts());
+
+	packages.erase(packages.begin() + 1);
+	CHECK(graph.Sync(packages) == 1);
+	CHECK(graph.GetMissing().contains("lib"));
+	std::filesystem::remove_all(root);
+}
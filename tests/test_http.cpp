@@ -0,0 +1,258 @@
+#include "test.h"
+
+#include <mm_http.h>
+
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace plugifyMM;
+
+namespace
+{
+	// Loopback HTTP/1.0 server standing in for a repository host. Paths:
+	//   /ok/<text>  200 with <text> as body
+	//   /flaky      503 on the first request, 200 afterwards
+	//   /missing    404
+	//   /slow       200 trickling one byte every 20 ms until the client goes away
+	class HttpStandIn
+	{
+	public:
+		HttpStandIn()
+		{
+			m_socket = socket(AF_INET, SOCK_STREAM, 0);
+			sockaddr_in addr {};
+			addr.sin_family = AF_INET;
+			addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+			bind(m_socket, reinterpret_cast<sockaddr *>(&addr), sizeof(addr));
+			socklen_t length = sizeof(addr);
+			getsockname(m_socket, reinterpret_cast<sockaddr *>(&addr), &length);
+			m_port = ntohs(addr.sin_port);
+			listen(m_socket, 16);
+			m_thread = std::thread(&HttpStandIn::Run, this);
+		}
+
+		~HttpStandIn()
+		{
+			m_stop = true;
+			m_thread.join();
+			for (auto &client : m_clients)
+			{
+				client.join();
+			}
+			close(m_socket);
+		}
+
+		std::string Url(std::string_view path) const { return "http://127.0.0.1:" + std::to_string(m_port) + std::string(path); }
+
+		int Hits(const std::string &path)
+		{
+			std::lock_guard lock(m_mutex);
+			return m_hits[path];
+		}
+
+	private:
+		void Run()
+		{
+			while (!m_stop)
+			{
+				pollfd fd { m_socket, POLLIN, 0 };
+				if (poll(&fd, 1, 20) <= 0)
+					continue;
+				int client = accept(m_socket, nullptr, nullptr);
+				if (client >= 0)
+				{
+					m_clients.emplace_back(&HttpStandIn::Serve, this, client);
+				}
+			}
+		}
+
+		void Serve(int client)
+		{
+			std::string request;
+			char buffer[1024];
+			while (request.find("\r\n\r\n") == std::string::npos)
+			{
+				auto received = recv(client, buffer, sizeof(buffer), 0);
+				if (received <= 0)
+				{
+					close(client);
+					return;
+				}
+				request.append(buffer, static_cast<size_t>(received));
+			}
+
+			auto begin = request.find(' ') + 1;
+			std::string path = request.substr(begin, request.find(' ', begin) - begin);
+			int hits;
+			{
+				std::lock_guard lock(m_mutex);
+				hits = ++m_hits[path];
+			}
+
+			if (path.starts_with("/ok/"))
+			{
+				Reply(client, 200, path.substr(4));
+			}
+			else if (path == "/flaky")
+			{
+				Reply(client, hits == 1 ? 503 : 200, hits == 1 ? "" : "recovered");
+			}
+			else if (path == "/slow")
+			{
+				std::string head = "HTTP/1.0 200 OK\r\nContent-Length: 1000000\r\n\r\n";
+				send(client, head.data(), head.size(), MSG_NOSIGNAL);
+				while (!m_stop && send(client, "x", 1, MSG_NOSIGNAL) == 1)
+				{
+					std::this_thread::sleep_for(std::chrono::milliseconds(20));
+				}
+			}
+			else
+			{
+				Reply(client, 404, "");
+			}
+			close(client);
+		}
+
+		static void Reply(int client, int status, const std::string &body)
+		{
+			std::string response = "HTTP/1.0 " + std::to_string(status) + " X\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+			send(client, response.data(), response.size(), MSG_NOSIGNAL);
+		}
+
+	private:
+		int m_socket { -1 };
+		uint16_t m_port { 0 };
+		std::atomic<bool> m_stop { false };
+		std::thread m_thread;
+		std::vector<std::thread> m_clients;
+		std::mutex m_mutex;
+		std::map<std::string, int> m_hits;
+	};
+
+	HttpOptions FastOptions()
+	{
+		HttpOptions options;
+		options.parallelism = 4;
+		options.retries = 2;
+		options.backoff = std::chrono::milliseconds(1);
+		options.timeout = std::chrono::seconds(10);
+		return options;
+	}
+} // namespace
+
+TEST_CASE(ParallelBatchKeepsRequestOrder)
+{
+	HttpStandIn server;
+	MMHttpClient http;
+	http.SetOptions(FastOptions());
+
+	std::vector<HttpRequest> requests;
+	for (int i = 0; i < 10; ++i)
+	{
+		requests.push_back({ server.Url("/ok/body" + std::to_string(i)) });
+	}
+	auto responses = http.Perform(requests);
+	CHECK(responses.size() == 10);
+	for (int i = 0; i < 10; ++i)
+	{
+		CHECK(responses[i].Ok());
+		CHECK(responses[i].body == "body" + std::to_string(i));
+	}
+}
+
+TEST_CASE(TransientErrorsAreRetried)
+{
+	HttpStandIn server;
+	MMHttpClient http;
+	http.SetOptions(FastOptions());
+
+	std::vector<HttpRequest> requests { { server.Url("/flaky") } };
+	auto responses = http.Perform(requests);
+	CHECK(responses[0].Ok());
+	CHECK(responses[0].body == "recovered");
+	CHECK(responses[0].attempts == 2);
+}
+
+TEST_CASE(ClientErrorsAreNotRetried)
+{
+	HttpStandIn server;
+	MMHttpClient http;
+	http.SetOptions(FastOptions());
+
+	std::vector<HttpRequest> requests { { server.Url("/missing") } };
+	auto responses = http.Perform(requests);
+	CHECK(!responses[0].Ok());
+	CHECK(responses[0].status == 404);
+	CHECK(responses[0].attempts == 1);
+	CHECK(server.Hits("/missing") == 1);
+}
+
+TEST_CASE(StreamingSinkReceivesBody)
+{
+	HttpStandIn server;
+	MMHttpClient http;
+	http.SetOptions(FastOptions());
+
+	std::string streamed;
+	HttpRequest request { server.Url("/ok/streamed") };
+	request.onData = [&](const char *data, size_t size)
+	{
+		streamed.append(data, size);
+		return true;
+	};
+	std::vector<HttpRequest> requests { std::move(request) };
+	auto responses = http.Perform(requests);
+	CHECK(responses[0].Ok());
+	CHECK(responses[0].body.empty());
+	CHECK(streamed == "streamed");
+}
+
+TEST_CASE(CancelStopsRunningBatch)
+{
+	HttpStandIn server;
+	MMHttpClient http;
+	http.SetOptions(FastOptions());
+
+	std::atomic<bool> cancel { false };
+	std::vector<HttpRequest> requests { { server.Url("/slow") } };
+	std::vector<HttpResponse> responses;
+	auto start = std::chrono::steady_clock::now();
+	std::thread batch([&] { responses = http.Perform(requests, &cancel); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	cancel = true;
+	batch.join();
+	CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(2));
+	CHECK(responses[0].error == "Cancelled");
+}
+
+TEST_CASE(SetOptionsDoesNotWaitForBatch)
+{
+	HttpStandIn server;
+	MMHttpClient http;
+	http.SetOptions(FastOptions());
+
+	std::atomic<bool> cancel { false };
+	std::vector<HttpRequest> requests { { server.Url("/slow") } };
+	std::thread batch([&] { http.Perform(requests, &cancel); });
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+	auto start = std::chrono::steady_clock::now();
+	auto options = FastOptions();
+	options.parallelism = 8;
+	http.SetOptions(options);
+	CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(50));
+	CHECK(http.GetOptions().parallelism == 8);
+
+	cancel = true;
+	batch.join();
+}
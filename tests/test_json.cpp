@@ -0,0 +1,64 @@
+#include "test.h"
+
+#include <mm_json.h>
+
+#include <clocale>
+
+using namespace plugifyMM;
+
+namespace
+{
+	std::optional<JsonValue> Parse(std::string_view text)
+	{
+		std::string error;
+		return JsonValue::Parse(text, error);
+	}
+} // namespace
+
+TEST_CASE(JsonParsesNestedDocuments)
+{
+	auto document = Parse(R"({ "name": "aé\n", "version": 12, "list": [ true, null, -1.25e-1 ], "nested": { "ok": false } })");
+	CHECK(document.has_value());
+	CHECK((*document)["name"].GetString() == std::string_view("a\xC3\xA9\n"));
+	CHECK((*document)["version"].GetInt() == 12);
+	CHECK((*document)["list"].GetArray().size() == 3);
+	CHECK((*document)["list"].GetArray()[0].GetBool() == true);
+	CHECK((*document)["list"].GetArray()[1].IsNull());
+	CHECK(!(*document)["list"].GetArray()[2].GetInt().has_value());
+	CHECK((*document)["nested"]["ok"].GetBool() == false);
+	CHECK((*document)["absent"]["deeper"].IsNull());
+}
+
+TEST_CASE(JsonRejectsMalformedInput)
+{
+	for (std::string_view text : { "{", "[1,]", "{\"a\" 1}", "01x", "\"unterminated", "{} trailing", "1.2.3" })
+	{
+		std::string error;
+		CHECK(!JsonValue::Parse(text, error).has_value());
+		CHECK(!error.empty());
+	}
+}
+
+TEST_CASE(JsonNumbersIgnoreTheLocale)
+{
+	// A locale with ',' as decimal separator made strtod stop at the '.'.
+	const char *previous = std::setlocale(LC_NUMERIC, nullptr);
+	std::string saved = previous ? previous : "C";
+	if (!std::setlocale(LC_NUMERIC, "de_DE.UTF-8"))
+		std::setlocale(LC_NUMERIC, "fr_FR.UTF-8");
+	auto document = Parse("{ \"value\": 2.5, \"version\": 3.0 }");
+	std::setlocale(LC_NUMERIC, saved.c_str());
+
+	CHECK(document.has_value());
+	CHECK((*document)["version"].GetInt() == 3);
+	CHECK(!(*document)["value"].GetInt().has_value());
+}
+
+TEST_CASE(JsonWriterEscapesAndSeparates)
+{
+	MMJsonWriter writer;
+	writer.BeginObject().Key("text").String("quote\" slash\\ tab\t").Key("values").BeginArray().Int(-3).Uint(7).Double(0.5).Double(1.0 / 0.0).Bool(true).EndArray().EndObject();
+	std::string out = writer.Release();
+	CHECK(out == "{\"text\":\"quote\\\" slash\\\\ tab\\t\",\"values\":[-3,7,0.5,null,true]}\n");
+	CHECK(Parse(out).has_value());
+}
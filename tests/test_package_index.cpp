@@ -0,0 +1,97 @@
+#include "test.h"
+
+#include <mm_package_index.h>
+
+#include <algorithm>
+
+using namespace plugifyMM;
+
+namespace
+{
+	plugify::RemotePackage MakePackage(std::string name, std::string type, std::string author, std::string description)
+	{
+		plugify::RemotePackage package;
+		package.name = std::move(name);
+		package.type = std::move(type);
+		package.author = std::move(author);
+		package.description = std::move(description);
+		return package;
+	}
+
+	MMPackageIndex MakeIndex()
+	{
+		MMPackageIndex index;
+		index.Build({
+			MakePackage("plugify-module-cpp", "cpp", "untrustedmodders", "C++ language module"),
+			MakePackage("polyhook", "cpp", "untrustedmodders", "Function hooking library"),
+			MakePackage("polyhook-extras", "cpp", "someone", "Helpers on top of polyhook"),
+			MakePackage("admin-menu", "csharp", "someone", "Admin menu with hooks for polyhook users"),
+			MakePackage("hook", "python", "else", "Small hooking helper"),
+			MakePackage("stats", "python", "else", "Player statistics"),
+		});
+		return index;
+	}
+
+	std::vector<std::string> Names(const MMPackageIndex &index, const PackageSearchResult &result)
+	{
+		std::vector<std::string> names;
+		for (const auto &hit : result.hits)
+			names.push_back(index.GetPackages()[hit.index].name);
+		return names;
+	}
+} // namespace
+
+TEST_CASE(IndexRanksExactThenPrefixThenDescription)
+{
+	auto index = MakeIndex();
+	auto names = Names(index, index.Search("polyhook", {}, 0, 10));
+	CHECK(names.size() >= 3);
+	CHECK(names[0] == "polyhook");
+	CHECK(names[1] == "polyhook-extras");
+	CHECK(std::find(names.begin(), names.end(), "admin-menu") > std::find(names.begin(), names.end(), "polyhook-extras"));
+	CHECK(std::find(names.begin(), names.end(), "stats") == names.end());
+}
+
+TEST_CASE(IndexToleratesTyposAndCase)
+{
+	auto index = MakeIndex();
+	auto names = Names(index, index.Search("PolyHok", {}, 0, 3));
+	CHECK(!names.empty() && names[0] == "polyhook");
+
+	names = Names(index, index.Search("statistics", {}, 0, 3));
+	CHECK(!names.empty() && names[0] == "stats");
+}
+
+TEST_CASE(IndexFiltersByTypePrefix)
+{
+	auto index = MakeIndex();
+	auto names = Names(index, index.Search("hook", "py", 0, 10));
+	CHECK(!names.empty() && names[0] == "hook");
+	for (const auto &hit : index.Search("hook", "py", 0, 10).hits)
+		CHECK(index.GetPackages()[hit.index].type == "python");
+}
+
+TEST_CASE(IndexPaginatesRankedHits)
+{
+	auto index = MakeIndex();
+	auto all = index.Search("hook", {}, 0, 100);
+	CHECK(all.total == all.hits.size());
+	CHECK(all.total >= 3);
+
+	auto page = index.Search("hook", {}, 1, 2);
+	CHECK(page.total == all.total);
+	CHECK(page.hits.size() == 2);
+	CHECK(page.hits[0].index == all.hits[1].index);
+	CHECK(page.hits[1].index == all.hits[2].index);
+	CHECK(index.Search("hook", {}, all.total, 5).hits.empty());
+}
+
+TEST_CASE(IndexListsEverythingByNameForEmptyQuery)
+{
+	auto index = MakeIndex();
+	auto result = index.Search("", {}, 0, 100);
+	CHECK(result.total == 6);
+	auto names = Names(index, result);
+	CHECK(std::is_sorted(names.begin(), names.end()));
+	CHECK(index.Search(" - ", "python", 0, 100).total == 2);
+}
@@ -0,0 +1,209 @@
+#include "test.h"
+
+#include <mm_sha256.h>
+#include <mm_zip_stream.h>
+
+#include <fstream>
+#include <string>
+
+#include <miniz.h>
+
+using namespace plugifyMM;
+
+namespace
+{
+	struct Entry
+	{
+		std::string name;
+		std::string data;
+		bool deflate { false };
+		bool descriptor { false }; // sizes and CRC follow the data instead of the header
+		bool badCrc { false };
+	};
+
+	void Put16(std::string &out, uint16_t value)
+	{
+		out += static_cast<char>(value & 0xFF);
+		out += static_cast<char>(value >> 8);
+	}
+
+	void Put32(std::string &out, uint32_t value)
+	{
+		Put16(out, static_cast<uint16_t>(value & 0xFFFF));
+		Put16(out, static_cast<uint16_t>(value >> 16));
+	}
+
+	std::string Deflate(const std::string &data)
+	{
+		std::string out(data.size() + 1024, '\0');
+		mz_stream stream {};
+		mz_deflateInit2(&stream, 6, MZ_DEFLATED, -MZ_DEFAULT_WINDOW_BITS, 9, MZ_DEFAULT_STRATEGY);
+		stream.next_in = reinterpret_cast<const unsigned char *>(data.data());
+		stream.avail_in = static_cast<unsigned int>(data.size());
+		stream.next_out = reinterpret_cast<unsigned char *>(out.data());
+		stream.avail_out = static_cast<unsigned int>(out.size());
+		mz_deflate(&stream, MZ_FINISH);
+		out.resize(out.size() - stream.avail_out);
+		mz_deflateEnd(&stream);
+		return out;
+	}
+
+	// Local headers and data only, then the start of a central directory; that is all the
+	// streaming extractor reads.
+	std::string MakeZip(const std::vector<Entry> &entries)
+	{
+		std::string zip;
+		for (const auto &entry : entries)
+		{
+			auto crc = static_cast<uint32_t>(mz_crc32(MZ_CRC32_INIT, reinterpret_cast<const unsigned char *>(entry.data.data()), entry.data.size()));
+			if (entry.badCrc)
+				crc ^= 1;
+			std::string payload = entry.deflate ? Deflate(entry.data) : entry.data;
+
+			Put32(zip, 0x04034b50);
+			Put16(zip, 20);
+			Put16(zip, entry.descriptor ? 0x0008 : 0);
+			Put16(zip, entry.deflate ? 8 : 0);
+			Put32(zip, 0); // time and date
+			Put32(zip, entry.descriptor ? 0 : crc);
+			Put32(zip, entry.descriptor ? 0 : static_cast<uint32_t>(payload.size()));
+			Put32(zip, entry.descriptor ? 0 : static_cast<uint32_t>(entry.data.size()));
+			Put16(zip, static_cast<uint16_t>(entry.name.size()));
+			Put16(zip, 0);
+			zip += entry.name;
+			zip += payload;
+			if (entry.descriptor)
+			{
+				Put32(zip, 0x08074b50);
+				Put32(zip, crc);
+				Put32(zip, static_cast<uint32_t>(payload.size()));
+				Put32(zip, static_cast<uint32_t>(entry.data.size()));
+			}
+		}
+		Put32(zip, 0x02014b50);
+		zip.append(42, '\0');
+		return zip;
+	}
+
+	std::filesystem::path TempDir(std::string_view name)
+	{
+		return std::filesystem::temp_directory_path() / ("plugify-tests-" + std::string(name));
+	}
+
+	std::string ReadFile(const std::filesystem::path &path)
+	{
+		std::ifstream stream(path, std::ios::binary);
+		return { std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>() };
+	}
+
+	std::string Repeat(std::string_view text, size_t count)
+	{
+		std::string out;
+		for (size_t i = 0; i < count; ++i)
+			out += text;
+		return out;
+	}
+
+	std::string Sha256Hex(std::string_view data)
+	{
+		MMSha256 sha;
+		sha.Update(data.data(), data.size());
+		return MMSha256::ToHex(sha.Final());
+	}
+} // namespace
+
+TEST_CASE(ZipExtractsStoredAndDeflatedEntriesFedByteByByte)
+{
+	auto dir = TempDir("zip-bytes");
+	std::string text = Repeat("plugify module data\n", 5000);
+	auto zip = MakeZip({ { "plugin.pplugin", "{}" }, { "bin/", "" }, { "bin/lib.so", text, true } });
+
+	MMZipStreamExtractor extractor(dir);
+	bool ok = true;
+	for (char c : zip)
+	{
+		ok &= extractor.Write(&c, 1);
+	}
+	CHECK(ok);
+	CHECK(extractor.Finish());
+	CHECK(extractor.GetEntries() == 3);
+	CHECK(ReadFile(dir / "plugin.pplugin") == "{}");
+	CHECK(ReadFile(dir / "bin" / "lib.so") == text);
+	std::filesystem::remove_all(dir);
+}
+
+TEST_CASE(ZipHandlesDataDescriptors)
+{
+	auto dir = TempDir("zip-descriptor");
+	std::string text = Repeat("0123456789", 10000);
+	auto zip = MakeZip({ { "a.txt", text, true, true }, { "b.txt", "tail", false } });
+
+	MMZipStreamExtractor extractor(dir);
+	CHECK(extractor.Write(zip.data(), zip.size()));
+	CHECK(extractor.Finish());
+	CHECK(ReadFile(dir / "a.txt") == text);
+	CHECK(ReadFile(dir / "b.txt") == "tail");
+	std::filesystem::remove_all(dir);
+}
+
+TEST_CASE(ZipRejectsCrcMismatch)
+{
+	auto dir = TempDir("zip-crc");
+	auto zip = MakeZip({ { "a.txt", "payload", true, false, true } });
+
+	MMZipStreamExtractor extractor(dir);
+	CHECK(!extractor.Write(zip.data(), zip.size()));
+	CHECK(!extractor.Finish());
+	CHECK(extractor.GetError().find("CRC mismatch") != std::string::npos);
+	std::filesystem::remove_all(dir);
+}
+
+TEST_CASE(ZipRejectsEntriesOutsideTheDirectory)
+{
+	auto dir = TempDir("zip-escape");
+	auto zip = MakeZip({ { "../escaped.txt", "x" } });
+
+	MMZipStreamExtractor extractor(dir);
+	CHECK(!extractor.Write(zip.data(), zip.size()));
+	CHECK(extractor.GetError().find("escapes") != std::string::npos);
+	CHECK(!std::filesystem::exists(dir.parent_path() / "escaped.txt"));
+	std::filesystem::remove_all(dir);
+}
+
+TEST_CASE(ZipReportsTruncationAndRecoversAfterReset)
+{
+	auto dir = TempDir("zip-truncated");
+	auto zip = MakeZip({ { "a.txt", Repeat("abc", 1000), true } });
+
+	MMZipStreamExtractor extractor(dir);
+	CHECK(extractor.Write(zip.data(), zip.size() / 2));
+	CHECK(!extractor.Finish());
+
+	extractor.Reset();
+	CHECK(extractor.Write(zip.data(), zip.size()));
+	CHECK(extractor.Finish());
+	CHECK(extractor.GetEntries() == 1);
+	std::filesystem::remove_all(dir);
+}
+
+TEST_CASE(Sha256MatchesKnownVectors)
+{
+	CHECK(Sha256Hex("") == "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+	CHECK(Sha256Hex("abc") == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+	CHECK(Sha256Hex("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq") == "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+	CHECK(Sha256Hex(std::string(1000000, 'a')) == "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+}
+
+TEST_CASE(Sha256IsIndependentOfChunking)
+{
+	std::string data = Repeat("incremental ", 1000);
+	for (size_t chunk : { size_t(1), size_t(63), size_t(64), size_t(65), size_t(4096) })
+	{
+		MMSha256 sha;
+		for (size_t offset = 0; offset < data.size(); offset += chunk)
+		{
+			sha.Update(data.data() + offset, std::min(chunk, data.size() - offset));
+		}
+		CHECK(MMSha256::ToHex(sha.Final()) == Sha256Hex(data));
+	}
+}
@@ -0,0 +1,364 @@
+// Decodes binary log files written by MMBinaryLogSink into text or JSON lines.
+// usage: plugify-logdecode [--json] <file.blog>...
+
+#include <mm_binary_log_format.h>
+
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+using namespace plugifyMM;
+
+using Arg = std::variant<int64_t, uint64_t, double, bool, std::string>;
+
+class Reader
+{
+public:
+	Reader(const uint8_t *data, size_t size) : m_data(data), m_size(size) {}
+
+	template <typename T>
+	bool Read(T &value)
+	{
+		if (m_offset + sizeof(T) > m_size)
+			return false;
+		std::memcpy(&value, m_data + m_offset, sizeof(T));
+		m_offset += sizeof(T);
+		return true;
+	}
+
+	bool ReadString(std::string &value, size_t length)
+	{
+		if (m_offset + length > m_size)
+			return false;
+		value.assign(reinterpret_cast<const char *>(m_data + m_offset), length);
+		m_offset += length;
+		return true;
+	}
+
+	size_t Offset() const { return m_offset; }
+	void Seek(size_t offset) { m_offset = offset; }
+
+private:
+	const uint8_t *m_data;
+	size_t m_size;
+	size_t m_offset { 0 };
+};
+
+static std::string ToString(const Arg &arg)
+{
+	return std::visit([](const auto &value) -> std::string
+	{
+		using T = std::decay_t<decltype(value)>;
+		if constexpr (std::is_same_v<T, std::string>)
+		{
+			return value;
+		}
+		else if constexpr (std::is_same_v<T, bool>)
+		{
+			return value ? "true" : "false";
+		}
+		else
+		{
+			char buffer[64];
+			auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+			return std::string(buffer, result.ptr);
+		}
+	}, arg);
+}
+
+// Substitutes "{}" style placeholders. Format specs are not applied, values use their default rendering.
+static std::string Render(std::string_view format, const std::vector<Arg> &args)
+{
+	std::string out;
+	size_t next = 0;
+	for (size_t i = 0; i < format.size(); ++i)
+	{
+		char c = format[i];
+		if (c == '{' && i + 1 < format.size() && format[i + 1] == '{')
+		{
+			out += '{';
+			++i;
+		}
+		else if (c == '}' && i + 1 < format.size() && format[i + 1] == '}')
+		{
+			out += '}';
+			++i;
+		}
+		else if (c == '{')
+		{
+			size_t end = format.find('}', i);
+			if (end == std::string_view::npos)
+			{
+				out.append(format.substr(i));
+				break;
+			}
+			std::string_view field = format.substr(i + 1, end - i - 1);
+			field = field.substr(0, field.find(':'));
+			size_t index = next++;
+			if (!field.empty())
+			{
+				std::from_chars(field.data(), field.data() + field.size(), index);
+			}
+			out += index < args.size() ? ToString(args[index]) : "{?}";
+			i = end;
+		}
+		else
+		{
+			out += c;
+		}
+	}
+	return out;
+}
+
+static std::string Escape(std::string_view str)
+{
+	std::string out;
+	out.reserve(str.size() + 2);
+	out += '"';
+	for (char c : str)
+	{
+		switch (c)
+		{
+			case '"': out += "\\\""; break;
+			case '\\': out += "\\\\"; break;
+			case '\n': out += "\\n"; break;
+			case '\r': out += "\\r"; break;
+			case '\t': out += "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20)
+				{
+					char buffer[8];
+					std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+					out += buffer;
+				}
+				else
+				{
+					out += c;
+				}
+		}
+	}
+	out += '"';
+	return out;
+}
+
+static std::string FormatTimestamp(uint64_t ns)
+{
+	auto seconds = static_cast<std::time_t>(ns / 1000000000);
+	char buffer[32];
+	std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", std::localtime(&seconds));
+	char fraction[16];
+	std::snprintf(fraction, sizeof(fraction), ".%06u", static_cast<unsigned>((ns % 1000000000) / 1000));
+	return std::string(buffer) + fraction;
+}
+
+static bool ReadArgs(Reader &reader, uint8_t argc, std::vector<Arg> &args)
+{
+	args.clear();
+	for (uint8_t i = 0; i < argc; ++i)
+	{
+		blog::ArgType type;
+		if (!reader.Read(type))
+			return false;
+		switch (type)
+		{
+			case blog::ArgType::Int:
+			{
+				int64_t value;
+				if (!reader.Read(value))
+					return false;
+				args.emplace_back(value);
+				break;
+			}
+			case blog::ArgType::UInt:
+			{
+				uint64_t value;
+				if (!reader.Read(value))
+					return false;
+				args.emplace_back(value);
+				break;
+			}
+			case blog::ArgType::Double:
+			{
+				double value;
+				if (!reader.Read(value))
+					return false;
+				args.emplace_back(value);
+				break;
+			}
+			case blog::ArgType::Bool:
+			{
+				uint8_t value;
+				if (!reader.Read(value))
+					return false;
+				args.emplace_back(value != 0);
+				break;
+			}
+			case blog::ArgType::String:
+			{
+				uint16_t length;
+				std::string value;
+				if (!reader.Read(length) || !reader.ReadString(value, length))
+					return false;
+				args.emplace_back(std::move(value));
+				break;
+			}
+			default:
+				return false;
+		}
+	}
+	return true;
+}
+
+static bool Decode(const std::string &path, bool json)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		std::cerr << path << ": cannot open\n";
+		return false;
+	}
+	std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	Reader reader(data.data(), data.size());
+	blog::FileHeader header;
+	if (!reader.Read(header) || std::memcmp(header.magic, blog::kMagic, sizeof(header.magic)) != 0)
+	{
+		std::cerr << path << ": not a plugify binary log\n";
+		return false;
+	}
+	if (header.version != blog::kVersion)
+	{
+		std::cerr << path << ": unsupported version " << header.version << "\n";
+		return false;
+	}
+
+	std::unordered_map<uint32_t, std::string> formats;
+	std::unordered_map<uint32_t, std::string> sources;
+	std::vector<Arg> args;
+
+	for (;;)
+	{
+		size_t start = reader.Offset();
+		uint32_t size;
+		blog::RecordType type;
+		if (!reader.Read(size) || size == 0)
+			break;
+		if (size < blog::kRecordPrefix || !reader.Read(type))
+		{
+			std::cerr << path << ": corrupt record at offset " << start << "\n";
+			return false;
+		}
+
+		switch (type)
+		{
+			case blog::RecordType::Format:
+			case blog::RecordType::Source:
+			{
+				uint32_t id;
+				uint16_t length;
+				std::string text;
+				if (!reader.Read(id) || !reader.Read(length) || !reader.ReadString(text, length))
+					break;
+				(type == blog::RecordType::Format ? formats : sources)[id] = std::move(text);
+				break;
+			}
+
+			case blog::RecordType::Entry:
+			{
+				uint64_t timestamp;
+				uint8_t severity;
+				uint32_t sourceId;
+				uint32_t formatId;
+				uint8_t argc;
+				if (!reader.Read(timestamp) || !reader.Read(severity) || !reader.Read(sourceId) || !reader.Read(formatId) || !reader.Read(argc) || !ReadArgs(reader, argc, args))
+					break;
+
+				const std::string &format = formats[formatId];
+				const std::string &source = sources[sourceId];
+				const char *level = severity < std::size(blog::kSeverityNames) ? blog::kSeverityNames[severity] : "unknown";
+				std::string message = Render(format, args);
+
+				if (json)
+				{
+					std::cout << "{\"ts\":" << timestamp
+					          << ",\"time\":" << Escape(FormatTimestamp(timestamp))
+					          << ",\"severity\":\"" << level << "\""
+					          << ",\"source\":" << Escape(source)
+					          << ",\"format\":" << Escape(format)
+					          << ",\"args\":[";
+					for (size_t i = 0; i < args.size(); ++i)
+					{
+						if (i)
+							std::cout << ',';
+						if (std::holds_alternative<std::string>(args[i]))
+							std::cout << Escape(std::get<std::string>(args[i]));
+						else if (const double *value = std::get_if<double>(&args[i]); value && !std::isfinite(*value))
+							std::cout << "null"; // JSON has no nan or inf
+						else
+							std::cout << ToString(args[i]);
+					}
+					std::cout << "],\"message\":" << Escape(message) << "}\n";
+				}
+				else
+				{
+					std::cout << FormatTimestamp(timestamp) << " [" << level << "] [" << source << "] " << message << '\n';
+				}
+				break;
+			}
+
+			default:
+				break;
+		}
+
+		reader.Seek(start + size);
+	}
+
+	return true;
+}
+
+int main(int argc, char **argv)
+{
+	bool json = false;
+	std::vector<std::string> files;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string_view arg(argv[i]);
+		if (arg == "--json" || arg == "-j")
+		{
+			json = true;
+		}
+		else if (arg == "--help" || arg == "-h")
+		{
+			std::cout << "usage: plugify-logdecode [--json] <file.blog>...\n";
+			return 0;
+		}
+		else
+		{
+			files.emplace_back(arg);
+		}
+	}
+
+	if (files.empty())
+	{
+		std::cerr << "usage: plugify-logdecode [--json] <file.blog>...\n";
+		return 1;
+	}
+
+	int result = 0;
+	for (const auto &file : files)
+	{
+		if (!Decode(file, json))
+			result = 1;
+	}
+	return result;
+}